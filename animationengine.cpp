@@ -0,0 +1,308 @@
+// animationengine.cpp
+#include "animationengine.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kFrameMs = 16;   // ~60 кадров в секунду
+
+} // namespace
+
+AnimationEngine::AnimationEngine(GraphicModel* model, QObject* parent)
+    : QObject(parent)
+    , model(model)
+    , startTime(0)
+    , now(0)
+    , looping(true)
+    , dirty(false)
+    , length(0)
+{
+    timer.setInterval(kFrameMs);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &AnimationEngine::tick);
+}
+
+quint64 AnimationEngine::trackKey(quint64 id, Property property) {
+    return (id << 2) | quint64(property);
+}
+
+void AnimationEngine::setValue(Shape* s, Property property, qreal time, const Value& value) {
+    authored[trackKey(s->getId(), property)].insert(qMax<qreal>(0, time), value);
+    dirty = true;
+}
+
+void AnimationEngine::setKey(Shape* s, Property property, qreal time, const QPointF& p) {
+    setValue(s, property, time, Value{ { p.x(), p.y(), 0, 0 } });
+}
+
+void AnimationEngine::setKey(Shape* s, Property property, qreal time, const QColor& c) {
+    setValue(s, property, time, Value{ { c.redF(), c.greenF(), c.blueF(), c.alphaF() } });
+}
+
+void AnimationEngine::setKeys(Shape* s, qreal time) {
+    setKey(s, Property::Position, time, s->pos());
+    setKey(s, Property::Color,    time, s->getColor());
+    setKey(s, Property::EndPoint, time, s->getEndPos());
+}
+
+void AnimationEngine::clear() {
+    stop();
+    authored.clear();
+    dirty = true;
+    now = 0;
+}
+
+int AnimationEngine::trackCount() const {
+    return authored.size();
+}
+
+int AnimationEngine::keyCount() const {
+    int n = 0;
+    for (const auto& keys : authored)
+        n += keys.size();
+    return n;
+}
+
+qreal AnimationEngine::duration() const {
+    qreal end = 0;
+    for (const auto& keys : authored)
+        end = qMax(end, keys.lastKey());
+    return end;
+}
+
+// ---------------- Воспроизведение ----------------
+
+void AnimationEngine::play() {
+    if (timer.isActive())
+        return;
+    pack();
+    if (tracks.isEmpty())
+        return;
+    if (!looping && now >= length)
+        now = 0;
+    // Снимок документа фиксируется до первого кадра: автосохранение и сжатие
+    // журнала во время просмотра пишут значения до анимации
+    model->snapshot();
+    captureBase();
+    startTime = now;
+    clock.start();
+    timer.start();
+    evaluate(now);
+}
+
+void AnimationEngine::pause() {
+    stop();
+}
+
+void AnimationEngine::stop() {
+    timer.stop();
+    restoreBase();
+}
+
+bool AnimationEngine::isPlaying() const {
+    return timer.isActive();
+}
+
+void AnimationEngine::seek(qreal time) {
+    pack();
+    now = qMax<qreal>(0, time);
+    if (timer.isActive()) {
+        startTime = now;
+        clock.restart();
+        evaluate(now);
+    }
+    emit timeChanged(now);
+}
+
+qreal AnimationEngine::currentTime() const {
+    return now;
+}
+
+void AnimationEngine::setLooping(bool l) {
+    looping = l;
+}
+
+bool AnimationEngine::isLooping() const {
+    return looping;
+}
+
+void AnimationEngine::tick() {
+    // Время по часам, а не по числу тиков: пропущенные кадры не замедляют анимацию
+    qreal t = startTime + clock.nsecsElapsed() / 1e9;
+    bool done = false;
+    if (t >= length) {
+        if (looping && length > 0) {
+            t = std::fmod(t, length);
+        } else {
+            t = length;
+            done = true;
+        }
+    }
+    now = t;
+    evaluate(now);
+    emit timeChanged(now);
+    if (done) {
+        stop();
+        emit finished();
+    }
+}
+
+// Ключи из словарей — в сплошные массивы; дорожки одной фигуры пишут в один слот кадра
+void AnimationEngine::pack() {
+    if (!dirty)
+        return;
+    dirty = false;
+
+    // Ключи поменялись во время просмотра: слоты кадра перестраиваются,
+    // исходные значения снимаются заново
+    const bool playing = !base.isEmpty();
+    if (playing)
+        restoreBase();
+
+    tracks.clear();
+    times.clear();
+    values.clear();
+    frame.clear();
+    frameIds.clear();
+    length = 0;
+
+    QHash<quint64, int> slotOf;
+    int total = 0;
+    for (const auto& keys : authored)
+        total += keys.size();
+    tracks.reserve(authored.size());
+    times.reserve(total);
+    values.reserve(total);
+
+    for (auto it = authored.constBegin(); it != authored.constEnd(); ++it) {
+        const QMap<qreal, Value>& keys = it.value();
+        if (keys.isEmpty())
+            continue;
+        const quint64 id = it.key() >> 2;
+        auto slot = slotOf.constFind(id);
+        if (slot == slotOf.constEnd()) {
+            slot = slotOf.insert(id, frame.size());
+            frame.append(ShapeFrame());
+            frameIds.append(id);
+        }
+
+        Track tr;
+        tr.slot     = slot.value();
+        tr.property = Property(it.key() & 0x3);
+        tr.first    = times.size();
+        tr.count    = keys.size();
+        tr.cursor   = 0;
+        for (auto k = keys.constBegin(); k != keys.constEnd(); ++k) {
+            times.append(k.key());
+            values.append(k.value());
+        }
+        length = qMax(length, keys.lastKey());
+        tracks.append(tr);
+    }
+
+    // Дорожки по порядку слотов: кадр заполняется последовательно
+    std::sort(tracks.begin(), tracks.end(), [](const Track& a, const Track& b) {
+        return a.slot < b.slot;
+    });
+
+    if (playing)
+        captureBase();
+}
+
+void AnimationEngine::evaluate(qreal t) {
+    if (tracks.isEmpty())
+        return;
+
+    // Фигуры — по id через модель: удалённой фигуры в модели нет, слот пропускается
+    ShapeFrame* fs = frame.data();
+    for (int i = 0; i < frame.size(); ++i) {
+        fs[i].shape  = model->shapeById(frameIds[i]);
+        fs[i].fields = 0;
+    }
+
+    const qreal* ts = times.constData();
+    const Value* vs = values.constData();
+
+    for (Track& tr : tracks) {
+        const qreal* kt = ts + tr.first;
+        const Value* kv = vs + tr.first;
+        const int n = tr.count;
+
+        // Сегмент [i, i+1], содержащий t: обычно тот же или следующий, что в прошлом кадре
+        int i = tr.cursor;
+        if (i >= n || kt[i] > t)
+            i = qMax(0, int(std::upper_bound(kt, kt + n, t) - kt) - 1);
+        while (i + 1 < n && kt[i + 1] <= t)
+            ++i;
+        tr.cursor = i;
+
+        Value v = kv[i];
+        if (i + 1 < n && t > kt[i]) {
+            const qreal u = (t - kt[i]) / (kt[i + 1] - kt[i]);
+            for (int c = 0; c < 4; ++c)
+                v.v[c] += (kv[i + 1].v[c] - v.v[c]) * u;
+        }
+
+        ShapeFrame& f = fs[tr.slot];
+        switch (tr.property) {
+        case Property::Position:
+            f.fields |= Shape::AnimatePos;
+            f.pos = QPointF(v.v[0], v.v[1]);
+            break;
+        case Property::Color:
+            f.fields |= Shape::AnimateColor;
+            f.color = QColor::fromRgbF(v.v[0], v.v[1], v.v[2], v.v[3]);
+            break;
+        case Property::EndPoint:
+            f.fields |= Shape::AnimateEnd;
+            f.endPos = QPointF(v.v[0], v.v[1]);
+            break;
+        }
+    }
+
+    model->applyFrame(frame);
+}
+
+// Значения фигур до запуска — по тем же слотам, что и кадр
+void AnimationEngine::captureBase() {
+    base.resize(frame.size());
+    for (int i = 0; i < frame.size(); ++i) {
+        ShapeFrame& b = base[i];
+        Shape* s = model->shapeById(frameIds[i]);
+        b.shape  = nullptr;
+        b.fields = 0;
+        if (!s)
+            continue;
+        b.fields = Shape::AnimatePos | Shape::AnimateColor | Shape::AnimateEnd;
+        b.pos    = s->pos();
+        b.color  = s->getColor();
+        b.endPos = s->getEndPos();
+    }
+}
+
+void AnimationEngine::restoreBase() {
+    if (base.isEmpty())
+        return;
+    // Возвращается только то, что с последнего кадра никто не трогал:
+    // правка, Undo или Redo во время просмотра остаются в документе
+    for (int i = 0; i < base.size(); ++i) {
+        ShapeFrame& b = base[i];
+        b.shape = model->shapeById(frameIds[i]);
+        if (!b.shape)
+            continue;
+        const ShapeFrame& f = frame.at(i);
+        const bool framed = f.shape == b.shape;
+        const QPointF pos    = framed && (f.fields & Shape::AnimatePos)   ? f.pos    : b.pos;
+        const QColor  color  = framed && (f.fields & Shape::AnimateColor) ? f.color  : b.color;
+        const QPointF endPos = framed && (f.fields & Shape::AnimateEnd)   ? f.endPos : b.endPos;
+        if (b.shape->pos() != pos)
+            b.fields &= ~Shape::AnimatePos;
+        if (b.shape->getColor() != color)
+            b.fields &= ~Shape::AnimateColor;
+        if (b.shape->getEndPos() != endPos)
+            b.fields &= ~Shape::AnimateEnd;
+    }
+    model->applyFrame(base);
+    base.clear();
+}
@@ -0,0 +1,107 @@
+// animationengine.h
+#ifndef ANIMATIONENGINE_H
+#define ANIMATIONENGINE_H
+
+#include <QObject>
+#include <QColor>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QPointF>
+#include <QTimer>
+#include <QVector>
+#include "graphicmodel.h"
+
+// Анимация свойств фигур по ключевым кадрам: позиция, цвет и конец фигуры.
+// Вместо QPropertyAnimation на каждое свойство — один таймер на все дорожки:
+// за кадр ключи всех дорожек обходятся одним циклом по упакованным массивам,
+// а результат уходит в модель одним пакетом (GraphicModel::applyFrame) с одной
+// перерисовкой. Ключи правятся в словарях по дорожкам и упаковываются заново
+// перед первым кадром после правки.
+// Воспроизведение — предпросмотр: в Undo и журнал кадры не попадают, а при
+// остановке (пауза, конец, очистка) фигурам возвращаются значения до запуска —
+// кроме свойств, изменённых за это время правкой (окно останавливает просмотр
+// перед щелчком по сцене и при любом изменении истории Undo).
+// Дорожки держатся за id фигур и каждый кадр находят фигуры через модель:
+// удалённые фигуры пропускаются, память из пула фигур повторно не путается.
+class AnimationEngine : public QObject {
+    Q_OBJECT
+public:
+    enum class Property : quint8 { Position, Color, EndPoint };
+
+    explicit AnimationEngine(GraphicModel* model, QObject* parent = nullptr);
+
+    // Ключ в момент time (секунды); между ключами значения интерполируются линейно
+    void setKey(Shape* shape, Property property, qreal time, const QPointF& value);
+    void setKey(Shape* shape, Property property, qreal time, const QColor& value);
+    // Ключи всех свойств по текущему состоянию фигуры
+    void setKeys(Shape* shape, qreal time);
+    void clear();
+
+    int   trackCount() const;
+    int   keyCount() const;
+    // Время последнего ключа
+    qreal duration() const;
+
+    void  play();
+    void  pause();
+    bool  isPlaying() const;
+    // Перейти к моменту; во время воспроизведения кадр применяется сразу
+    void  seek(qreal time);
+    qreal currentTime() const;
+
+    void  setLooping(bool looping);
+    bool  isLooping() const;
+
+signals:
+    void timeChanged(qreal time);
+    void finished();
+
+private slots:
+    void tick();
+
+private:
+    // Значение ключа: x, y или r, g, b, a
+    struct Value {
+        qreal v[4];
+    };
+    // Упакованная дорожка: ключи лежат подряд в times/values с индекса first
+    struct Track {
+        int      slot;       // фигура в frame
+        Property property;
+        int      first;
+        int      count;
+        int      cursor;     // последний сегмент: время обычно только растёт
+    };
+
+    void  setValue(Shape* shape, Property property, qreal time, const Value& value);
+    void  pack();
+    void  evaluate(qreal time);
+    void  captureBase();
+    void  restoreBase();
+    void  stop();
+
+    static quint64 trackKey(quint64 id, Property property);
+
+    GraphicModel*  model;
+    QTimer         timer;
+    QElapsedTimer  clock;
+    qreal          startTime;    // время на момент запуска clock
+    qreal          now;
+    bool           looping;
+
+    // Правка: ключи дорожки по времени
+    QHash<quint64, QMap<qreal, Value>> authored;
+    bool                               dirty;
+
+    // Воспроизведение: упакованные дорожки и кадр, который отдаётся модели
+    QVector<Track>      tracks;
+    QVector<qreal>      times;
+    QVector<Value>      values;
+    QVector<ShapeFrame> frame;
+    QVector<quint64>    frameIds;    // id фигуры каждого слота кадра
+    QVector<ShapeFrame> base;        // значения до запуска, по слотам кадра
+    qreal               length;
+};
+
+#endif // ANIMATIONENGINE_H
@@ -0,0 +1,258 @@
+// bezierpath.cpp
+#include "bezierpath.h"
+#include <QtMath>
+#include <cmath>
+
+namespace {
+
+// Допуск на экране при нижней границе корзины, px (у верхней — вдвое больше)
+const qreal kScreenTolerance = 0.25;
+const int   kMinBucket       = -10;
+const int   kMaxBucket       = 10;
+const int   kCachedBuckets   = 3;    // текущий зум и соседние при жесте туда-обратно
+const int   kMaxSteps        = 512;  // на сегмент
+
+qreal length(const QPointF& v) {
+    return qSqrt(QPointF::dotProduct(v, v));
+}
+
+QPointF toUnit(const QPointF& p, const QRectF& r) {
+    return QPointF(r.width()  != 0 ? (p.x() - r.left()) / r.width()  : 0,
+                   r.height() != 0 ? (p.y() - r.top())  / r.height() : 0);
+}
+
+QPointF fromUnit(const QPointF& p, const QRectF& r) {
+    return QPointF(r.left() + p.x() * r.width(), r.top() + p.y() * r.height());
+}
+
+// Шагов равномерного деления, при которых хорда отходит от кривой не дальше tol:
+// ошибка хорды не больше max|B''|·h²/8
+int stepsFor(qreal secondDerivative, qreal tol) {
+    const qreal n = std::ceil(qSqrt(secondDerivative / (8 * tol)));
+    return qBound(1, int(n), kMaxSteps);
+}
+
+} // namespace
+
+// ---------------- BezierSegment ----------------
+
+bool BezierSegment::operator==(const BezierSegment& o) const {
+    return kind == o.kind && c1 == o.c1 && end == o.end && (kind == Quadratic || c2 == o.c2);
+}
+
+// ---------------- BezierPath ----------------
+
+BezierPath::BezierPath() { }
+
+BezierPath::BezierPath(const QPointF& start)
+    : from(start)
+{ }
+
+void BezierPath::quadTo(const QPointF& c, const QPointF& end) {
+    segs.append(BezierSegment{ BezierSegment::Quadratic, c, QPointF(), end });
+}
+
+void BezierPath::cubicTo(const QPointF& c1, const QPointF& c2, const QPointF& end) {
+    segs.append(BezierSegment{ BezierSegment::Cubic, c1, c2, end });
+}
+
+bool BezierPath::isEmpty() const {
+    return segs.isEmpty();
+}
+
+QPointF BezierPath::start() const {
+    return from;
+}
+
+const QVector<BezierSegment>& BezierPath::segments() const {
+    return segs;
+}
+
+int BezierPath::pointCount() const {
+    int n = 1;
+    for (const BezierSegment& s : segs)
+        n += s.kind == BezierSegment::Cubic ? 3 : 2;
+    return n;
+}
+
+QRectF BezierPath::controlBounds() const {
+    qreal x0 = from.x(), x1 = from.x(), y0 = from.y(), y1 = from.y();
+    auto grow = [&](const QPointF& p) {
+        x0 = qMin(x0, p.x()); x1 = qMax(x1, p.x());
+        y0 = qMin(y0, p.y()); y1 = qMax(y1, p.y());
+    };
+    for (const BezierSegment& s : segs) {
+        grow(s.c1);
+        if (s.kind == BezierSegment::Cubic)
+            grow(s.c2);
+        grow(s.end);
+    }
+    return QRectF(QPointF(x0, y0), QPointF(x1, y1));
+}
+
+BezierPath BezierPath::normalized(const QRectF& r) const {
+    BezierPath out(toUnit(from, r));
+    out.segs.reserve(segs.size());
+    for (const BezierSegment& s : segs)
+        out.segs.append(BezierSegment{ s.kind, toUnit(s.c1, r), toUnit(s.c2, r), toUnit(s.end, r) });
+    return out;
+}
+
+BezierPath BezierPath::mapped(const QRectF& r) const {
+    BezierPath out(fromUnit(from, r));
+    out.segs.reserve(segs.size());
+    for (const BezierSegment& s : segs)
+        out.segs.append(BezierSegment{ s.kind, fromUnit(s.c1, r), fromUnit(s.c2, r), fromUnit(s.end, r) });
+    return out;
+}
+
+QPolygonF BezierPath::flatten(qreal tol) const {
+    QPolygonF out;
+    out.append(from);
+    QPointF p0 = from;
+    for (const BezierSegment& s : segs) {
+        if (s.kind == BezierSegment::Quadratic) {
+            // B'' = 2(p0 − 2c + p2), постоянна
+            const QPointF p1 = s.c1, p2 = s.end;
+            const int n = stepsFor(2 * length(p0 - 2 * p1 + p2), tol);
+            for (int i = 1; i <= n; ++i) {
+                const qreal t = qreal(i) / n, u = 1 - t;
+                out.append(u * u * p0 + 2 * u * t * p1 + t * t * p2);
+            }
+        } else {
+            // |B''| ≤ 6·max(|p0 − 2p1 + p2|, |p1 − 2p2 + p3|)
+            const QPointF p1 = s.c1, p2 = s.c2, p3 = s.end;
+            const qreal d = qMax(length(p0 - 2 * p1 + p2), length(p1 - 2 * p2 + p3));
+            const int n = stepsFor(6 * d, tol);
+            for (int i = 1; i <= n; ++i) {
+                const qreal t = qreal(i) / n, u = 1 - t;
+                out.append(u * u * u * p0 + 3 * u * u * t * p1 + 3 * u * t * t * p2 + t * t * t * p3);
+            }
+        }
+        p0 = s.end;
+    }
+    return out;
+}
+
+QPainterPath BezierPath::toPainterPath() const {
+    QPainterPath p(from);
+    for (const BezierSegment& s : segs) {
+        if (s.kind == BezierSegment::Quadratic)
+            p.quadTo(s.c1, s.end);
+        else
+            p.cubicTo(s.c1, s.c2, s.end);
+    }
+    return p;
+}
+
+BezierPath BezierPath::smoothed(const QPolygonF& pts) {
+    if (pts.isEmpty())
+        return BezierPath();
+    BezierPath out(pts.first());
+    if (pts.size() < 3) {
+        // Отрезок — вырожденная квадратичная кривая
+        const QPointF end = pts.last();
+        out.quadTo((pts.first() + end) / 2, end);
+        return out;
+    }
+    // Вершины ломаной — контрольные точки, середины рёбер — стыки сегментов
+    for (int i = 1; i < pts.size() - 1; ++i) {
+        const QPointF mid = i + 1 < pts.size() - 1 ? (pts.at(i) + pts.at(i + 1)) / 2 : pts.last();
+        out.quadTo(pts.at(i), mid);
+    }
+    return out;
+}
+
+void BezierPath::extendSmoothed(const QPolygonF& pts) {
+    const int n = pts.size();
+    // До трёх точек путь — вырожденный отрезок, он строится заново
+    if (n <= 3 || segs.isEmpty()) {
+        *this = smoothed(pts);
+        return;
+    }
+    // Последний сегмент шёл в прежнюю последнюю точку — теперь в середину ребра
+    segs.last().end = (pts.at(n - 3) + pts.at(n - 2)) / 2;
+    quadTo(pts.at(n - 2), pts.last());
+}
+
+BezierPath BezierPath::sCurve() {
+    BezierPath out(QPointF(0, 1));
+    out.cubicTo(QPointF(0.6, 1), QPointF(0.4, 0), QPointF(1, 0));
+    return out;
+}
+
+bool BezierPath::operator==(const BezierPath& o) const {
+    return from == o.from && segs == o.segs;
+}
+
+QDataStream& operator<<(QDataStream& out, const BezierPath& path) {
+    out << path.start() << quint32(path.segments().size());
+    for (const BezierSegment& s : path.segments()) {
+        out << quint8(s.kind) << s.c1;
+        if (s.kind == BezierSegment::Cubic)
+            out << s.c2;
+        out << s.end;
+    }
+    return out;
+}
+
+QDataStream& operator>>(QDataStream& in, BezierPath& path) {
+    QPointF start;
+    quint32 count = 0;
+    in >> start >> count;
+    path = BezierPath(start);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint8  kind = 0;
+        QPointF c1, c2, end;
+        in >> kind >> c1;
+        if (kind == BezierSegment::Cubic)
+            in >> c2;
+        in >> end;
+        if (kind == BezierSegment::Cubic)
+            path.cubicTo(c1, c2, end);
+        else
+            path.quadTo(c1, end);
+    }
+    return in;
+}
+
+// ---------------- FlatteningCache ----------------
+
+int FlatteningCache::bucketFor(qreal scale) {
+    if (!(scale > 0))
+        return 0;
+    return qBound(kMinBucket, int(std::floor(std::log2(scale))), kMaxBucket);
+}
+
+qreal FlatteningCache::toleranceFor(int bucket) {
+    return kScreenTolerance / std::ldexp(1.0, bucket);
+}
+
+const QPolygonF* FlatteningCache::find(int bucket) const {
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (entries.at(i).bucket != bucket)
+            continue;
+        if (i != entries.size() - 1)
+            entries.move(i, entries.size() - 1);
+        return &entries.last().polyline;
+    }
+    return nullptr;
+}
+
+const QPolygonF& FlatteningCache::insert(int bucket, const QPolygonF& polyline) const {
+    if (entries.size() >= kCachedBuckets)
+        entries.removeFirst();
+    entries.append(Entry{ bucket, polyline });
+    return entries.last().polyline;
+}
+
+void FlatteningCache::clear() {
+    entries.clear();
+}
+
+qint64 FlatteningCache::bytes() const {
+    qint64 total = 0;
+    for (const Entry& e : entries)
+        total += qint64(e.polyline.capacity()) * qint64(sizeof(QPointF));
+    return total;
+}
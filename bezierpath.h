@@ -0,0 +1,99 @@
+// bezierpath.h
+#ifndef BEZIERPATH_H
+#define BEZIERPATH_H
+
+#include <QDataStream>
+#include <QPainterPath>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+#include <QVector>
+
+// Сегмент пути: квадратичная (одна контрольная точка) или кубическая (две) кривая
+struct BezierSegment {
+    enum Kind : quint8 { Quadratic, Cubic };
+
+    Kind    kind;
+    QPointF c1;
+    QPointF c2;     // только у кубической
+    QPointF end;
+
+    bool operator==(const BezierSegment& other) const;
+};
+
+// Путь из квадратичных и кубических сегментов Безье, начинающийся в start
+class BezierPath {
+public:
+    BezierPath();
+    explicit BezierPath(const QPointF& start);
+
+    void quadTo (const QPointF& c, const QPointF& end);
+    void cubicTo(const QPointF& c1, const QPointF& c2, const QPointF& end);
+
+    bool    isEmpty() const;
+    QPointF start() const;
+    const QVector<BezierSegment>& segments() const;
+    int     pointCount() const;
+
+    // Габариты контрольных точек: кривые лежат в выпуклой оболочке своих точек
+    QRectF controlBounds() const;
+
+    // Точки из rect в единичный квадрат и обратно (нулевая сторона — в 0).
+    // Фигура хранит путь нормированным и растягивает его на прямоугольник фигуры
+    BezierPath normalized(const QRectF& rect) const;
+    BezierPath mapped(const QRectF& rect) const;
+
+    // Ломаная, отстоящая от кривых не дальше tolerance. Число шагов сегмента
+    // выводится из оценки второй производной, так что пологие участки дёшевы
+    QPolygonF flatten(qreal tolerance) const;
+
+    QPainterPath toPainterPath() const;
+
+    // Сглаживание ломаной от руки: цепочка квадратичных сегментов через середины рёбер
+    static BezierPath smoothed(const QPolygonF& points);
+    // То же по мере рисования: путь построен по points без последней точки, а теперь
+    // продолжается ею. Меняется только конец последнего сегмента и добавляется новый —
+    // все сегменты, кроме последнего, после этого окончательные
+    void extendSmoothed(const QPolygonF& points);
+    // S-образная кубическая кривая в единичном квадрате (из левого нижнего угла в правый верхний)
+    static BezierPath sCurve();
+
+    bool operator==(const BezierPath& other) const;
+    bool operator!=(const BezierPath& other) const { return !(*this == other); }
+
+private:
+    QPointF                from;
+    QVector<BezierSegment> segs;
+};
+
+QDataStream& operator<<(QDataStream& out, const BezierPath& path);
+QDataStream& operator>>(QDataStream& in, BezierPath& path);
+
+// Ломаные пути по корзинам допуска. Корзина — двоичный порядок масштаба вида:
+// в пределах корзины ломаная одна и та же и берётся из кэша, новая строится,
+// только когда зум переходит в другую корзину или меняется сам путь.
+// Отдалённый вид получает грубую дешёвую ломаную, приближенный — гладкую кривую.
+// Только для GUI-потока (пишется из const-методов отрисовки и попаданий)
+class FlatteningCache {
+public:
+    static int   bucketFor(qreal scale);
+    // Допуск корзины в координатах фигуры: на экране — не больше полупикселя
+    static qreal toleranceFor(int bucket);
+
+    // Ломаная корзины или nullptr; найденная становится самой свежей
+    const QPolygonF* find(int bucket) const;
+    // Запомнить ломаную, вытеснив самую давнюю корзину; ссылка живёт до следующей вставки
+    const QPolygonF& insert(int bucket, const QPolygonF& polyline) const;
+    void  clear();
+
+    qint64 bytes() const;
+
+private:
+    struct Entry {
+        int       bucket;
+        QPolygonF polyline;
+    };
+    mutable QVector<Entry> entries;   // самая свежая — в конце
+};
+
+#endif // BEZIERPATH_H
@@ -7,11 +7,28 @@
 #include <QFont>
 #include <QPointF>
 #include <QList>
+#include <QVector>
+#include <algorithm>
 #include "graphicmodel.h"
 #include "shape.h"
+#include "operationjournal.h"
+#include "memorypool.h"
+#include "shapeclipboard.h"
+
+// Команды Undo копятся тысячами — держим их в отдельном пуле,
+// чтобы объём истории было видно в учёте памяти
+class PooledCommand {
+public:
+    static void* operator new(std::size_t size) {
+        return commandMemoryPool().allocate(size);
+    }
+    static void operator delete(void* p, std::size_t size) {
+        commandMemoryPool().deallocate(p, size);
+    }
+};
 
 // Добавление новой фигуры
-class AddShapeCommand : public QUndoCommand {
+class AddShapeCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
 public:
     AddShapeCommand(GraphicModel* model,
                     ShapeType type,
@@ -34,13 +51,18 @@ public:
 
     void redo() override {
         if (!m_shape) {
-            m_model->addShape(m_type, m_pos, m_color, m_font);
-            m_shape = m_model->getShapes().last();
+            m_shape = m_model->addShape(m_type, m_pos, m_color, m_font);
         } else {
             m_model->addExistingShape(m_shape);
         }
     }
 
+    void journalRedo(OperationJournal* j) const override { j->recordAdd(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordRemove(m_shape); }
+
+    // Созданная фигура (после первого redo)
+    Shape* shape() const { return m_shape; }
+
 private:
     GraphicModel* m_model;
     ShapeType     m_type;
@@ -51,7 +73,7 @@ private:
 };
 
 // Удаление фигуры
-class DeleteShapeCommand : public QUndoCommand {
+class DeleteShapeCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
 public:
     DeleteShapeCommand(GraphicModel* model,
                        Shape* shape,
@@ -69,13 +91,16 @@ public:
         m_model->removeExistingShape(m_shape);
     }
 
+    void journalRedo(OperationJournal* j) const override { j->recordRemove(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordAdd(m_shape); }
+
 private:
     GraphicModel* m_model;
     Shape*        m_shape;
 };
 
 // Перемещение фигуры
-class MoveShapeCommand : public QUndoCommand {
+class MoveShapeCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
 public:
     MoveShapeCommand(Shape* shape,
                      const QPointF& from,
@@ -95,14 +120,138 @@ public:
         m_shape->setPos(m_to);
     }
 
+    void journalRedo(OperationJournal* j) const override { j->recordMove(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordMove(m_shape); }
+
 private:
     Shape*   m_shape;
     QPointF  m_from;
     QPointF  m_to;
 };
 
+// Изменение размера ручками: фигура уже растянута, команда помнит точки до и после
+class ResizeShapeCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
+public:
+    ResizeShapeCommand(Shape* shape,
+                       const QPointF& fromStart, const QPointF& fromEnd,
+                       const QPointF& toStart,   const QPointF& toEnd,
+                       QUndoCommand* parent = nullptr)
+        : QUndoCommand("Resize Shape", parent)
+        , m_shape(shape)
+        , m_fromStart(fromStart)
+        , m_fromEnd(fromEnd)
+        , m_toStart(toStart)
+        , m_toEnd(toEnd)
+    {}
+
+    void undo() override {
+        m_shape->setGeometry(m_fromStart, m_fromEnd);
+    }
+
+    void redo() override {
+        m_shape->setGeometry(m_toStart, m_toEnd);
+    }
+
+    void journalRedo(OperationJournal* j) const override { j->recordUpdate(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordUpdate(m_shape); }
+
+private:
+    Shape*   m_shape;
+    QPointF  m_fromStart;
+    QPointF  m_fromEnd;
+    QPointF  m_toStart;
+    QPointF  m_toEnd;
+};
+
+// Сдвиг пачки фигур одной командой (выравнивание, распределение);
+// модель уведомляется один раз на пакет
+class MoveShapesCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
+public:
+    MoveShapesCommand(GraphicModel* model,
+                      const QList<Shape*>& shapes,
+                      const QVector<QPointF>& to,
+                      const QString& text,
+                      QUndoCommand* parent = nullptr)
+        : QUndoCommand(text, parent)
+        , m_model(model)
+        , m_shapes(shapes)
+        , m_to(to)
+    {
+        m_from.reserve(shapes.size());
+        for (Shape* s : shapes)
+            m_from.append(s->pos());
+    }
+    // Фигуры уже сдвинуты (перетаскивание сценой): исходные позиции — явно
+    MoveShapesCommand(GraphicModel* model,
+                      const QList<Shape*>& shapes,
+                      const QVector<QPointF>& from,
+                      const QVector<QPointF>& to,
+                      const QString& text,
+                      QUndoCommand* parent = nullptr)
+        : QUndoCommand(text, parent)
+        , m_model(model)
+        , m_shapes(shapes)
+        , m_from(from)
+        , m_to(to)
+    {}
+
+    void undo() override {
+        m_model->moveShapes(m_shapes, m_from);
+    }
+
+    void redo() override {
+        m_model->moveShapes(m_shapes, m_to);
+    }
+
+    void journalRedo(OperationJournal* j) const override {
+        for (Shape* s : m_shapes)
+            j->recordMove(s);
+    }
+
+    void journalUndo(OperationJournal* j) const override {
+        for (Shape* s : m_shapes)
+            j->recordMove(s);
+    }
+
+private:
+    GraphicModel*    m_model;
+    QList<Shape*>    m_shapes;
+    QVector<QPointF> m_from;
+    QVector<QPointF> m_to;
+};
+
+// Правка текста на холсте: одна команда на сеанс ввода, а не на клавишу
+class SetTextCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
+public:
+    SetTextCommand(Shape* shape,
+                   const QString& oldText,
+                   const QString& newText,
+                   QUndoCommand* parent = nullptr)
+        : QUndoCommand("Edit Text", parent)
+        , m_shape(shape)
+        , m_oldText(oldText)
+        , m_newText(newText)
+    {}
+
+    void undo() override {
+        m_shape->setText(m_oldText);
+    }
+
+    void redo() override {
+        m_shape->setText(m_newText);
+    }
+
+    void journalRedo(OperationJournal* j) const override { j->recordUpdate(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordUpdate(m_shape); }
+
+private:
+    Shape*   m_shape;
+    QString  m_oldText;
+    QString  m_newText;
+};
+
 // Смена цвета
-class ColorCommand : public QUndoCommand {
+class ColorCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
 public:
     ColorCommand(Shape* shape,
                  const QColor& oldColor,
@@ -122,36 +271,188 @@ public:
         m_shape->setColor(m_newColor);
     }
 
+    void journalRedo(OperationJournal* j) const override { j->recordColor(m_shape); }
+    void journalUndo(OperationJournal* j) const override { j->recordColor(m_shape); }
+
 private:
     Shape*   m_shape;
     QColor   m_oldColor;
     QColor   m_newColor;
 };
 
-// Очистить всё (мягко удаляет, чтобы можно было вернуть)
-class ClearAllCommand : public QUndoCommand {
+// Очистить всё: модель меняет документ на пустой целиком, снятый документ живёт
+// в команде, и Undo меняет их обратно — без перебора фигур в обе стороны
+class ClearAllCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
 public:
-    ClearAllCommand(GraphicModel* model,
-                    const QList<Shape*>& shapes,
-                    QUndoCommand* parent = nullptr)
+    explicit ClearAllCommand(GraphicModel* model,
+                             QUndoCommand* parent = nullptr)
         : QUndoCommand("Clear All", parent)
         , m_model(model)
-        , m_shapes(shapes)
+        , m_stash(model->newDocument())
     {}
 
+    ~ClearAllCommand() override {
+        // В снятом документе могут быть миллионы фигур — удаляем его частями
+        // в GUI-потоке, чтобы сброс истории не подвешивал интерфейс
+        DocumentContent::disposeLater(m_stash);
+    }
+
     void undo() override {
-        for (Shape* s : m_shapes)
-            m_model->addExistingShape(s);
+        m_model->swapDocument(m_stash);
+    }
+
+    void redo() override {
+        m_model->swapDocument(m_stash);
+    }
+
+    void journalRedo(OperationJournal* j) const override {
+        j->recordClear();
+    }
+
+    // Вернувшийся документ пишется снимком, а не записью на каждую фигуру
+    void journalUndo(OperationJournal* j) const override {
+        j->checkpoint();
+    }
+
+private:
+    GraphicModel*    m_model;
+    DocumentContent* m_stash;   // документ, которого сейчас нет в модели
+};
+
+// Вставка или дублирование пачки фигур одной командой.
+// Новые фигуры делят данные с исходными, пока их не изменят
+class PasteShapesCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
+public:
+    PasteShapesCommand(GraphicModel* model,
+                       const QVector<ShapeClip>& clips,
+                       const QPointF& offset,
+                       const QString& text,
+                       QUndoCommand* parent = nullptr)
+        : QUndoCommand(text, parent)
+        , m_model(model)
+        , m_clips(clips)
+        , m_offset(offset)
+    {}
+
+    void undo() override {
+        m_model->removeExistingShapes(m_shapes);
     }
 
     void redo() override {
+        if (m_shapes.isEmpty()) {
+            m_shapes.reserve(m_clips.size());
+            for (const ShapeClip& c : m_clips) {
+                Shape* s = new Shape(c.data);
+                s->setPos(c.pos + m_offset);
+                m_shapes.append(s);
+            }
+            m_clips.clear();  // данные теперь держат сами фигуры
+        }
+        m_model->addExistingShapes(m_shapes);
+
+        // Выделяется только вставленное
+        m_model->clearSelection();
+        for (Shape* s : m_shapes)
+            s->setSelected(true);
+    }
+
+    void journalRedo(OperationJournal* j) const override {
+        for (Shape* s : m_shapes)
+            j->recordAdd(s);
+    }
+
+    void journalUndo(OperationJournal* j) const override {
         for (Shape* s : m_shapes)
-            m_model->removeExistingShape(s);
+            j->recordRemove(s);
     }
 
 private:
     GraphicModel*      m_model;
+    QVector<ShapeClip> m_clips;
+    QPointF            m_offset;
     QList<Shape*>      m_shapes;
 };
 
+// Порядок наложения: «наверх», «вниз», перенос в другой слой.
+// Хранит точные места фигур до и после, Undo возвращает их без пересортировки.
+// В журнал пишется место каждой фигуры (слой и ключ z)
+class ReorderShapesCommand : public QUndoCommand, public JournaledCommand, public PooledCommand {
+public:
+    enum class Op { BringToFront, SendToBack, MoveToLayer };
+
+    ReorderShapesCommand(GraphicModel* model,
+                         const QList<Shape*>& shapes,
+                         Op op,
+                         Layer* target = nullptr,
+                         QUndoCommand* parent = nullptr)
+        : QUndoCommand(op == Op::BringToFront ? "Bring to Front"
+                       : op == Op::SendToBack ? "Send to Back"
+                                              : "Move to Layer", parent)
+        , m_model(model)
+        , m_op(op)
+        , m_target(target)
+    {
+        // Относительный порядок пачки сохраняется: сортируем по текущему месту
+        QList<Shape*> sorted = shapes;
+        std::sort(sorted.begin(), sorted.end(), [](Shape* a, Shape* b) {
+            const int la = a->getLayer()->getPosition();
+            const int lb = b->getLayer()->getPosition();
+            return la != lb ? la < lb : a->getZKey() < b->getZKey();
+        });
+        // «Вниз» ставит фигуры под низ по одной — идём сверху вниз
+        if (op == Op::SendToBack)
+            std::reverse(sorted.begin(), sorted.end());
+        for (Shape* s : sorted)
+            m_before.append({s, s->getLayer(), s->getZKey()});
+    }
+
+    void undo() override {
+        for (int i = m_before.size() - 1; i >= 0; --i) {
+            const Placement& p = m_before.at(i);
+            m_model->placeShape(p.shape, p.layer, p.zKey);
+        }
+        m_model->getScene()->update();
+    }
+
+    void redo() override {
+        if (m_after.isEmpty()) {
+            for (const Placement& p : m_before) {
+                switch (m_op) {
+                case Op::BringToFront: m_model->bringToFront(p.shape);          break;
+                case Op::SendToBack:   m_model->sendToBack(p.shape);            break;
+                case Op::MoveToLayer:  m_model->moveToLayer(p.shape, m_target); break;
+                }
+                m_after.append({p.shape, p.shape->getLayer(), p.shape->getZKey()});
+            }
+        } else {
+            for (const Placement& p : m_after)
+                m_model->placeShape(p.shape, p.layer, p.zKey);
+        }
+        m_model->getScene()->update();
+    }
+
+    void journalRedo(OperationJournal* j) const override {
+        for (const Placement& p : m_before)
+            j->recordPlace(p.shape);
+    }
+
+    void journalUndo(OperationJournal* j) const override {
+        for (const Placement& p : m_before)
+            j->recordPlace(p.shape);
+    }
+
+private:
+    struct Placement {
+        Shape* shape;
+        Layer* layer;
+        qint64 zKey;
+    };
+
+    GraphicModel*     m_model;
+    Op                m_op;
+    Layer*            m_target;
+    QVector<Placement> m_before;
+    QVector<Placement> m_after;
+};
+
 #endif // COMMANDS_H
@@ -1,15 +1,230 @@
 #include "customgraphicsscene.h"
+#include "shape.h"
+#include "graphicmodel.h"
+#include <QPainter>
+#include <QtMath>
 
 CustomGraphicsScene::CustomGraphicsScene(QObject *parent)
     : QGraphicsScene(parent)
+    , m_model(nullptr)
+    , m_batched(false)
+    , m_draft(false)
+    , m_viewScale(1.0)
+    , m_frameDevice(nullptr)
+    , m_frameScale(1.0)
 {
 }
 
+void CustomGraphicsScene::setModel(GraphicModel *model)
+{
+    m_model = model;
+}
+
+GraphicModel *CustomGraphicsScene::getModel() const
+{
+    return m_model;
+}
+
+void CustomGraphicsScene::setBatchedRendering(bool enabled)
+{
+    if (m_batched == enabled)
+        return;
+    m_batched = enabled;
+    // Фигуры сами решают, рисоваться ли им пакетно, — сообщаем о смене режима
+    for (QGraphicsItem *item : items()) {
+        if (Shape *s = dynamic_cast<Shape *>(item))
+            s->updateBatchState();
+    }
+    update();
+}
+
+bool CustomGraphicsScene::isBatchedRendering() const
+{
+    return m_batched;
+}
+
+void CustomGraphicsScene::setDraftMode(bool enabled)
+{
+    m_draft = enabled;
+}
+
+bool CustomGraphicsScene::isDraftMode() const
+{
+    return m_draft;
+}
+
+void CustomGraphicsScene::setViewScale(qreal scale)
+{
+    m_viewScale = scale;
+}
+
+qreal CustomGraphicsScene::getViewScale() const
+{
+    return m_viewScale;
+}
+
+void CustomGraphicsScene::setHighlighted(const QSet<Shape *> &shapes)
+{
+    if (shapes == m_highlighted)
+        return;
+    // Перерисовать области снятой и новой подсветки
+    QRectF dirty;
+    for (Shape *s : m_highlighted)
+        dirty |= s->sceneBoundingRect();
+    for (Shape *s : shapes)
+        dirty |= s->sceneBoundingRect();
+    m_highlighted = shapes;
+    update(dirty);
+}
+
+void CustomGraphicsScene::drawBackground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsScene::drawBackground(painter, rect);
+    m_runs.clear();
+    m_runOf.clear();
+    if (!m_batched)
+        return;
+
+    // Вид рисует элементы по возрастанию z сразу после фона. Разбиваем их на серии
+    // подряд идущих пакетных фигур: серию целиком рисует первая её фигура,
+    // до которой дойдёт вид, — так корзины не всплывают над текстом и растрами
+    m_frameDevice    = painter->device();
+    m_frameTransform = painter->worldTransform();
+    m_frameScale     = qSqrt(qAbs(m_frameTransform.determinant()));
+    bool open = false;
+    for (QGraphicsItem *item : items(rect, Qt::IntersectsItemBoundingRect, Qt::AscendingOrder)) {
+        if (!item->isVisible())
+            continue;
+        const Shape *s = dynamic_cast<const Shape *>(item);
+        if (!s || !s->isBatched()) {
+            open = false;
+            continue;
+        }
+        if (!open) {
+            m_runs.append(BatchRun());
+            open = true;
+        }
+        m_runs.last().shapes.append(s);
+        m_runOf.insert(s, m_runs.size() - 1);
+    }
+}
+
+bool CustomGraphicsScene::paintBatched(QPainter *painter, const Shape *shape)
+{
+    // Серии действительны только внутри кадра вида, который их собрал
+    if (painter->device() != m_frameDevice)
+        return false;
+    const auto it = m_runOf.constFind(shape);
+    if (it == m_runOf.constEnd())
+        return false;
+    BatchRun &run = m_runs[it.value()];
+    if (run.drawn)
+        return true;
+    run.drawn = true;
+
+    painter->save();
+    painter->setWorldTransform(m_frameTransform);
+    m_batch.setScale(m_frameScale);
+    m_batch.begin(painter, m_draft);
+    for (const Shape *s : run.shapes)
+        m_batch.add(s);
+    m_batch.end();
+    painter->restore();
+    return true;
+}
+
+void CustomGraphicsScene::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    // Элементы кадра нарисованы — серии больше не нужны: paint() вне кадра вида
+    // (растр слоя, экспорт через render) рисует фигуру сам
+    m_runs.clear();
+    m_runOf.clear();
+    m_frameDevice = nullptr;
+
+    QGraphicsScene::drawForeground(painter, rect);
+    if (!m_highlighted.isEmpty()) {
+        QPen hit(Qt::red, 2);
+        hit.setCosmetic(true);
+        painter->save();
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(hit);
+        for (Shape *s : m_highlighted)
+            if (s->sceneBoundingRect().intersects(rect))
+                painter->drawRect(s->outlineRect().translated(s->scenePos()));
+        painter->restore();
+    }
+    if (!m_model || m_model->getSelection()->isEmpty())
+        return;
+
+    QPen frame(Qt::blue, 1, Qt::DashLine);
+    frame.setCosmetic(true);
+    QPen handle(Qt::black, 1);
+    handle.setCosmetic(true);
+
+    painter->save();
+    for (Shape *s : m_model->getSelection()->set()) {
+        if (!s->sceneBoundingRect().intersects(rect))
+            continue;
+        painter->save();
+        painter->translate(s->scenePos());
+        const QRectF outline = s->outlineRect();
+        if (s->getType() == ShapeType::Text)
+            painter->fillRect(outline, QColor(0, 120, 215, 50));
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(frame);
+        painter->drawRect(outline);
+        if (s->getType() != ShapeType::Text) {
+            painter->setBrush(Qt::white);
+            painter->setPen(handle);
+            for (int i = Shape::TopLeft; i <= Shape::BottomRight; ++i)
+                painter->drawRect(s->getHandleRect(Shape::ResizeHandle(i)));
+        }
+        painter->restore();
+    }
+    painter->restore();
+}
+
+Qt::CursorShape CustomGraphicsScene::cursorAt(const QPointF &scenePos) const
+{
+    if (!m_model)
+        return Qt::ArrowCursor;
+    for (Shape *s : m_model->getSelection()->set()) {
+        switch (s->getResizeHandle(s->mapFromScene(scenePos))) {
+        case Shape::TopLeft:
+        case Shape::BottomRight:
+            return Qt::SizeFDiagCursor;
+        case Shape::TopRight:
+        case Shape::BottomLeft:
+            return Qt::SizeBDiagCursor;
+        case Shape::None:
+            break;
+        }
+    }
+    return Qt::ArrowCursor;
+}
+
 void CustomGraphicsScene::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
+    emit sceneMousePressStarting();
+
+    // Щелчок без Ctrl мимо выделенного снимает выделение, но сцена снимает его
+    // только со своих элементов — выделенным вне сцены (виртуализация) его снимает модель
+    QSet<QGraphicsItem *> selectedUnder;
+    for (QGraphicsItem *item : items(event->scenePos()))
+        if (item->isSelected())
+            selectedUnder.insert(item);
+
     QGraphicsScene::mousePressEvent(event);
+    if (m_model && event->button() == Qt::LeftButton
+        && !(event->modifiers() & Qt::ControlModifier)
+        && !selectedUnder.contains(mouseGrabberItem())) {
+        m_model->clearOffSceneSelection();
+    }
     if (!event->isAccepted()) {
         emit sceneMousePressed(event->scenePos());
+    } else if (event->button() == Qt::LeftButton) {
+        if (Shape *s = dynamic_cast<Shape *>(mouseGrabberItem()))
+            emit shapeDragStarted(s);
     }
 }
 
@@ -18,13 +233,38 @@ void CustomGraphicsScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
     QGraphicsScene::mouseMoveEvent(event);
     if (!event->isAccepted()) {
         emit sceneMouseMoved(event->scenePos());
+    } else if (dynamic_cast<Shape *>(mouseGrabberItem())) {
+        emit shapeDragged();
     }
 }
 
 void CustomGraphicsScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
 {
+    // После базовой обработки элемент уже отпустил мышь — проверяем до неё
+    Shape *dragged = dynamic_cast<Shape *>(mouseGrabberItem());
     QGraphicsScene::mouseReleaseEvent(event);
     if (!event->isAccepted()) {
         emit sceneMouseReleased();
+    } else if (dragged) {
+        emit shapeDragFinished(dragged);
+    }
+}
+
+void CustomGraphicsScene::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event)
+{
+    // Двойной щелчок по фигуре сама фигура не обрабатывает — сообщаем всегда
+    QGraphicsScene::mouseDoubleClickEvent(event);
+    if (event->button() == Qt::LeftButton) {
+        emit sceneMouseDoubleClicked(event->scenePos());
+    }
+}
+
+void CustomGraphicsScene::keyPressEvent(QKeyEvent *event)
+{
+    // Ввод текста на холсте получает клавишу раньше фигур и вида
+    event->ignore();
+    emit sceneKeyPressed(event);
+    if (!event->isAccepted()) {
+        QGraphicsScene::keyPressEvent(event);
     }
 }
@@ -3,6 +3,14 @@
 
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
+#include <QKeyEvent>
+#include <QSet>
+#include <QHash>
+#include <QTransform>
+#include <QVector>
+#include "shapebatch.h"
+
+class GraphicModel;
 
 class CustomGraphicsScene : public QGraphicsScene
 {
@@ -10,15 +18,77 @@ class CustomGraphicsScene : public QGraphicsScene
 public:
     explicit CustomGraphicsScene(QObject *parent = nullptr);
 
+    // Модель, которой фигуры сцены сообщают о своих изменениях
+    void setModel(GraphicModel *model);
+    GraphicModel *getModel() const;
+
+    // Пакетная отрисовка: подряд идущие по z простые фигуры рисуются корзинами
+    // одним проходом, когда вид доходит до первой из них, а не каждая своим paint().
+    // Текст, изображения и растры слоёв разрывают такие серии и рисуются на своём месте
+    void setBatchedRendering(bool enabled);
+    bool isBatchedRendering() const;
+    // Вызывается из Shape::paint пакетной фигуры: true — фигура уже нарисована
+    // (или будет нарисована) своей серией, false — фигуре рисоваться самой
+    bool paintBatched(QPainter *painter, const Shape *shape);
+
+    // Черновой режим на время зума/панорамы: тонкие перья, текст — полосой
+    void setDraftMode(bool enabled);
+    bool isDraftMode() const;
+
+    // Масштаб основного вида: по нему фигуры-пути выбирают ломаную для попаданий
+    void  setViewScale(qreal scale);
+    qreal getViewScale() const;
+
+    // Подсветка пересечений при перетаскивании: красные рамки в оверлее
+    void setHighlighted(const QSet<Shape *> &shapes);
+
+    // Курсор над ручками выделенных фигур; проверяются только выделенные
+    Qt::CursorShape cursorAt(const QPointF &scenePos) const;
+
 signals:
+    // Любое нажатие до разбора сценой, в том числе по фигуре, которая его примет
+    void sceneMousePressStarting();
     void sceneMousePressed(const QPointF &pos);
     void sceneMouseMoved(const QPointF &pos);
     void sceneMouseReleased();
+    void sceneMouseDoubleClicked(const QPointF &pos);
+    // Фигуру тащит сама Qt (элемент принял нажатие): вместе с ней двигаются
+    // выделенные элементы сцены, а sceneMouse* в это время не приходят
+    void shapeDragStarted(Shape *shape);
+    void shapeDragged();
+    void shapeDragFinished(Shape *shape);
+    // Клавиша до обработки сценой; принятое обработчиком событие дальше не идёт
+    void sceneKeyPressed(QKeyEvent *event);
 
 protected:
+    // Разбор видимых фигур кадра на серии пакетной отрисовки
+    void drawBackground(QPainter *painter, const QRectF &rect) override;
+    // Оверлей: подсветка пересечений, рамки и ручки всех выделенных фигур одним проходом
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    GraphicModel *m_model;
+    bool          m_batched;
+    bool          m_draft;
+    qreal         m_viewScale;
+    ShapeBatch    m_batch;
+
+    // Серии пакетных фигур текущего кадра (по возрастанию z), см. drawBackground
+    struct BatchRun {
+        QVector<const Shape *> shapes;
+        bool                   drawn = false;
+    };
+    QVector<BatchRun>          m_runs;
+    QHash<const Shape *, int>  m_runOf;
+    QPaintDevice              *m_frameDevice;      // устройство вида, рисующего кадр
+    QTransform                 m_frameTransform;   // сцена -> устройство вида, рисующего кадр
+    qreal                      m_frameScale;
+    QSet<Shape *> m_highlighted;
 };
 
 #endif // CUSTOMGRAPHICSSCENE_H
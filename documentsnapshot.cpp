@@ -0,0 +1,40 @@
+// documentsnapshot.cpp
+#include "documentsnapshot.h"
+
+DocumentSnapshot::DocumentSnapshot()
+    : version(0)
+    , total(0)
+{ }
+
+quint64 DocumentSnapshot::getVersion() const {
+    return version;
+}
+
+QRectF DocumentSnapshot::getSceneRect() const {
+    return sceneRect;
+}
+
+int DocumentSnapshot::shapeCount() const {
+    return total;
+}
+
+bool DocumentSnapshot::isEmpty() const {
+    return total == 0;
+}
+
+int DocumentSnapshot::layerCount() const {
+    return layers.size();
+}
+
+const LayerSnapshot& DocumentSnapshot::layer(int index) const {
+    return *layers.at(index);
+}
+
+QVector<SnapshotShape> DocumentSnapshot::shapes(bool visibleOnly) const {
+    QVector<SnapshotShape> all;
+    all.reserve(total);
+    for (const auto& l : layers)
+        if (l->visible || !visibleOnly)
+            all += l->shapes;
+    return all;
+}
@@ -0,0 +1,69 @@
+// documentsnapshot.h
+#ifndef DOCUMENTSNAPSHOT_H
+#define DOCUMENTSNAPSHOT_H
+
+#include <QMetaType>
+#include <QPointF>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "shape.h"
+
+// Фигура в снимке: общие данные (copy-on-write) и положение на сцене.
+// Данные неизменяемы — правка живой фигуры отделит её собственную копию
+struct SnapshotShape {
+    quint64                       id = 0;
+    QSharedDataPointer<ShapeData> data;
+    QPointF                       pos;
+    qint64                        zKey = 0;   // место в слое (журнал восстанавливает по нему)
+
+    const ShapeData& shape() const { return *data.constData(); }
+    // Как Shape::sceneBoundingRect
+    QRectF sceneRect() const { return shape().boundingRect().translated(pos); }
+};
+
+// Слой в снимке; разделяется между версиями, пока слой не изменят
+struct LayerSnapshot {
+    QString                name;
+    bool                   visible = true;
+    bool                   locked  = false;
+    QVector<SnapshotShape> shapes;      // снизу вверх
+};
+
+// Неизменяемая версия документа для чтения вне GUI-потока (экспорт, автосохранение,
+// поиск, миниатюры). Снимок собирается из снимков слоёв, которые модель кэширует:
+// после правки пересобирается только затронутый слой, а копирование самого
+// снимка — это копия вектора указателей на слои. Читатели не берут блокировок
+// и не трогают QGraphicsItem. Кэши ShapeData (hitPath и т.п.) из других потоков
+// читать только через константные поля, без ленивых вычислений QPainterPath.
+class DocumentSnapshot {
+public:
+    DocumentSnapshot();
+
+    // Растёт с каждой правкой документа; равные версии — одинаковое содержимое
+    quint64 getVersion() const;
+    QRectF  getSceneRect() const;
+
+    int  shapeCount() const;
+    bool isEmpty() const;
+
+    // Слои снизу вверх
+    int                  layerCount() const;
+    const LayerSnapshot& layer(int index) const;
+
+    // Все фигуры в порядке наложения; visibleOnly — без скрытых слоёв
+    QVector<SnapshotShape> shapes(bool visibleOnly = false) const;
+
+private:
+    friend class GraphicModel;
+
+    QVector<QSharedPointer<const LayerSnapshot>> layers;
+    QRectF  sceneRect;
+    quint64 version;
+    int     total;
+};
+
+Q_DECLARE_METATYPE(DocumentSnapshot)
+
+#endif // DOCUMENTSNAPSHOT_H
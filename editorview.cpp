@@ -0,0 +1,248 @@
+// editorview.cpp
+#include "editorview.h"
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <QWheelEvent>
+#include <QtMath>
+
+namespace {
+
+const qreal kMinZoom      = 0.05;
+const qreal kMaxZoom      = 40.0;
+const qreal kWheelStep    = 1.25;   // множитель зума на щелчок колеса (120 единиц)
+
+const int   kTickMs       = 16;     // шаг инерции ~60 Гц
+const qreal kFriction     = 0.94;   // доля скорости, остающаяся за шаг
+const qreal kMinSpeed     = 0.05;   // px/мс: медленнее — инерция останавливается
+const int   kReleaseStillMs = 60;   // мышь стояла дольше перед отпусканием — без инерции
+
+const int   kIdleMs       = 150;    // пауза колеса, после которой жест закончен
+const qreal kFrameBudgetMs = 12.0;  // 60 fps с запасом на композицию окна
+
+} // namespace
+
+EditorView::EditorView(CustomGraphicsScene* scene, QWidget* parent)
+    : QGraphicsView(scene, parent)
+    , source(scene)
+    , quality(Quality::Full)
+    , inGesture(false)
+    , panning(false)
+    , frameMs(0)
+    , hoverCursor(Qt::ArrowCursor)
+{
+    setRenderHint(QPainter::Antialiasing);
+    // Точку под курсором держим сами: стандартный якорь опирается на последнее
+    // движение мыши и сбивается при прокрутке колесом без движения
+    setTransformationAnchor(QGraphicsView::NoAnchor);
+    setResizeAnchor(QGraphicsView::AnchorViewCenter);
+
+    kinetic.setInterval(kTickMs);
+    connect(&kinetic, &QTimer::timeout, this, &EditorView::onKineticTick);
+    idle.setSingleShot(true);
+    connect(&idle, &QTimer::timeout, this, &EditorView::onGestureIdle);
+}
+
+qreal EditorView::getZoom() const {
+    return transform().m11();
+}
+
+void EditorView::setZoom(qreal zoom) {
+    zoom = qBound(kMinZoom, zoom, kMaxZoom);
+    const qreal f = zoom / getZoom();
+    if (qFuzzyCompare(f, 1.0))
+        return;
+    scale(f, f);
+    source->setViewScale(zoom);
+    emit zoomChanged(zoom);
+    emit visibleRectChanged(visibleRect());
+}
+
+EditorView::Quality EditorView::getQuality() const {
+    return quality;
+}
+
+qreal EditorView::getFrameTime() const {
+    return frameMs;
+}
+
+QRectF EditorView::visibleRect() const {
+    return mapToScene(viewport()->rect()).boundingRect();
+}
+
+void EditorView::resizeEvent(QResizeEvent* event) {
+    QGraphicsView::resizeEvent(event);
+    emit visibleRectChanged(visibleRect());
+}
+
+void EditorView::scrollContentsBy(int dx, int dy) {
+    QGraphicsView::scrollContentsBy(dx, dy);
+    emit visibleRectChanged(visibleRect());
+}
+
+// ---------------- Зум ----------------
+
+void EditorView::wheelEvent(QWheelEvent* event) {
+    const int steps = event->angleDelta().y();
+    if (steps == 0) {
+        QGraphicsView::wheelEvent(event);
+        return;
+    }
+    beginGesture();
+    idle.start(kIdleMs);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QPointF at = event->position();
+#else
+    const QPointF at = event->posF();
+#endif
+    // Точка сцены под курсором остаётся под курсором
+    const QPointF anchor = mapToScene(at.toPoint());
+    setZoom(getZoom() * qPow(kWheelStep, steps / 120.0));
+    scrollByPixels(QPointF(mapFromScene(anchor)) - at);
+    event->accept();
+}
+
+// ---------------- Панорама и инерция ----------------
+
+void EditorView::mousePressEvent(QMouseEvent* event) {
+    if (event->button() != Qt::MiddleButton) {
+        // Щелчок останавливает инерцию, как на тачпаде
+        if (kinetic.isActive()) {
+            kinetic.stop();
+            endGesture();
+        }
+        QGraphicsView::mousePressEvent(event);
+        return;
+    }
+    kinetic.stop();
+    beginGesture();
+    panning   = true;
+    panLast   = event->pos();
+    velocity  = QPointF();
+    remainder = QPointF();
+    panClock.start();
+    viewport()->setCursor(Qt::ClosedHandCursor);
+    event->accept();
+}
+
+void EditorView::mouseMoveEvent(QMouseEvent* event) {
+    if (!panning) {
+        if (event->buttons() == Qt::NoButton)
+            updateHoverCursor(event->pos());
+        QGraphicsView::mouseMoveEvent(event);
+        return;
+    }
+    const QPoint delta = event->pos() - panLast;
+    panLast = event->pos();
+    scrollByPixels(-QPointF(delta));
+
+    // Скорость сглаживается по последним движениям, чтобы рывок не решал всё
+    const qreal dt = qMax<qint64>(1, panClock.restart());
+    velocity = 0.7 * (-QPointF(delta) / dt) + 0.3 * velocity;
+    event->accept();
+}
+
+void EditorView::mouseReleaseEvent(QMouseEvent* event) {
+    if (!panning || event->button() != Qt::MiddleButton) {
+        QGraphicsView::mouseReleaseEvent(event);
+        return;
+    }
+    panning = false;
+    viewport()->unsetCursor();
+    hoverCursor = Qt::ArrowCursor;
+    if (panClock.elapsed() > kReleaseStillMs)
+        velocity = QPointF();
+
+    if (velocity.manhattanLength() > kMinSpeed) {
+        kineticClock.start();
+        kinetic.start();
+    } else {
+        endGesture();
+    }
+    event->accept();
+}
+
+void EditorView::onKineticTick() {
+    const qreal dt = qMax<qint64>(1, kineticClock.restart());
+    const bool moved = scrollByPixels(velocity * dt);
+    velocity *= qPow(kFriction, dt / kTickMs);
+    if (!moved || velocity.manhattanLength() < kMinSpeed) {
+        kinetic.stop();
+        endGesture();
+    }
+}
+
+bool EditorView::scrollByPixels(const QPointF& delta) {
+    QScrollBar* h = horizontalScrollBar();
+    QScrollBar* v = verticalScrollBar();
+    const int oldH = h->value();
+    const int oldV = v->value();
+
+    // Полосы прокрутки целочисленные — дробный остаток переносится в следующий шаг
+    const QPointF want = delta + remainder;
+    const QPoint  step(qRound(want.x()), qRound(want.y()));
+    remainder = want - QPointF(step);
+    h->setValue(oldH + step.x());
+    v->setValue(oldV + step.y());
+    return step.isNull() || h->value() != oldH || v->value() != oldV;
+}
+
+void EditorView::updateHoverCursor(const QPoint& viewPos) {
+    const Qt::CursorShape c = source->cursorAt(mapToScene(viewPos));
+    if (c == hoverCursor)
+        return;
+    hoverCursor = c;
+    viewport()->setCursor(c);
+}
+
+// ---------------- Регулятор качества ----------------
+
+void EditorView::onGestureIdle() {
+    if (!panning && !kinetic.isActive())
+        endGesture();
+}
+
+void EditorView::beginGesture() {
+    if (inGesture)
+        return;
+    inGesture = true;
+    // Начинаем с уровня, на котором закончился прошлый жест
+    applyQuality(frameMs > kFrameBudgetMs ? Quality::Draft : Quality::Fast);
+}
+
+void EditorView::endGesture() {
+    if (!inGesture)
+        return;
+    inGesture = false;
+    idle.stop();
+    applyQuality(Quality::Full);
+}
+
+void EditorView::applyQuality(Quality q) {
+    if (q == quality)
+        return;
+    quality = q;
+    setRenderHint(QPainter::Antialiasing, q == Quality::Full);
+    source->setDraftMode(q == Quality::Draft);
+    viewport()->update();
+}
+
+void EditorView::paintEvent(QPaintEvent* event) {
+    if (!inGesture) {
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+    QElapsedTimer frame;
+    frame.start();
+    QGraphicsView::paintEvent(event);
+    const qreal ms = frame.nsecsElapsed() / 1e6;
+    frameMs = frameMs > 0 ? 0.7 * frameMs + 0.3 * ms : ms;
+
+    // Гистерезис: вниз — как только не укладываемся, вверх — с большим запасом
+    if (quality == Quality::Fast && frameMs > kFrameBudgetMs)
+        applyQuality(Quality::Draft);
+    else if (quality == Quality::Draft && frameMs < kFrameBudgetMs / 4)
+        applyQuality(Quality::Fast);
+}
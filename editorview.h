@@ -0,0 +1,79 @@
+// editorview.h
+#ifndef EDITORVIEW_H
+#define EDITORVIEW_H
+
+#include <QGraphicsView>
+#include <QElapsedTimer>
+#include <QPointF>
+#include <QTimer>
+#include "customgraphicsscene.h"
+
+// Основной вид редактора: зум колесом, панорама средней кнопкой с инерцией
+// и регулятор качества. Пока идёт жест (зум, панорама, инерция), вид рисует
+// без сглаживания и, если кадр всё равно не укладывается в бюджет, переводит
+// сцену в черновой режим. По окончании жеста возвращается полное качество.
+class EditorView : public QGraphicsView {
+    Q_OBJECT
+public:
+    enum class Quality { Full, Fast, Draft };
+
+    explicit EditorView(CustomGraphicsScene* scene, QWidget* parent = nullptr);
+
+    qreal   getZoom() const;
+    void    setZoom(qreal zoom);
+    Quality getQuality() const;
+
+    // Среднее время кадра за последний жест, мс
+    qreal   getFrameTime() const;
+
+    // Видимая область в координатах сцены
+    QRectF  visibleRect() const;
+
+signals:
+    void zoomChanged(qreal zoom);
+    // Видимая область сменилась (прокрутка, зум, размер окна) — для виртуализации сцены
+    void visibleRectChanged(const QRectF& rect);
+
+protected:
+    void wheelEvent  (QWheelEvent* event) override;
+    void mousePressEvent  (QMouseEvent* event) override;
+    void mouseMoveEvent   (QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void paintEvent  (QPaintEvent* event) override;
+    void resizeEvent (QResizeEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private slots:
+    void onKineticTick();
+    void onGestureIdle();
+
+private:
+    void beginGesture();
+    void endGesture();
+    void applyQuality(Quality q);
+    // false — упёрлись в край прокрутки
+    bool scrollByPixels(const QPointF& delta);
+    // Курсор над ручками выделения — от оверлея сцены, а не от наведения на фигуры
+    void updateHoverCursor(const QPoint& viewPos);
+
+    CustomGraphicsScene* source;
+    Quality       quality;
+    bool          inGesture;
+
+    // Панорама и инерция (скорость — пиксели вьюпорта в мс)
+    bool          panning;
+    QPoint        panLast;
+    QElapsedTimer panClock;
+    QPointF       velocity;
+    QPointF       remainder;    // дробная часть прокрутки между кадрами
+    QTimer        kinetic;
+    QElapsedTimer kineticClock;
+
+    // Регулятор: сглаженное время кадра и таймер конца жеста
+    qreal         frameMs;
+    QTimer        idle;
+
+    Qt::CursorShape hoverCursor;
+};
+
+#endif // EDITORVIEW_H
@@ -0,0 +1,97 @@
+// finddialog.cpp
+#include "finddialog.h"
+#include <QColorDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+FindDialog::FindDialog(GraphicController* c, GraphicModel* m, QWidget* parent)
+    : QDialog(parent)
+    , controller(c)
+    , model(m)
+    , typeCombo(new QComboBox(this))
+    , colorCheck(new QCheckBox("Color", this))
+    , colorBtn(new QPushButton(this))
+    , textEdit(new QLineEdit(this))
+    , resultLabel(new QLabel(this))
+    , color(Qt::black)
+{
+    setWindowTitle("Find Shapes");
+
+    typeCombo->addItem("Any");
+    for (int i = 0; i < kShapeTypeCount; ++i)
+        typeCombo->addItem(shapeTypeName(ShapeType(i)));
+    textEdit->setPlaceholderText("Words in text");
+    showColor();
+
+    QHBoxLayout* colorRow = new QHBoxLayout;
+    colorRow->addWidget(colorCheck);
+    colorRow->addWidget(colorBtn);
+
+    QFormLayout* form = new QFormLayout;
+    form->addRow("Type:", typeCombo);
+    form->addRow(colorRow);
+    form->addRow("Text:", textEdit);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(this);
+    QPushButton* selectBtn = buttons->addButton("Select", QDialogButtonBox::AcceptRole);
+    QPushButton* countBtn  = buttons->addButton("Count",  QDialogButtonBox::ActionRole);
+    buttons->addButton(QDialogButtonBox::Close);
+    selectBtn->setDefault(true);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(resultLabel);
+    layout->addWidget(buttons);
+
+    connect(colorBtn,  &QPushButton::clicked, this, &FindDialog::onPickColor);
+    // Select не закрывает диалог — можно уточнять запрос
+    connect(selectBtn, &QPushButton::clicked, this, &FindDialog::onSelect);
+    connect(countBtn,  &QPushButton::clicked, this, &FindDialog::onCount);
+    connect(buttons,   &QDialogButtonBox::rejected, this, &QDialog::close);
+}
+
+ShapeQuery FindDialog::query() const {
+    ShapeQuery q;
+    if (typeCombo->currentIndex() > 0) {
+        q.anyType = false;
+        q.type    = ShapeType(typeCombo->currentIndex() - 1);
+    }
+    if (colorCheck->isChecked()) {
+        q.anyColor = false;
+        q.color    = color;
+    }
+    q.text = textEdit->text();
+    return q;
+}
+
+void FindDialog::showColor() {
+    colorBtn->setText(color.name());
+    colorBtn->setStyleSheet(QString("color: %1").arg(color.name()));
+}
+
+void FindDialog::onPickColor() {
+    const QColor c = QColorDialog::getColor(color, this, "Find Color",
+                                            QColorDialog::ShowAlphaChannel);
+    if (!c.isValid())
+        return;
+    color = c;
+    colorCheck->setChecked(true);
+    showColor();
+}
+
+void FindDialog::onSelect() {
+    const ShapeQuery q = query();
+    const int selected = controller->selectMatching(q);
+    const int total    = model->count(q);
+    // Фигуры скрытых и заблокированных слоёв находятся, но не выделяются
+    resultLabel->setText(selected == total
+                             ? QString("Selected %1").arg(selected)
+                             : QString("Selected %1 of %2 (others on hidden/locked layers)")
+                                   .arg(selected).arg(total));
+}
+
+void FindDialog::onCount() {
+    resultLabel->setText(QString("%1 matches").arg(model->count(query())));
+}
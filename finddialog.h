@@ -0,0 +1,40 @@
+// finddialog.h
+#ifndef FINDDIALOG_H
+#define FINDDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include "graphiccontroller.h"
+
+// Поиск и выделение по атрибутам: тип, цвет, слова текста.
+// Немодальный — результат виден на сцене сразу
+class FindDialog : public QDialog {
+    Q_OBJECT
+public:
+    FindDialog(GraphicController* controller, GraphicModel* model, QWidget* parent = nullptr);
+
+private slots:
+    void onPickColor();
+    void onSelect();
+    void onCount();
+
+private:
+    ShapeQuery query() const;
+    void       showColor();
+
+    GraphicController* controller;
+    GraphicModel*      model;
+
+    QComboBox*   typeCombo;
+    QCheckBox*   colorCheck;
+    QPushButton* colorBtn;
+    QLineEdit*   textEdit;
+    QLabel*      resultLabel;
+    QColor       color;
+};
+
+#endif // FINDDIALOG_H
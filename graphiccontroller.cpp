@@ -1,12 +1,80 @@
 // graphiccontroller.cpp
 #include "graphiccontroller.h"
 #include "commands.h"
-#include <QInputDialog>
+#include "operationjournal.h"
+#include "tilepyramid.h"
+#include <QFileInfo>
+#include <QPainter>
+#include <QPen>
+#include <limits>
+
+namespace {
+
+// Минимальный шаг между точками штриха от руки
+const qreal kPenStep = 3.0;
+
+} // namespace
+
+// Штрих от руки, пока его рисуют: окончательные сегменты дописываются в конец
+// пути, заново строится только последний. Фигура-путь получает кривую (нормировку,
+// ломаную и контур попадания) один раз — при отпускании
+class StrokePreview : public QGraphicsItem {
+public:
+    explicit StrokePreview(const QColor& color)
+        : color(color)
+        , done(0)
+    {
+        setZValue(std::numeric_limits<qreal>::max());
+    }
+
+    // path продолжен BezierPath::extendSmoothed: все сегменты, кроме последнего, окончательные
+    void sync(const BezierPath& path) {
+        const QVector<BezierSegment>& segs = path.segments();
+        if (segs.isEmpty())
+            return;
+        if (fixed.elementCount() == 0)
+            fixed.moveTo(path.start());
+        for (; done < segs.size() - 1; ++done)
+            fixed.quadTo(segs.at(done).c1, segs.at(done).end);
+
+        const QRectF oldTail = tailRect;
+        tailFrom = done > 0 ? segs.at(done - 1).end : path.start();
+        tail     = segs.last();
+        tailRect = (QPolygonF() << tailFrom << tail.c1 << tail.end)
+                       .boundingRect().adjusted(-2, -2, 2, 2);
+        if (!bounds.contains(tailRect)) {
+            prepareGeometryChange();
+            bounds |= tailRect;
+        }
+        update(oldTail | tailRect);
+    }
+
+    QRectF boundingRect() const override { return bounds; }
+
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*) override {
+        painter->setPen(QPen(color, 2));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPath(fixed);
+        QPainterPath last(tailFrom);
+        last.quadTo(tail.c1, tail.end);
+        painter->drawPath(last);
+    }
+
+private:
+    QColor        color;
+    QPainterPath  fixed;      // окончательные сегменты
+    int           done;
+    QPointF       tailFrom;
+    BezierSegment tail = {};
+    QRectF        tailRect;
+    QRectF        bounds;
+};
 
 GraphicController::GraphicController(GraphicModel* model, QObject* parent)
     : QObject(parent)
     , m_model(model)
     , m_undoStack(new QUndoStack(this))
+    , m_journal(nullptr)
     , m_mode(EditorMode::Select)
     , m_currentColor(Qt::black)
     , m_currentFont(QFont())
@@ -14,12 +82,25 @@ GraphicController::GraphicController(GraphicModel* model, QObject* parent)
     , m_selectedShape(nullptr)
     , m_isDrawing(false)
     , m_isMoving(false)
+    , m_penPreview(nullptr)
+    , m_highlightOverlaps(false)
+    , m_overlapTracker(model)
+    , m_isBanding(false)
+    , m_bandItem(nullptr)
+    , m_editingShape(nullptr)
+    , m_editingNew(false)
+    , m_pasteCount(0)
 { }
 
 void GraphicController::setEditorMode(EditorMode mode) {
+    finishTextEditing(true);
     m_mode = mode;
 }
 
+void GraphicController::setJournal(OperationJournal* journal) {
+    m_journal = journal;
+}
+
 void GraphicController::setCurrentColor(const QColor& c) {
     m_currentColor = c;
 }
@@ -35,67 +116,122 @@ QFont GraphicController::getCurrentFont() const {
 }
 
 void GraphicController::changeSelectedItemsFont(const QFont& f) {
-    for (Shape* s : m_model->getShapes())
-        if (s->isSelected() && s->getType() == ShapeType::Text)
+    for (Shape* s : m_model->getSelection()->shapes())
+        if (s->getType() == ShapeType::Text) {
             s->setFont(f);
+            if (m_journal)
+                m_journal->recordUpdate(s);
+        }
 }
 
 void GraphicController::changeSelectedItemsColor(const QColor& c) {
-    for (Shape* s : m_model->getShapes()) {
-        if (s->isSelected()) {
-            QColor old = s->getColor();
-            m_undoStack->push(new ColorCommand(s, old, c));
-        }
+    for (Shape* s : m_model->getSelection()->shapes()) {
+        QColor old = s->getColor();
+        m_undoStack->push(new ColorCommand(s, old, c));
     }
 }
 
-void GraphicController::undo() { m_undoStack->undo(); }
-void GraphicController::redo() { m_undoStack->redo(); }
+void GraphicController::undo() { finishTextEditing(true); m_undoStack->undo(); }
+void GraphicController::redo() { finishTextEditing(true); m_undoStack->redo(); }
 
 void GraphicController::mousePressed(const QPointF& pos) {
+    // Щелчок мимо редактируемого текста фиксирует ввод. В окне это уже сделала
+    // сцена (sceneMousePressStarting), здесь — для проигрывания записанных сессий
+    finishTextEditing(true);
     if (m_mode == EditorMode::Select) {
-        for (auto* it : m_model->getScene()->items(pos)) {
-            if (auto* s = dynamic_cast<Shape*>(it)) {
-                m_isMoving      = true;
-                m_selectedShape = s;
-                m_moveStartPos  = s->pos();
-                return;
-            }
+        // Попадание — по сетке модели: фигура может быть снята со сцены виртуализацией
+        const QList<Shape*> hits = m_model->shapesAt(pos);
+        if (!hits.isEmpty()) {
+            m_isMoving      = true;
+            m_selectedShape = hits.first();
+            m_moveStartPos  = m_selectedShape->pos();
+            if (m_highlightOverlaps)
+                m_overlapTracker.begin(QList<Shape*>() << m_selectedShape);
+            return;
         }
+        // Пустое место — резиновая рамка
+        m_isBanding = true;
+        m_bandOrigin = pos;
+        m_bandRect   = QRectF(pos, QSizeF(0, 0));
+        m_bandItem   = m_model->getScene()->addRect(m_bandRect,
+                                                    QPen(Qt::blue, 0, Qt::DashLine),
+                                                    QColor(0, 120, 215, 30));
+        m_bandItem->setZValue(std::numeric_limits<qreal>::max());
+        return;
     }
+    // Скрытый или заблокированный слой не редактируется
+    if (!m_model->getCurrentLayer()->isLive())
+        return;
+    AddShapeCommand* add = nullptr;
     switch (m_mode) {
     case EditorMode::CreateLine:
-        m_undoStack->push(new AddShapeCommand(m_model, ShapeType::Line, pos, m_currentColor, m_currentFont));
+        add = new AddShapeCommand(m_model, ShapeType::Line, pos, m_currentColor, m_currentFont);
         break;
     case EditorMode::CreateRect:
-        m_undoStack->push(new AddShapeCommand(m_model, ShapeType::Rectangle, pos, m_currentColor, m_currentFont));
+        add = new AddShapeCommand(m_model, ShapeType::Rectangle, pos, m_currentColor, m_currentFont);
         break;
     case EditorMode::CreateEllipse:
-        m_undoStack->push(new AddShapeCommand(m_model, ShapeType::Ellipse, pos, m_currentColor, m_currentFont));
+        add = new AddShapeCommand(m_model, ShapeType::Ellipse, pos, m_currentColor, m_currentFont);
         break;
     case EditorMode::CreateStar:
-        m_undoStack->push(new AddShapeCommand(m_model, ShapeType::Star, pos, m_currentColor, m_currentFont));
+        add = new AddShapeCommand(m_model, ShapeType::Star, pos, m_currentColor, m_currentFont);
+        break;
+    case EditorMode::CreateCurve:
+        add = new AddShapeCommand(m_model, ShapeType::Path, pos, m_currentColor, m_currentFont);
+        m_penPoints = QPolygonF() << pos;
         break;
+    case EditorMode::CreatePen:
+        // Фигура и команда появляются со второй точкой штриха (mouseMoved):
+        // щелчок без движения ничего не оставляет ни в документе, ни в истории
+        m_penPoints = QPolygonF() << pos;
+        m_isDrawing = true;
+        return;
     case EditorMode::CreateText: {
-        bool ok;
-        QString txt = QInputDialog::getText(nullptr, "Enter Text", "Text:", QLineEdit::Normal, "", &ok);
-        if (ok && !txt.isEmpty()) {
-            m_undoStack->push(new AddShapeCommand(m_model, ShapeType::Text, pos, m_currentColor, m_currentFont));
-            Shape* s = m_model->getShapes().last();
-            s->setText(txt);
-        }
+        // Новый текст до фиксации — отдельный элемент сцены поверх всего:
+        // набор не трогает слой, индекс и снимки, а в историю попадает одной командой
+        Shape* s = new Shape(ShapeType::Text, pos, m_currentColor, m_currentFont);
+        s->setFlags(QGraphicsItem::GraphicsItemFlags());
+        s->setZValue(std::numeric_limits<qreal>::max());
+        m_model->getScene()->addItem(s);
+        beginTextEditing(s, true);
         return;
     }
     default:
         return;
     }
-    m_currentShape = m_model->getShapes().last();
+    m_undoStack->push(add);
+    m_currentShape = add->shape();
     m_isDrawing    = true;
 }
 
 void GraphicController::mouseMoved(const QPointF& pos) {
-    if (m_isMoving && m_selectedShape) {
+    if (m_isBanding) {
+        const QRectF band = QRectF(m_bandOrigin, pos).normalized();
+        m_model->getSelection()->updateRubberBand(m_bandRect, band);
+        m_bandRect = band;
+        m_bandItem->setRect(band);
+    } else if (m_isMoving && m_selectedShape) {
         m_selectedShape->setPos(pos - m_selectedShape->boundingRect().center());
+        if (m_overlapTracker.isActive())
+            m_model->getScene()->setHighlighted(m_overlapTracker.update());
+    } else if (m_isDrawing && m_mode == EditorMode::CreatePen) {
+        // Слишком частые точки только утяжеляют путь
+        const QPointF d = pos - m_penPoints.last();
+        if (QPointF::dotProduct(d, d) < kPenStep * kPenStep)
+            return;
+        if (!m_currentShape) {
+            AddShapeCommand* add = new AddShapeCommand(m_model, ShapeType::Path, m_penPoints.first(),
+                                                       m_currentColor, m_currentFont);
+            m_undoStack->push(add);
+            m_currentShape = add->shape();
+        }
+        m_penPoints.append(pos);
+        m_penPath.extendSmoothed(m_penPoints);
+        if (!m_penPreview) {
+            m_penPreview = new StrokePreview(m_currentShape->getColor());
+            m_model->getScene()->addItem(m_penPreview);
+        }
+        m_penPreview->sync(m_penPath);
     } else if (m_isDrawing && m_currentShape) {
         m_currentShape->setEndPos(pos);
     }
@@ -107,19 +243,348 @@ void GraphicController::mouseReleased() {
         if (newPos != m_moveStartPos)
             m_undoStack->push(new MoveShapeCommand(m_selectedShape, m_moveStartPos, newPos));
     }
+    stopOverlapTracking();
+    if (m_penPreview) {
+        if (m_currentShape)
+            m_currentShape->setCurve(m_penPath);
+        delete m_penPreview;
+        m_penPreview = nullptr;
+    }
+    // Конечная точка задаётся уже после AddShapeCommand — фиксируем итоговую геометрию
+    if (m_isDrawing && m_currentShape && m_journal)
+        m_journal->recordUpdate(m_currentShape);
+    if (m_isBanding) {
+        delete m_bandItem;
+        m_bandItem  = nullptr;
+        m_isBanding = false;
+    }
     m_isMoving      = false;
     m_isDrawing     = false;
     m_selectedShape = nullptr;
     m_currentShape  = nullptr;
+    m_penPoints.clear();
+    m_penPath = BezierPath();
+}
+
+bool GraphicController::isEditingText() const {
+    return m_editingShape != nullptr;
+}
+
+bool GraphicController::editTextAt(const QPointF& pos) {
+    for (Shape* s : m_model->shapesAt(pos)) {
+        if (s == m_editingShape)
+            continue;
+        if (s->getType() != ShapeType::Text)
+            return false;
+        finishTextEditing(true);
+        s->setSelected(false);
+        beginTextEditing(s, false);
+        return true;
+    }
+    return false;
+}
+
+void GraphicController::beginTextEditing(Shape* s, bool isNew) {
+    m_editingShape    = s;
+    m_editingOriginal = s->getText();
+    m_editingNew      = isNew;
+    s->setEditing(true);
+}
+
+bool GraphicController::textKeyPressed(int key, const QString& text) {
+    Shape* s = m_editingShape;
+    if (!s)
+        return false;
+
+    QString t      = s->getText();
+    int     cursor = s->getEditCursor();
+    switch (key) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        finishTextEditing(true);
+        return true;
+    case Qt::Key_Escape:
+        finishTextEditing(false);
+        return true;
+    case Qt::Key_Backspace:
+        if (cursor > 0)
+            t.remove(--cursor, 1);
+        break;
+    case Qt::Key_Delete:
+        t.remove(cursor, 1);
+        break;
+    case Qt::Key_Left:  cursor = qMax(0, cursor - 1);           break;
+    case Qt::Key_Right: cursor = qMin(int(t.size()), cursor + 1); break;
+    case Qt::Key_Home:  cursor = 0;                             break;
+    case Qt::Key_End:   cursor = t.size();                      break;
+    default:
+        if (text.isEmpty() || !text.at(0).isPrint())
+            return false;
+        t.insert(cursor, text);
+        cursor += text.size();
+        break;
+    }
+    // Перевёрстка только этой фигуры (и только если текст изменился)
+    s->setText(t);
+    s->setEditCursor(cursor);
+    return true;
+}
+
+void GraphicController::finishTextEditing(bool commit) {
+    Shape* s = m_editingShape;
+    if (!s)
+        return;
+    m_editingShape = nullptr;
+    s->setEditing(false);
+    const QString text = s->getText();
+
+    if (m_editingNew) {
+        // Черновик заменяется настоящей фигурой — как раньше после диалога
+        const QPointF pos   = s->getStartPos();
+        const QColor  color = s->getColor();
+        const QFont   font  = s->getFont();
+        m_model->getScene()->removeItem(s);
+        delete s;
+        if (commit && !text.isEmpty()) {
+            auto* add = new AddShapeCommand(m_model, ShapeType::Text, pos, color, font);
+            m_undoStack->push(add);
+            add->shape()->setText(text);
+            if (m_journal)
+                m_journal->recordUpdate(add->shape());
+        }
+        return;
+    }
+
+    if (!commit || text == m_editingOriginal) {
+        s->setText(m_editingOriginal);
+        return;
+    }
+    if (text.isEmpty()) {
+        // Стёртый до пустоты текст удаляется; Undo вернёт прежний
+        s->setText(m_editingOriginal);
+        m_undoStack->push(new DeleteShapeCommand(m_model, s));
+        return;
+    }
+    // Фигура уже показывает новый текст — первый redo ничего не перевёрстывает
+    m_undoStack->push(new SetTextCommand(s, m_editingOriginal, text));
 }
 
 void GraphicController::deleteSelectedItems() {
+    finishTextEditing(true);
+    for (Shape* s : m_model->getSelection()->shapes())
+        m_undoStack->push(new DeleteShapeCommand(m_model, s));
+}
+
+void GraphicController::copySelection() {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (shapes.isEmpty())
+        return;
+    m_clipboard.copy(shapes);
+    m_pasteCount = 0;
+}
+
+void GraphicController::paste() {
+    const QVector<ShapeClip> clips = m_clipboard.paste();
+    if (clips.isEmpty())
+        return;
+    ++m_pasteCount;
+    const QPointF offset(20 * m_pasteCount, 20 * m_pasteCount);
+    m_undoStack->push(new PasteShapesCommand(m_model, clips, offset,
+                                             QString("Paste %1 Shapes").arg(clips.size())));
+}
+
+void GraphicController::duplicateSelection() {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (shapes.isEmpty())
+        return;
+    m_undoStack->push(new PasteShapesCommand(m_model, ShapeClipboard::capture(shapes),
+                                             QPointF(20, 20),
+                                             QString("Duplicate %1 Shapes").arg(shapes.size())));
+}
+
+void GraphicController::bringSelectionToFront() {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (!shapes.isEmpty())
+        m_undoStack->push(new ReorderShapesCommand(m_model, shapes,
+                                                   ReorderShapesCommand::Op::BringToFront));
+}
+
+void GraphicController::sendSelectionToBack() {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (!shapes.isEmpty())
+        m_undoStack->push(new ReorderShapesCommand(m_model, shapes,
+                                                   ReorderShapesCommand::Op::SendToBack));
+}
+
+void GraphicController::moveSelectionToLayer(Layer* layer) {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (shapes.isEmpty() || !layer)
+        return;
+    // В невидимом или заблокированном слое фигуры уйдут со сцены — выделение снимется
+    m_undoStack->push(new ReorderShapesCommand(m_model, shapes,
+                                               ReorderShapesCommand::Op::MoveToLayer, layer));
+}
+
+void GraphicController::alignSelection(ShapeLayout::Align how) {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (shapes.size() < 2)
+        return;
+    pushLayout(shapes, ShapeLayout::align(shapes, how), "Align");
+}
+
+void GraphicController::distributeSelection(Qt::Orientation orientation) {
+    const QList<Shape*> shapes = m_model->getSelection()->shapes();
+    if (shapes.size() < 3)
+        return;
+    pushLayout(shapes, ShapeLayout::distribute(shapes, orientation), "Distribute");
+}
+
+void GraphicController::pushLayout(const QList<Shape*>& shapes,
+                                   const QVector<QPointF>& targets,
+                                   const QString& text) {
+    for (int i = 0; i < shapes.size(); ++i) {
+        if (shapes.at(i)->pos() != targets.at(i)) {
+            m_undoStack->push(new MoveShapesCommand(m_model, shapes, targets, text));
+            return;
+        }
+    }
+}
+
+int GraphicController::selectMatching(const ShapeQuery& query) {
+    const QList<Shape*> found = m_model->find(query);
+    m_model->clearSelection();
+    int selected = 0;
+    for (Shape* s : found) {
+        if (m_model->isEditable(s)) {
+            s->setSelected(true);
+            ++selected;
+        }
+    }
+    return selected;
+}
+
+int GraphicController::selectOverlapping() {
+    const QList<Shape*> sources = m_model->getSelection()->shapes();
+    QSet<Shape*> found;
+    for (Shape* s : sources)
+        for (Shape* hit : ShapeOverlap::overlapping(m_model, s))
+            found.insert(hit);
+    for (Shape* s : found)
+        s->setSelected(true);
+    return found.size();
+}
+
+int GraphicController::selectIntersectingPairs() {
+    QList<Shape*> editable;
     for (Shape* s : m_model->getShapes())
-        if (s->isSelected())
-            m_undoStack->push(new DeleteShapeCommand(m_model, s));
+        if (m_model->isEditable(s))
+            editable.append(s);
+    const QVector<ShapeOverlap::Pair> pairs = ShapeOverlap::allPairs(editable);
+
+    m_model->clearSelection();
+    for (const ShapeOverlap::Pair& p : pairs) {
+        p.first->setSelected(true);
+        p.second->setSelected(true);
+    }
+    return pairs.size();
+}
+
+void GraphicController::setOverlapHighlighting(bool enabled) {
+    m_highlightOverlaps = enabled;
+}
+
+bool GraphicController::isOverlapHighlighting() const {
+    return m_highlightOverlaps;
+}
+
+void GraphicController::shapeDragStarted(Shape* shape) {
+    // Нажатие уже выделило схваченную фигуру. Позиции до перетаскивания —
+    // у всего выделенного: при отпускании сдвиг уходит в историю одной командой
+    QList<Shape*> moving;
+    m_dragStartPos   = shape->pos();
+    m_dragStartPoint = shape->getStartPos();
+    m_dragEndPoint   = shape->getEndPos();
+    m_dragShapes = m_model->getSelection()->shapes();
+    m_dragFrom.clear();
+    m_dragFrom.reserve(m_dragShapes.size());
+    for (Shape* s : m_dragShapes) {
+        m_dragFrom.append(s->pos());
+        if (s->scene())
+            moving.append(s);
+    }
+    if (!m_highlightOverlaps)
+        return;
+    m_overlapTracker.begin(moving);
+    m_model->getScene()->setHighlighted(m_overlapTracker.update());
+}
+
+void GraphicController::shapeDragged() {
+    if (m_overlapTracker.isActive())
+        m_model->getScene()->setHighlighted(m_overlapTracker.update());
+}
+
+void GraphicController::shapeDragFinished(Shape* shape) {
+    stopOverlapTracking();
+    // Фигуры на сцене сцена уже сдвинула; выделенные вне сцены (на время
+    // перетаскивания присутствие на сцене заморожено) — на тот же вектор.
+    // Сдвиг всех разом — одна команда Undo, она же пишет журнал
+    const QPointF delta = shape->pos() - m_dragStartPos;
+    QList<Shape*>    shapes;
+    QVector<QPointF> from;
+    QVector<QPointF> to;
+    bool moved = false;
+    for (int i = 0; i < m_dragShapes.size(); ++i) {
+        Shape* s = m_dragShapes.at(i);
+        if (!m_model->isEditable(s))
+            continue;
+        const QPointF target = s->scene() ? s->pos() : m_dragFrom.at(i) + delta;
+        shapes.append(s);
+        from.append(m_dragFrom.at(i));
+        to.append(target);
+        moved = moved || target != m_dragFrom.at(i);
+    }
+    m_dragShapes.clear();
+    m_dragFrom.clear();
+    if (moved)
+        m_undoStack->push(new MoveShapesCommand(m_model, shapes, from, to, "Move Shapes"));
+    // Схваченную за ручку фигуру растянули — это тоже команда
+    if (shape->getStartPos() != m_dragStartPoint || shape->getEndPos() != m_dragEndPoint)
+        m_undoStack->push(new ResizeShapeCommand(shape, m_dragStartPoint, m_dragEndPoint,
+                                                 shape->getStartPos(), shape->getEndPos()));
+    // Утащенное из области у вида снимается со сцены
+    m_model->refreshResidency();
+}
+
+void GraphicController::stopOverlapTracking() {
+    if (m_overlapTracker.isActive()) {
+        m_overlapTracker.end();
+        m_model->getScene()->setHighlighted(QSet<Shape*>());
+    }
+}
+
+bool GraphicController::importImage(const QString& path, const QPointF& center) {
+    if (!m_model->getCurrentLayer()->isLive())
+        return false;
+    // Размер — из заголовка файла; сами пиксели декодирует фоновая сборка пирамиды
+    const QSize size = TilePyramid::imageSize(path);
+    if (size.isEmpty())
+        return false;
+
+    const QPointF topLeft = center - QPointF(size.width(), size.height()) / 2;
+    auto* add = new AddShapeCommand(m_model, ShapeType::Image, topLeft, m_currentColor, m_currentFont);
+    m_undoStack->push(add);
+    Shape* s = add->shape();
+    s->setImageSource(QFileInfo(path).absoluteFilePath(), size);
+    if (m_journal)
+        m_journal->recordUpdate(s);
+
+    // Скан обычно больше стартовой области сцены — расширить её, чтобы до краёв можно было докрутить
+    QGraphicsScene* scene = m_model->getScene();
+    scene->setSceneRect(scene->sceneRect() | s->sceneBoundingRect());
+    return true;
 }
 
 void GraphicController::clearAll() {
-    m_undoStack->push(new ClearAllCommand(m_model, m_model->getShapes()));
-    m_model->clear();
+    finishTextEditing(true);
+    m_undoStack->push(new ClearAllCommand(m_model));
 }
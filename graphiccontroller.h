@@ -7,8 +7,17 @@
 #include <QColor>
 #include <QFont>
 #include <QPointF>
+#include <QRectF>
+#include <QPolygonF>
+#include <QGraphicsRectItem>
 #include "graphicmodel.h"
 #include "shape.h"
+#include "shapeclipboard.h"
+#include "shapelayout.h"
+#include "shapeoverlap.h"
+
+class OperationJournal;
+class StrokePreview;
 
 enum class EditorMode {
     Select,
@@ -16,7 +25,9 @@ enum class EditorMode {
     CreateRect,
     CreateEllipse,
     CreateText,
-    CreateStar
+    CreateStar,
+    CreateCurve,   // кубическая кривая, растягивается как прямоугольник
+    CreatePen      // от руки: штрих сглаживается цепочкой квадратичных кривых
 };
 
 class GraphicController : public QObject {
@@ -39,16 +50,73 @@ public:
     void mouseMoved  (const QPointF& pos);
     void mouseReleased();
 
+    // Ввод текста прямо на холсте, без модального диалога: щелчок в режиме
+    // текста начинает новый текст, двойной щелчок по тексту — его правку.
+    // Каждая клавиша перевёрстывает только редактируемую фигуру
+    bool isEditingText() const;
+    bool editTextAt(const QPointF& pos);
+    // true — клавиша ушла в редактируемый текст (Enter — зафиксировать, Esc — отменить)
+    bool textKeyPressed(int key, const QString& text);
+    // Фиксация — одной командой Undo; без фиксации текст возвращается как был
+    void finishTextEditing(bool commit);
+
     void deleteSelectedItems();
     void clearAll();
 
+    // Буфер обмена: каждая вставка/дублирование — одна команда Undo
+    void copySelection();
+    void paste();
+    void duplicateSelection();
+
+    // Порядок наложения выделенного: каждая операция — одна команда Undo
+    void bringSelectionToFront();
+    void sendSelectionToBack();
+    void moveSelectionToLayer(Layer* layer);
+
+    // Выравнивание и распределение выделенного: позиции считаются параллельно,
+    // применяются одной командой Undo
+    void alignSelection(ShapeLayout::Align how);
+    void distributeSelection(Qt::Orientation orientation);
+
+    // Выделить найденное запросом (только фигуры видимых незаблокированных слоёв);
+    // вернуть число выделенных
+    int selectMatching(const ShapeQuery& query);
+
+    // Пересечения: выделить всё, что пересекает выделенные фигуры, и выделить
+    // участников всех пересекающихся пар (вернуть число пар)
+    int selectOverlapping();
+    int selectIntersectingPairs();
+    // Подсветка пересечений перетаскиваемых фигур; перепроверяются только они
+    void setOverlapHighlighting(bool enabled);
+    bool isOverlapHighlighting() const;
+    // Перетаскивание фигур самой сценой (CustomGraphicsScene::shapeDrag*):
+    // сцена двигает выделенное на ней, выделенное вне сцены сдвигается при отпускании;
+    // весь сдвиг — одна команда Undo, растяжение ручками — ещё одна
+    void shapeDragStarted(Shape* shape);
+    void shapeDragged();
+    void shapeDragFinished(Shape* shape);
+
+    // Вставить изображение из файла в натуральную величину с центром в center
+    // (одна команда Undo); false — файл не читается или слой недоступен
+    bool importImage(const QString& path, const QPointF& center);
+
     void undo();
     void redo();
     QUndoStack* undoStack() const { return m_undoStack; }
 
+    // Журнал автосохранения; изменения в обход стека пишутся в него напрямую
+    void setJournal(OperationJournal* journal);
+
 private:
+    void beginTextEditing(Shape* shape, bool isNew);
+    void stopOverlapTracking();
+
+    // Одна команда на пакет; ничего не сдвинулось — в историю не пишется
+    void pushLayout(const QList<Shape*>& shapes, const QVector<QPointF>& targets, const QString& text);
+
     GraphicModel* m_model;
     QUndoStack*   m_undoStack;
+    OperationJournal* m_journal;
 
     EditorMode    m_mode;
     QColor        m_currentColor;
@@ -59,6 +127,35 @@ private:
     bool          m_isDrawing;
     bool          m_isMoving;
     QPointF       m_moveStartPos;
+    QPolygonF     m_penPoints;     // точки штриха от руки
+    BezierPath    m_penPath;       // штрих, сглаженный по мере рисования
+    StrokePreview* m_penPreview;   // рисуемый штрих; фигура получает путь при отпускании
+
+    // Пересечения перетаскиваемых фигур
+    bool           m_highlightOverlaps;
+    OverlapTracker m_overlapTracker;
+
+    // Перетаскивание сценой: схваченная фигура (позиция и точки — для сдвига
+    // и растяжения ручками) и всё выделенное с позициями до него
+    QPointF          m_dragStartPos;
+    QPointF          m_dragStartPoint;
+    QPointF          m_dragEndPoint;
+    QList<Shape*>    m_dragShapes;
+    QVector<QPointF> m_dragFrom;
+
+    // Резиновая рамка выделения
+    bool               m_isBanding;
+    QPointF            m_bandOrigin;
+    QRectF             m_bandRect;
+    QGraphicsRectItem* m_bandItem;
+
+    // Текст, который сейчас набирается; новый живёт на сцене вне модели до фиксации
+    Shape*             m_editingShape;
+    QString            m_editingOriginal;
+    bool               m_editingNew;
+
+    ShapeClipboard     m_clipboard;
+    int                m_pasteCount;   // повторные вставки сдвигаются лесенкой
 };
 
 #endif // GRAPHICCONTROLLER_H
@@ -1,69 +1,741 @@
 // graphicmodel.cpp
 #include "graphicmodel.h"
+#include "memorypool.h"
+#include <QSet>
+#include <QTimer>
+#include <QCoreApplication>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Полоса z на слой: ключи фигур слоя лежат в ±kLayerSpan/2 от его основания,
+// double хранит такие значения точно для тысяч слоёв
+const qreal kLayerSpan = 1099511627776.0; // 2^40
+
+// Виртуализация: запас вокруг видимой области с каждой стороны (доля её размера)
+// и во сколько раз область на сцене может превышать нужную, прежде чем её сузят
+const qreal kPrefetch     = 0.5;
+const qreal kRealizeSlack = 2.0;
+
+// Столько фигур снятого документа удаляется за одну итерацию цикла событий
+const int kDisposeSlice = 20000;
+
+} // namespace
+
+DocumentContent::DocumentContent()
+    : current(nullptr)
+    , shapeTotal(0)
+{ }
+
+DocumentContent::~DocumentContent() {
+    // Документ вне модели: его фигуры сняты со сцены, удаляем их сами
+    for (Layer* l : layers)
+        for (const auto& entry : l->order)
+            delete entry.second;
+    qDeleteAll(layers);
+    qDeleteAll(retired);
+}
+
+bool DocumentContent::disposeSlice(DocumentContent* doc, int budget) {
+    while (budget > 0 && !doc->layers.isEmpty()) {
+        Layer* l = doc->layers.last();
+        while (budget > 0 && !l->order.empty()) {
+            const auto last = std::prev(l->order.end());
+            delete last->second;
+            l->order.erase(last);
+            --budget;
+        }
+        if (!l->order.empty())
+            break;
+        delete l;
+        doc->layers.removeLast();
+    }
+    if (!doc->layers.isEmpty())
+        return false;
+    delete doc;
+    // Документ ушёл целиком — отдать освободившиеся слэбы системе
+    shapeMemoryPool().trim();
+    return true;
+}
+
+void DocumentContent::disposeLater(DocumentContent* doc) {
+    if (!QCoreApplication::instance()) {
+        delete doc;
+        return;
+    }
+    QTimer::singleShot(0, QCoreApplication::instance(), [doc] {
+        if (!disposeSlice(doc, kDisposeSlice))
+            disposeLater(doc);
+    });
+}
 
 GraphicModel::GraphicModel(QObject* parent)
     : QObject(parent)
     , scene(new CustomGraphicsScene(this))
+    , selection(new ShapeSelection(&grid, this))
+    , current(nullptr)
+    , shapeTotal(0)
+    , nextId(1)
+    , virtualized(false)
+    , layoutChanged(true)
 {
     scene->setSceneRect(-500, -500, 1000, 1000);
+    scene->setModel(this);
+    current = addLayer("Layer 1");
+}
+
+GraphicModel::~GraphicModel() {
+    // Сцена удаляется позже модели — её фигуры не должны звать уже разрушенную модель
+    scene->setModel(nullptr);
+    for (Layer* l : layers)
+        l->model = nullptr;
+    for (Layer* l : retired)
+        l->model = nullptr;
+    // Фигуры на сцене удалит сцена, снятые со сцены (скрытые/заблокированные слои,
+    // виртуализация) — мы
+    for (Layer* l : layers)
+        for (const auto& entry : l->order)
+            if (!entry.second->scene())
+                delete entry.second;
+    qDeleteAll(layers);
+    qDeleteAll(retired);
 }
 
-void GraphicModel::addShape(ShapeType type,
-                            const QPointF& pos,
-                            const QColor& color,
-                            const QFont& font)
+qreal GraphicModel::zValueFor(const Layer* l, qint64 key) {
+    return qreal(l->position) * kLayerSpan + qreal(key);
+}
+
+Shape* GraphicModel::addShape(ShapeType type,
+                              const QPointF& pos,
+                              const QColor& color,
+                              const QFont& font)
 {
     Shape* s = new Shape(type, pos, color, font);
-    shapes.append(s);
-    scene->addItem(s);
+    assignId(s);
+    place(s, current, current->topKey() + 1);
     emit sceneUpdated();
+    return s;
 }
 
 void GraphicModel::removeShape(Shape* s) {
-    if (shapes.removeOne(s)) {
-        scene->removeItem(s);
+    if (contains(s)) {
+        unplace(s);
         delete s;
         emit sceneUpdated();
     }
 }
 
 void GraphicModel::clear() {
-    for (Shape* s : shapes) {
-        scene->removeItem(s);
-        delete s;
+    selection->clear();
+    for (Layer* l : layers) {
+        for (const auto& entry : l->order) {
+            if (entry.second->scene())
+                scene->removeItem(entry.second);
+            delete entry.second;
+        }
+        l->order.clear();
+        l->markChanged();
+        delete l->raster;
+        l->raster = nullptr;
     }
-    shapes.clear();
+    shapeTotal = 0;
+    byId.clear();
+    index.clear();
+    grid.clear();
+    resident.clear();
+    // Документ опустел — отдать освободившиеся слэбы системе
+    shapeMemoryPool().trim();
     emit sceneUpdated();
 }
 
 QList<Shape*> GraphicModel::getShapes() const {
-    return shapes;
+    QList<Shape*> all;
+    all.reserve(shapeTotal);
+    for (const Layer* l : layers)
+        for (const auto& entry : l->order)
+            all.append(entry.second);
+    return all;
+}
+
+int GraphicModel::shapeCount() const {
+    return shapeTotal;
+}
+
+bool GraphicModel::contains(Shape* s) const {
+    const Layer* l = s->getLayer();
+    if (!l)
+        return false;
+    const auto it = l->order.find(s->getZKey());
+    return it != l->order.end() && it->second == s;
+}
+
+Shape* GraphicModel::shapeById(quint64 id) const {
+    return byId.value(id, nullptr);
 }
 
 CustomGraphicsScene* GraphicModel::getScene() const {
     return scene;
 }
 
-void GraphicModel::addExistingShape(Shape* s) {
-    if (!shapes.contains(s)) {
-        shapes.append(s);
-        scene->addItem(s);
-        emit sceneUpdated();
+ShapeSelection* GraphicModel::getSelection() const {
+    return selection;
+}
+
+void GraphicModel::shapeSelectionChanged(Shape* s, bool selected) {
+    // Выделение ведётся только у фигур видимых незаблокированных слоёв
+    if (!grid.contains(s))
+        return;
+    if (selected) {
+        selection->insert(s);
+    } else {
+        selection->remove(s);
     }
 }
 
+void GraphicModel::shapeGeometryChanged(Shape* s) {
+    const QRectF old = grid.update(s);
+    if (!virtualized || old.isNull() || resident.contains(s))
+        return;
+    // Фигура вне сцены сама не перерисуется: обновить её прежнюю и новую область
+    // (миникарта), а въехавшую в область у вида — поставить на сцену
+    const QRectF now = s->sceneBoundingRect();
+    scene->update(old);
+    scene->update(now);
+    if (realized.intersects(now))
+        materialize(s);
+}
+
+QList<Shape*> GraphicModel::shapesAt(const QPointF& pos) const {
+    QList<Shape*> hits;
+    for (Shape* s : grid.query(QRectF(pos - QPointF(0.5, 0.5), QSizeF(1, 1))))
+        if (s->contains(s->mapFromScene(pos)))
+            hits.append(s);
+    std::sort(hits.begin(), hits.end(), [](const Shape* a, const Shape* b) {
+        return a->zValue() > b->zValue();
+    });
+    return hits;
+}
+
+QList<Shape*> GraphicModel::shapesIn(const QRectF& rect) const {
+    QList<Shape*> hits = grid.query(rect);
+    std::sort(hits.begin(), hits.end(), [](const Shape* a, const Shape* b) {
+        return a->zValue() < b->zValue();
+    });
+    return hits;
+}
+
+bool GraphicModel::isEditable(Shape* s) const {
+    return grid.contains(s);
+}
+
+// Фигура возвращается в свой слой на прежний ключ, если слой жив и ключ свободен
+void GraphicModel::addExistingShape(Shape* s) {
+    if (contains(s))
+        return;
+    assignId(s);
+    Layer* l = s->getLayer();
+    if (l && isActiveLayer(l) && !l->order.count(s->getZKey()))
+        place(s, l, s->getZKey());
+    else
+        place(s, current, current->topKey() + 1);
+    emit sceneUpdated();
+}
+
 void GraphicModel::removeExistingShape(Shape* s) {
-    if (shapes.removeOne(s)) {
-        scene->removeItem(s);
+    if (contains(s)) {
+        unplace(s);
         emit sceneUpdated();
     }
 }
 
+void GraphicModel::addExistingShapes(const QList<Shape*>& arr) {
+    for (Shape* s : arr) {
+        if (contains(s))
+            continue;
+        assignId(s);
+        Layer* l = s->getLayer();
+        if (l && isActiveLayer(l) && !l->order.count(s->getZKey()))
+            place(s, l, s->getZKey());
+        else
+            place(s, current, current->topKey() + 1);
+    }
+    emit sceneUpdated();
+}
+
+void GraphicModel::removeExistingShapes(const QList<Shape*>& arr) {
+    // Удаление из std::map слоя — O(log n) на фигуру, без проходов по списку
+    for (Shape* s : arr)
+        if (contains(s))
+            unplace(s);
+    emit sceneUpdated();
+}
+
+void GraphicModel::moveShapes(const QList<Shape*>& arr, const QVector<QPointF>& positions) {
+    for (int i = 0; i < arr.size(); ++i)
+        arr.at(i)->setPos(positions.at(i));
+    emit sceneUpdated();
+}
+
+void GraphicModel::applyFrame(const QVector<ShapeFrame>& frame) {
+    QRectF dirty;
+    for (const ShapeFrame& f : frame) {
+        if (!f.shape || !f.fields || !grid.contains(f.shape))
+            continue;
+        Shape* s = f.shape;
+        const QRectF old = s->sceneBoundingRect();
+        s->setAnimatedState(f.fields, f.pos, f.color, f.endPos);
+        const QRectF now = s->sceneBoundingRect();
+        dirty |= old | now;
+
+        grid.update(s);
+        if (f.fields & Shape::AnimateColor)
+            index.update(s);
+        if (virtualized && !resident.contains(s) && realized.intersects(now))
+            materialize(s);
+    }
+    // Одно обновление сцены на кадр; sceneUpdated не шлём — он перерисовывает вид целиком
+    if (!dirty.isNull())
+        scene->update(dirty);
+}
+
 void GraphicModel::setShapes(const QVector<Shape*>& arr) {
     clear();
     for (Shape* s : arr) {
-        shapes.append(s);
-        scene->addItem(s);
+        assignId(s);
+        place(s, current, current->topKey() + 1);
+    }
+    emit sceneUpdated();
+}
+
+DocumentContent* GraphicModel::newDocument() {
+    DocumentContent* doc = new DocumentContent;
+    Layer* l = new Layer("Layer 1");
+    l->index = &index;
+    l->model = this;
+    doc->layers.append(l);
+    doc->current = l;
+    return doc;
+}
+
+void GraphicModel::swapDocument(DocumentContent* other) {
+    // Снять со сцены то, что на ней стоит: фигуры у вида и растры слоёв.
+    // Остальные фигуры документа на сцене не бывают — их не перебираем.
+    // Без виртуализации resident — весь документ, и здесь O(n)
+    for (Shape* s : resident)
+        scene->removeItem(s);
+    resident.clear();
+    for (Layer* l : layers)
+        if (l->raster)
+            scene->removeItem(l->raster);
+
+    // Слои ссылаются на индекс и модель, а не на документ, поэтому обмен — O(1)
+    layers.swap(other->layers);
+    retired.swap(other->retired);
+    qSwap(current, other->current);
+    index.swap(other->index);
+    grid.swap(other->grid);
+    selection->swap(other->selected);
+    byId.swap(other->byId);
+    qSwap(shapeTotal, other->shapeTotal);
+    layoutChanged = true;
+
+    for (Layer* l : layers) {
+        if (l->raster)
+            scene->addItem(l->raster);
+        else if (l->visible && l->locked && !l->order.empty())
+            scheduleRasterRefresh(l);
     }
+    if (virtualized) {
+        refreshResidency();
+    } else {
+        // Без виртуализации на сцене стоит весь документ — O(n), см. DocumentContent
+        for (Shape* s : grid.shapes())
+            materialize(s);
+    }
+    emit layersChanged();
     emit sceneUpdated();
 }
+
+// Фигуры с уже назначенным id (восстановленные из журнала) сдвигают счётчик вперёд
+void GraphicModel::assignId(Shape* s) {
+    if (s->getId() == 0)
+        s->setId(nextId++);
+    else if (s->getId() >= nextId)
+        nextId = s->getId() + 1;
+}
+
+// ---------------- Размещение фигур ----------------
+
+void GraphicModel::place(Shape* s, Layer* l, qint64 key) {
+    Layer* old = contains(s) ? s->getLayer() : nullptr;
+    if (old) {
+        old->order.erase(s->getZKey());
+        old->markChanged();
+    } else {
+        ++shapeTotal;
+        byId.insert(s->getId(), s);
+        index.insert(s);
+    }
+    l->markChanged();
+
+    l->order[key] = s;
+    s->setLayerPlacement(l, key);
+    s->setZValue(zValueFor(l, key));
+
+    const bool live = grid.contains(s);
+    if (l->isLive() && !live)
+        attach(s);
+    else if (!l->isLive() && live)
+        detach(s, true);
+
+    if (old && old != l && old->locked)
+        scheduleRasterRefresh(old);
+    if (l->locked)
+        scheduleRasterRefresh(l);
+}
+
+void GraphicModel::unplace(Shape* s) {
+    Layer* l = s->getLayer();
+    l->order.erase(s->getZKey());
+    l->markChanged();
+    --shapeTotal;
+    byId.remove(s->getId());
+    index.remove(s);
+    // Флаг выделения сохраняется: Undo вернёт фигуру выделенной
+    if (grid.contains(s))
+        detach(s, false);
+    if (l->locked)
+        scheduleRasterRefresh(l);
+}
+
+void GraphicModel::attach(Shape* s) {
+    grid.insert(s);
+    if (!virtualized || realized.intersects(s->sceneBoundingRect()))
+        materialize(s);
+    // Флаг выделения фигура хранит сама, вне сцены тоже
+    if (s->isSelected())
+        selection->insert(s);
+}
+
+void GraphicModel::detach(Shape* s, bool deselect) {
+    if (deselect)
+        s->setSelected(false);
+    selection->remove(s);
+    grid.remove(s);
+    evict(s);
+}
+
+void GraphicModel::materialize(Shape* s) {
+    if (resident.contains(s))
+        return;
+    resident.insert(s);
+    scene->addItem(s);
+}
+
+void GraphicModel::evict(Shape* s) {
+    if (resident.remove(s))
+        scene->removeItem(s);
+}
+
+// ---------------- Виртуализация сцены ----------------
+
+void GraphicModel::setVirtualized(bool enabled) {
+    if (virtualized == enabled)
+        return;
+    virtualized = enabled;
+    if (!virtualized) {
+        for (Shape* s : grid.shapes())
+            materialize(s);
+        return;
+    }
+    realized = QRectF();
+    setViewport(visible);
+}
+
+bool GraphicModel::isVirtualized() const {
+    return virtualized;
+}
+
+void GraphicModel::setViewport(const QRectF& rect) {
+    visible = rect;
+    if (!virtualized)
+        return;
+    // Прокрутка в пределах запаса и небольшое приближение сцену не трогают
+    const bool outside = !realized.contains(rect);
+    const bool oversized = realized.width() > rect.width() * (1 + 2 * kPrefetch) * kRealizeSlack
+                        || realized.height() > rect.height() * (1 + 2 * kPrefetch) * kRealizeSlack;
+    if (!outside && !oversized)
+        return;
+    realized = rect.adjusted(-rect.width() * kPrefetch, -rect.height() * kPrefetch,
+                             +rect.width() * kPrefetch, +rect.height() * kPrefetch);
+    refreshResidency();
+}
+
+int GraphicModel::residentCount() const {
+    return resident.size();
+}
+
+void GraphicModel::refreshResidency() {
+    if (!virtualized)
+        return;
+    // Пока сцена тащит фигуры, состав сцены заморожен: вошедшей посреди перетаскивания
+    // фигуры нет в начальных позициях Qt, а ушедшая перестала бы двигаться.
+    // По отпускании контроллер вызывает refreshResidency снова
+    if (dynamic_cast<Shape*>(scene->mouseGrabberItem()))
+        return;
+    const QList<Shape*> wanted = grid.query(realized);
+    const QSet<Shape*> keep(wanted.begin(), wanted.end());
+
+    // Сначала снять ушедшие из области, затем поставить вошедшие
+    const QSet<Shape*> before = resident;
+    for (Shape* s : before)
+        if (!keep.contains(s))
+            evict(s);
+    for (Shape* s : wanted)
+        materialize(s);
+}
+
+void GraphicModel::clearSelection() {
+    scene->clearSelection();
+    clearOffSceneSelection();
+}
+
+void GraphicModel::clearOffSceneSelection() {
+    // Копия: снятие флага возвращается в selection через shapeSelectionChanged
+    const QSet<Shape*> selected = selection->set();
+    for (Shape* s : selected)
+        if (!resident.contains(s))
+            s->setSelected(false);
+}
+
+bool GraphicModel::isActiveLayer(Layer* l) const {
+    return layers.contains(l);
+}
+
+void GraphicModel::bringToFront(Shape* s) {
+    if (contains(s) && s->getLayer()->topKey() != s->getZKey())
+        place(s, s->getLayer(), s->getLayer()->topKey() + 1);
+}
+
+void GraphicModel::sendToBack(Shape* s) {
+    if (contains(s) && s->getLayer()->bottomKey() != s->getZKey())
+        place(s, s->getLayer(), s->getLayer()->bottomKey() - 1);
+}
+
+void GraphicModel::moveToLayer(Shape* s, Layer* l) {
+    if (contains(s) && s->getLayer() != l && isActiveLayer(l))
+        place(s, l, l->topKey() + 1);
+}
+
+void GraphicModel::placeShape(Shape* s, Layer* l, qint64 key) {
+    if (!contains(s))
+        return;
+    if (!isActiveLayer(l))
+        l = current;
+    // Ключ уже у самой фигуры — ничего не делать; занят другой — наверх
+    if (s->getLayer() == l && s->getZKey() == key)
+        return;
+    if (l->order.count(key))
+        key = l->topKey() + 1;
+    place(s, l, key);
+}
+
+// ---------------- Слои ----------------
+
+QList<Layer*> GraphicModel::getLayers() const {
+    return layers;
+}
+
+Layer* GraphicModel::getCurrentLayer() const {
+    return current;
+}
+
+void GraphicModel::setCurrentLayer(Layer* l) {
+    if (l == current || !isActiveLayer(l))
+        return;
+    current = l;
+    emit layersChanged();
+}
+
+Layer* GraphicModel::addLayer(const QString& name) {
+    Layer* l = new Layer(name);
+    l->position = layers.size();
+    l->index    = &index;
+    l->model    = this;
+    layers.append(l);
+    layoutChanged = true;
+    current = l;
+    emit layersChanged();
+    return l;
+}
+
+void GraphicModel::removeLayer(Layer* l) {
+    if (layers.size() < 2 || !isActiveLayer(l))
+        return;
+
+    const int at = layers.indexOf(l);
+    Layer* target = layers.at(at > 0 ? at - 1 : 1);
+    // Фигуры ложатся поверх соседнего слоя в прежнем порядке
+    const QList<Shape*> moved = l->shapes();
+    for (Shape* s : moved)
+        place(s, target, target->topKey() + 1);
+
+    delete l->raster;
+    l->raster = nullptr;
+    layers.removeAt(at);
+    layoutChanged = true;
+    retired.append(l);
+    staleRasters.remove(l);
+    if (current == l)
+        current = target;
+    renumberLayers();
+    emit layersChanged();
+    emit sceneUpdated();
+}
+
+void GraphicModel::moveLayer(Layer* l, int position) {
+    const int from = layers.indexOf(l);
+    position = qBound(0, position, layers.size() - 1);
+    if (from < 0 || from == position)
+        return;
+    layers.move(from, position);
+    layoutChanged = true;
+    renumberLayers();
+    emit layersChanged();
+    emit sceneUpdated();
+}
+
+void GraphicModel::renameLayer(Layer* l, const QString& name) {
+    if (!isActiveLayer(l) || l->name == name)
+        return;
+    l->name = name;
+    l->markChanged();
+    emit layersChanged();
+}
+
+void GraphicModel::setLayerVisible(Layer* l, bool visible) {
+    if (!isActiveLayer(l) || l->visible == visible)
+        return;
+    l->visible = visible;
+    l->markChanged();
+    syncLayer(l);
+    emit layersChanged();
+    emit sceneUpdated();
+}
+
+void GraphicModel::setLayerLocked(Layer* l, bool locked) {
+    if (!isActiveLayer(l) || l->locked == locked)
+        return;
+    l->locked = locked;
+    l->markChanged();
+    syncLayer(l);
+    emit layersChanged();
+    emit sceneUpdated();
+}
+
+// Смена положения слоёв меняет z всех фигур сдвинувшихся слоёв — это O(фигур слоя),
+// а не O(n log n) пересортировка всего документа
+void GraphicModel::renumberLayers() {
+    for (int i = 0; i < layers.size(); ++i) {
+        Layer* l = layers.at(i);
+        if (l->position == i)
+            continue;
+        l->position = i;
+        for (const auto& entry : l->order)
+            entry.second->setZValue(zValueFor(l, entry.first));
+        if (l->raster)
+            l->raster->setZValue(zValueFor(l, 0));
+    }
+}
+
+void GraphicModel::syncLayer(Layer* l) {
+    delete l->raster;
+    l->raster = nullptr;
+    staleRasters.remove(l);
+
+    if (l->isLive()) {
+        for (const auto& entry : l->order)
+            if (!grid.contains(entry.second))
+                attach(entry.second);
+        return;
+    }
+
+    // Сначала снять выделение, чтобы в растр не попали рамки и ручки
+    for (const auto& entry : l->order)
+        entry.second->setSelected(false);
+    for (const auto& entry : l->order)
+        if (grid.contains(entry.second))
+            detach(entry.second, false);
+    // Растр — по фигурам уже вне сцены: каждая рисуется своим paint(), мимо пакетных серий
+    if (l->visible && l->locked && !l->order.empty()) {
+        l->raster = new LayerRasterItem(l->shapes());
+        l->raster->setZValue(zValueFor(l, 0));
+        scene->addItem(l->raster);
+    }
+}
+
+void GraphicModel::scheduleRasterRefresh(Layer* l) {
+    // Пакетные операции трогают слой много раз — растр пересобирается один раз
+    if (staleRasters.isEmpty())
+        QMetaObject::invokeMethod(this, "refreshStaleRasters", Qt::QueuedConnection);
+    staleRasters.insert(l);
+}
+
+void GraphicModel::refreshStaleRasters() {
+    const QSet<Layer*> stale = staleRasters;
+    staleRasters.clear();
+    for (Layer* l : stale)
+        if (isActiveLayer(l) && l->locked)
+            syncLayer(l);
+}
+
+// ---------------- Поиск по атрибутам ----------------
+
+QList<Shape*> GraphicModel::find(const ShapeQuery& query) const {
+    return index.find(query);
+}
+
+int GraphicModel::count(const ShapeQuery& query) const {
+    return index.count(query);
+}
+
+// ---------------- Снимок документа ----------------
+
+DocumentSnapshot GraphicModel::snapshot() const {
+    bool changed = layoutChanged;
+    QVector<QSharedPointer<const LayerSnapshot>> parts;
+    parts.reserve(layers.size());
+    int total = 0;
+    for (Layer* l : layers) {
+        if (!l->snapshot) {
+            // Копируются только указатели на общие данные фигур
+            QSharedPointer<LayerSnapshot> ls(new LayerSnapshot);
+            ls->name    = l->name;
+            ls->visible = l->visible;
+            ls->locked  = l->locked;
+            ls->shapes.reserve(int(l->order.size()));
+            for (const auto& entry : l->order) {
+                SnapshotShape ss;
+                ss.id   = entry.second->getId();
+                ss.data = entry.second->sharedData();
+                ss.pos  = entry.second->pos();
+                ss.zKey = entry.first;
+                ls->shapes.append(ss);
+            }
+            l->snapshot = ls;
+            changed = true;
+        }
+        parts.append(l->snapshot);
+        total += l->snapshot->shapes.size();
+    }
+
+    if (changed) {
+        lastSnapshot.layers    = parts;
+        lastSnapshot.total     = total;
+        lastSnapshot.sceneRect = scene->sceneRect();
+        ++lastSnapshot.version;
+        layoutChanged = false;
+    }
+    return lastSnapshot;
+}
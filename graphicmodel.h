@@ -4,40 +4,216 @@
 
 #include <QObject>
 #include <QList>
+#include <QSet>
 #include <QVector>
 #include <QPointF>
 #include <QColor>
 #include <QFont>
 #include "customgraphicsscene.h"
 #include "shape.h"
+#include "shapeselection.h"
+#include "layer.h"
+#include "documentsnapshot.h"
+#include "shapeindex.h"
+#include "shapegrid.h"
+
+// Содержимое документа, снятое с модели целиком: слои с фигурами, индекс, сетка,
+// выделение. При виртуализации модель обменивается им за O(1) плюс фигуры у вида
+// (GraphicModel::swapDocument) — так «Очистить всё» и его Undo не трогают фигуры
+// по одной. Без виртуализации на сцене стоят все фигуры, и обмен — O(n): каждую
+// старую фигуру снимают со сцены, каждую новую ставят (окно виртуализацию включает,
+// выключена она в безоконном проигрывании сессий).
+// Владеет своими слоями и фигурами. Фигуры — элементы QGraphicsItem, поэтому
+// удалять документ можно только в GUI-потоке и только пока он не стоит в модели.
+class DocumentContent {
+public:
+    DocumentContent();
+    ~DocumentContent();
+
+    // Удалить документ по частям из цикла событий GUI-потока: миллионы фигур
+    // не подвешивают интерфейс одним удалением
+    static void disposeLater(DocumentContent* document);
+
+    int shapeCount() const { return shapeTotal; }
+
+private:
+    friend class GraphicModel;
+
+    // Удалить до budget фигур; true — документ опустел и удалён
+    static bool disposeSlice(DocumentContent* document, int budget);
+
+    QList<Layer*>  layers;
+    QList<Layer*>  retired;
+    Layer*         current;
+    ShapeIndex     index;
+    ShapeGrid      grid;
+    QSet<Shape*>   selected;
+    QHash<quint64, Shape*> byId;
+    int            shapeTotal;
+};
+
+// Новые значения одной фигуры в кадре анимации (поля — Shape::AnimatedField)
+struct ShapeFrame {
+    Shape*  shape  = nullptr;
+    int     fields = 0;
+    QPointF pos;
+    QColor  color;
+    QPointF endPos;
+};
 
 class GraphicModel : public QObject {
     Q_OBJECT
 public:
     explicit GraphicModel(QObject* parent = nullptr);
+    ~GraphicModel() override;
 
-    void addShape(ShapeType type,
-                  const QPointF& pos,
-                  const QColor& color,
-                  const QFont& font = QFont());
+    // Новая фигура — наверх текущего слоя
+    Shape* addShape(ShapeType type,
+                    const QPointF& pos,
+                    const QColor& color,
+                    const QFont& font = QFont());
 
     void removeShape(Shape* shape);
     void clear();
 
+    // Все фигуры в порядке наложения: слои снизу вверх, внутри слоя — по z
     QList<Shape*> getShapes() const;
+    int           shapeCount() const;
+    bool          contains(Shape* shape) const;
+    // Фигура документа по id (nullptr — такой в документе нет, например удалена)
+    Shape*        shapeById(quint64 id) const;
+
     CustomGraphicsScene* getScene() const;
+    ShapeSelection*      getSelection() const;
+
+    // Уведомления от фигур (через их слой): сменились выделение, позиция или габариты
+    void shapeSelectionChanged(Shape* shape, bool selected);
+    void shapeGeometryChanged(Shape* shape);
+
+    // Попадания по сетке модели, а не по сцене: фигуры видимых незаблокированных
+    // слоёв под точкой (сверху вниз) и в области (снизу вверх)
+    QList<Shape*> shapesAt(const QPointF& pos) const;
+    QList<Shape*> shapesIn(const QRectF& rect) const;
+    // Фигура на видимом незаблокированном слое: её можно выделять и править
+    bool          isEditable(Shape* shape) const;
+
+    // Виртуализация сцены: на QGraphicsScene стоят только фигуры у видимой области
+    // (с запасом на прокрутку), остальные — в том числе выделенные — живут лишь
+    // в слоях и сетке модели. Сами фигуры остаются элементами сцены (пул фигур,
+    // общие данные), виртуализуется только их присутствие в индексе сцены.
+    // Выделение, попадания и Undo работают с моделью и виртуализации не замечают
+    void setVirtualized(bool enabled);
+    bool isVirtualized() const;
+    // Видимая область вида в координатах сцены (вид сообщает её при прокрутке и зуме)
+    void setViewport(const QRectF& rect);
+    // Привести фигуры на сцене к области у вида (после перетаскивания выделенного)
+    void refreshResidency();
+    // Сколько фигур сейчас на сцене
+    int  residentCount() const;
+
+    // Снять выделение со всех фигур, на сцене и вне её
+    void clearSelection();
+    // Только с фигур вне сцены: со своих элементов выделение снимает сама сцена
+    void clearOffSceneSelection();
 
     // Для Undo/Redo:
     void addExistingShape(Shape* shape);
     void removeExistingShape(Shape* shape);
     void setShapes(const QVector<Shape*>& shapes);
 
+    // Пустой документ с одним слоем, готовый встать в эту модель
+    DocumentContent* newDocument();
+    // Обменять документ модели на другой целиком. Структуры модели меняются за O(1),
+    // сцена — по фигурам на ней: при виртуализации это фигуры у вида, без неё — все
+    void swapDocument(DocumentContent* other);
+
+    // Пакетные варианты для вставки/дублирования: одно уведомление на пакет
+    void addExistingShapes(const QList<Shape*>& shapes);
+    void removeExistingShapes(const QList<Shape*>& shapes);
+    // Сдвиг пачки фигур (выравнивание, распределение): positions — по фигуре на элемент
+    void moveShapes(const QList<Shape*>& shapes, const QVector<QPointF>& positions);
+    // Кадр анимации: выставить значения всем фигурам разом, переложить их в сетке
+    // и индексе и перерисовать общую область одним обновлением сцены.
+    // Фигуры не из живых слоёв пропускаются. Слои не помечаются изменёнными:
+    // снимки документа (автосохранение) держат значения до анимации, а вернуть
+    // их фигурам — дело того, кто проигрывает (AnimationEngine)
+    void applyFrame(const QVector<ShapeFrame>& frame);
+
+    // Слои (снизу вверх)
+    QList<Layer*> getLayers() const;
+    Layer*        getCurrentLayer() const;
+    void          setCurrentLayer(Layer* layer);
+    Layer*        addLayer(const QString& name);
+    // Фигуры удаляемого слоя переходят в соседний; последний слой не удаляется
+    void          removeLayer(Layer* layer);
+    void          moveLayer(Layer* layer, int position);
+    void          renameLayer(Layer* layer, const QString& name);
+    void          setLayerVisible(Layer* layer, bool visible);
+    void          setLayerLocked(Layer* layer, bool locked);
+
+    // Порядок наложения — O(log n) на фигуру
+    void bringToFront(Shape* shape);
+    void sendToBack(Shape* shape);
+    void moveToLayer(Shape* shape, Layer* layer);
+    // Вернуть фигуру на точное место (для Undo); занятый ключ — наверх слоя
+    void placeShape(Shape* shape, Layer* layer, qint64 zKey);
+
+    // Неизменяемый снимок документа для фоновых читателей. Дёшев: пересобираются
+    // только слои, изменённые с прошлого вызова; без правок возвращается тот же снимок
+    DocumentSnapshot snapshot() const;
+
+    // Поиск по типу, цвету и словам текста через вторичные индексы:
+    // стоимость пропорциональна числу кандидатов, а не размеру документа
+    QList<Shape*> find(const ShapeQuery& query) const;
+    int           count(const ShapeQuery& query) const;
+
 signals:
     void sceneUpdated();
+    void layersChanged();
+
+private slots:
+    void refreshStaleRasters();
 
 private:
+    void   assignId(Shape* shape);
+
+    // Поставить фигуру в слой под ключом, выставить z и присутствие на сцене
+    void   place(Shape* shape, Layer* layer, qint64 zKey);
+    // Убрать фигуру из модели (место в слое фигура помнит)
+    void   unplace(Shape* shape);
+    // Фигура становится живой (сетка, выделение) или перестаёт ей быть
+    void   attach(Shape* shape);
+    void   detach(Shape* shape, bool deselect);
+    // Поставить живую фигуру на сцену или снять с неё
+    void   materialize(Shape* shape);
+    void   evict(Shape* shape);
+    // Снять со сцены или вернуть фигуры слоя после смены видимости/блокировки
+    void   syncLayer(Layer* layer);
+    void   renumberLayers();
+    void   scheduleRasterRefresh(Layer* layer);
+    bool   isActiveLayer(Layer* layer) const;
+
+    static qreal zValueFor(const Layer* layer, qint64 zKey);
+
     CustomGraphicsScene* scene;
-    QList<Shape*>        shapes;
+    ShapeSelection*      selection;
+    QList<Layer*>        layers;
+    QList<Layer*>        retired;       // удалённые слои: на них ещё ссылаются фигуры из истории Undo
+    Layer*               current;
+    QSet<Layer*>         staleRasters;
+    ShapeIndex           index;
+    ShapeGrid            grid;          // все живые фигуры, на сцене и вне её
+    QHash<quint64, Shape*> byId;        // все фигуры документа
+    int                  shapeTotal;
+    quint64              nextId;
+
+    bool                 virtualized;
+    QRectF               visible;       // видимая область вида
+    QRectF               realized;      // область, фигуры которой стоят на сцене
+    QSet<Shape*>         resident;      // живые фигуры на сцене
+
+    mutable DocumentSnapshot lastSnapshot;
+    mutable bool             layoutChanged;   // слои добавлены, удалены или переставлены
 };
 
 #endif // GRAPHICMODEL_H
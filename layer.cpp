@@ -0,0 +1,138 @@
+// layer.cpp
+#include "layer.h"
+#include "customgraphicsscene.h"
+#include "graphicmodel.h"
+#include "shapeindex.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+namespace {
+
+const qreal kRasterScale   = 2.0;    // запас чёткости при приближении
+const int   kRasterMaxSide = 4096;   // px
+
+} // namespace
+
+Layer::Layer(const QString& name)
+    : name(name)
+    , visible(true)
+    , locked(false)
+    , position(0)
+    , raster(nullptr)
+    , index(nullptr)
+    , model(nullptr)
+{ }
+
+Layer::~Layer() {
+    delete raster;
+}
+
+QString Layer::getName() const {
+    return name;
+}
+
+void Layer::setName(const QString& n) {
+    name = n;
+}
+
+bool Layer::isVisible() const {
+    return visible;
+}
+
+bool Layer::isLocked() const {
+    return locked;
+}
+
+bool Layer::isLive() const {
+    return visible && !locked;
+}
+
+int Layer::count() const {
+    return int(order.size());
+}
+
+QList<Shape*> Layer::shapes() const {
+    QList<Shape*> list;
+    list.reserve(int(order.size()));
+    for (const auto& entry : order)
+        list.append(entry.second);
+    return list;
+}
+
+int Layer::getPosition() const {
+    return position;
+}
+
+void Layer::markChanged() {
+    snapshot.reset();
+}
+
+void Layer::shapeChanged(Shape* s) {
+    markChanged();
+    if (model)
+        model->shapeGeometryChanged(s);
+}
+
+void Layer::attributesChanged(Shape* s) {
+    shapeChanged(s);
+    if (index)
+        index->update(s);
+}
+
+void Layer::selectionChanged(Shape* s, bool selected) {
+    if (model)
+        model->shapeSelectionChanged(s, selected);
+}
+
+qint64 Layer::topKey() const {
+    return order.empty() ? 0 : order.rbegin()->first;
+}
+
+qint64 Layer::bottomKey() const {
+    return order.empty() ? 0 : order.begin()->first;
+}
+
+// ---------------- LayerRasterItem ----------------
+
+LayerRasterItem::LayerRasterItem(const QList<Shape*>& shapes, QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+{
+    for (const Shape* s : shapes)
+        sceneRect |= s->sceneBoundingRect();
+    if (sceneRect.isEmpty())
+        return;
+
+    const qreal scale = qMin(kRasterScale,
+                             kRasterMaxSide / qMax(sceneRect.width(), sceneRect.height()));
+    image = QImage((sceneRect.size() * scale).toSize().expandedTo(QSize(1, 1)),
+                   QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    // Фигуры рисуются своим paint() в порядке слоя — как их нарисовал бы вид
+    QPainter p(&image);
+    p.setRenderHint(QPainter::Antialiasing);
+    p.scale(scale, scale);
+    p.translate(-sceneRect.topLeft());
+    QStyleOptionGraphicsItem option;
+    for (Shape* s : shapes) {
+        p.save();
+        p.translate(s->scenePos());
+        s->paint(&p, &option, nullptr);
+        p.restore();
+    }
+}
+
+QRectF LayerRasterItem::boundingRect() const {
+    return sceneRect;
+}
+
+void LayerRasterItem::paint(QPainter* painter,
+                            const QStyleOptionGraphicsItem* /*option*/,
+                            QWidget* /*widget*/)
+{
+    if (image.isNull())
+        return;
+    const auto* sc = qobject_cast<CustomGraphicsScene*>(scene());
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, !(sc && sc->isDraftMode()));
+    painter->drawImage(sceneRect, image);
+}
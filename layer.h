@@ -0,0 +1,83 @@
+// layer.h
+#ifndef LAYER_H
+#define LAYER_H
+
+#include <QGraphicsItem>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <map>
+#include "shape.h"
+#include "documentsnapshot.h"
+
+class ShapeIndex;
+class GraphicModel;
+
+class LayerRasterItem;
+
+// Именованный слой документа. Фигуры слоя упорядочены по ключу z в std::map:
+// «наверх», «вниз» и перенос между слоями — O(log n) без перестановок в списках.
+// Скрытый или заблокированный слой снимает свои фигуры со сцены, поэтому
+// не тратит ничего на отрисовку и попадания; заблокированный рисуется одним растром.
+class Layer {
+public:
+    explicit Layer(const QString& name);
+    ~Layer();
+
+    QString getName() const;
+    void    setName(const QString& name);
+
+    bool isVisible() const;
+    bool isLocked() const;
+    // Фигуры слоя на сцене и доступны для редактирования
+    bool isLive() const;
+
+    int count() const;
+    // Фигуры снизу вверх
+    QList<Shape*> shapes() const;
+
+    // Положение слоя в документе (0 — нижний); ведёт модель
+    int getPosition() const;
+
+    // Содержимое слоя изменилось — кэшированный снимок слоя сбрасывается
+    void markChanged();
+    // Сменились позиция или геометрия фигуры слоя — ещё и переложить её в сетке модели
+    void shapeChanged(Shape* shape);
+    // Сменился цвет или текст фигуры слоя — ещё и перестроить её ключи в индексе модели
+    void attributesChanged(Shape* shape);
+    // Фигуру слоя выделили или сняли выделение (в том числе вне сцены)
+    void selectionChanged(Shape* shape, bool selected);
+
+private:
+    friend class GraphicModel;
+
+    qint64 topKey() const;
+    qint64 bottomKey() const;
+
+    QString                  name;
+    bool                     visible;
+    bool                     locked;
+    int                      position;
+    std::map<qint64, Shape*> order;     // ключ z -> фигура
+    LayerRasterItem*         raster;    // только у заблокированного слоя
+    QSharedPointer<const LayerSnapshot> snapshot;  // пуст, пока слой не попросили снять
+    ShapeIndex*              index;     // индекс атрибутов модели
+    GraphicModel*            model;     // модель-владелец (сетка, выделение, виртуализация)
+};
+
+// Кэшированный растр заблокированного слоя: один drawImage вместо всех фигур
+class LayerRasterItem : public QGraphicsItem {
+public:
+    LayerRasterItem(const QList<Shape*>& shapes, QGraphicsItem* parent = nullptr);
+
+    QRectF boundingRect() const override;
+    void   paint(QPainter* painter,
+                 const QStyleOptionGraphicsItem* option,
+                 QWidget* widget = nullptr) override;
+
+private:
+    QRectF sceneRect;
+    QImage image;
+};
+
+#endif // LAYER_H
@@ -0,0 +1,119 @@
+// layerpanel.cpp
+#include "layerpanel.h"
+#include <QHBoxLayout>
+#include <QSignalBlocker>
+#include <QVBoxLayout>
+
+LayerPanel::LayerPanel(GraphicModel* m, QWidget* parent)
+    : QWidget(parent)
+    , model(m)
+    , list(new QListWidget(this))
+    , addBtn(new QPushButton("+", this))
+    , removeBtn(new QPushButton("-", this))
+    , upBtn(new QPushButton("Up", this))
+    , downBtn(new QPushButton("Down", this))
+    , lockBtn(new QPushButton("Lock", this))
+    , rebuilding(false)
+{
+    lockBtn->setCheckable(true);
+
+    QHBoxLayout* buttons = new QHBoxLayout;
+    buttons->addWidget(addBtn);
+    buttons->addWidget(removeBtn);
+    buttons->addWidget(upBtn);
+    buttons->addWidget(downBtn);
+    buttons->addWidget(lockBtn);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(list);
+    layout->addLayout(buttons);
+
+    // Пересборка в очереди: сигнал модели приходит из обработчика строки списка
+    connect(model, &GraphicModel::layersChanged,   this, &LayerPanel::rebuild, Qt::QueuedConnection);
+    connect(list,  &QListWidget::itemChanged,      this, &LayerPanel::onItemChanged);
+    connect(list,  &QListWidget::currentRowChanged, this, &LayerPanel::onCurrentRowChanged);
+    connect(addBtn,    &QPushButton::clicked, this, &LayerPanel::onAdd);
+    connect(removeBtn, &QPushButton::clicked, this, &LayerPanel::onRemove);
+    connect(upBtn,     &QPushButton::clicked, this, &LayerPanel::onUp);
+    connect(downBtn,   &QPushButton::clicked, this, &LayerPanel::onDown);
+    connect(lockBtn,   &QPushButton::toggled, this, &LayerPanel::onLockToggled);
+
+    rebuild();
+}
+
+// Строка 0 — верхний слой
+Layer* LayerPanel::layerAt(int row) const {
+    const QList<Layer*> layers = model->getLayers();
+    const int i = layers.size() - 1 - row;
+    return (row >= 0 && i >= 0) ? layers.at(i) : nullptr;
+}
+
+void LayerPanel::rebuild() {
+    // Слоёв единицы — список проще пересобрать, чем синхронизировать
+    rebuilding = true;
+    const QList<Layer*> layers = model->getLayers();
+    list->clear();
+    int currentRow = 0;
+    for (int i = layers.size() - 1; i >= 0; --i) {
+        Layer* l = layers.at(i);
+        QString title = l->getName();
+        if (l->isLocked())
+            title += " [locked]";
+        QListWidgetItem* item = new QListWidgetItem(title, list);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsEditable);
+        item->setCheckState(l->isVisible() ? Qt::Checked : Qt::Unchecked);
+        if (l == model->getCurrentLayer())
+            currentRow = list->count() - 1;
+    }
+    list->setCurrentRow(currentRow);
+
+    Layer* cur = model->getCurrentLayer();
+    const QSignalBlocker block(lockBtn);
+    lockBtn->setChecked(cur && cur->isLocked());
+    removeBtn->setEnabled(layers.size() > 1);
+    rebuilding = false;
+}
+
+void LayerPanel::onItemChanged(QListWidgetItem* item) {
+    if (rebuilding)
+        return;
+    Layer* l = layerAt(list->row(item));
+    if (!l)
+        return;
+    const bool visible = item->checkState() == Qt::Checked;
+    const QString name = item->text().remove(" [locked]");
+    if (visible != l->isVisible())
+        model->setLayerVisible(l, visible);
+    else if (!name.isEmpty())
+        model->renameLayer(l, name);
+}
+
+void LayerPanel::onCurrentRowChanged(int row) {
+    if (rebuilding)
+        return;
+    if (Layer* l = layerAt(row))
+        model->setCurrentLayer(l);
+}
+
+void LayerPanel::onAdd() {
+    model->addLayer(QString("Layer %1").arg(model->getLayers().size() + 1));
+}
+
+void LayerPanel::onRemove() {
+    model->removeLayer(model->getCurrentLayer());
+}
+
+void LayerPanel::onUp() {
+    Layer* l = model->getCurrentLayer();
+    model->moveLayer(l, l->getPosition() + 1);
+}
+
+void LayerPanel::onDown() {
+    Layer* l = model->getCurrentLayer();
+    model->moveLayer(l, l->getPosition() - 1);
+}
+
+void LayerPanel::onLockToggled(bool checked) {
+    model->setLayerLocked(model->getCurrentLayer(), checked);
+}
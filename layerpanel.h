@@ -0,0 +1,40 @@
+// layerpanel.h
+#ifndef LAYERPANEL_H
+#define LAYERPANEL_H
+
+#include <QWidget>
+#include <QListWidget>
+#include <QPushButton>
+#include "graphicmodel.h"
+
+// Список слоёв документа: верхний слой — первой строкой.
+// Флажок строки — видимость, двойной щелчок — переименование.
+class LayerPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit LayerPanel(GraphicModel* model, QWidget* parent = nullptr);
+
+private slots:
+    void rebuild();
+    void onItemChanged(QListWidgetItem* item);
+    void onCurrentRowChanged(int row);
+    void onAdd();
+    void onRemove();
+    void onUp();
+    void onDown();
+    void onLockToggled(bool checked);
+
+private:
+    Layer* layerAt(int row) const;
+
+    GraphicModel* model;
+    QListWidget*  list;
+    QPushButton*  addBtn;
+    QPushButton*  removeBtn;
+    QPushButton*  upBtn;
+    QPushButton*  downBtn;
+    QPushButton*  lockBtn;
+    bool          rebuilding;
+};
+
+#endif // LAYERPANEL_H
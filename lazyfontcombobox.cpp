@@ -0,0 +1,81 @@
+// lazyfontcombobox.cpp
+#include "lazyfontcombobox.h"
+#include <QApplication>
+#include <QFontDatabase>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrent>
+
+namespace {
+
+QStringList fontFamilies() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return QFontDatabase::families();
+#else
+    return QFontDatabase().families();
+#endif
+}
+
+} // namespace
+
+LazyFontComboBox::LazyFontComboBox(QWidget* parent)
+    : QComboBox(parent)
+    , populated(false)
+{
+    setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    setMinimumContentsLength(12);
+
+    // До заполнения в списке только текущее семейство
+    addItem(QApplication::font().family());
+
+    connect(this, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int) {
+        emit currentFontChanged(currentFont());
+    });
+    connect(&watcher, &QFutureWatcher<QStringList>::finished, this, [this] {
+        setFamilies(watcher.result());
+    });
+}
+
+QFont LazyFontComboBox::currentFont() const {
+    return QFont(currentText());
+}
+
+void LazyFontComboBox::populateAsync() {
+    if (populated || watcher.isRunning())
+        return;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    // В Qt 6 база шрифтов потокобезопасна — перечисляем в пуле потоков
+    watcher.setFuture(QtConcurrent::run(fontFamilies));
+#else
+    QTimer::singleShot(0, this, &LazyFontComboBox::populate);
+#endif
+}
+
+void LazyFontComboBox::populate() {
+    if (populated)
+        return;
+    // Фоновое перечисление уже идёт — дождаться его, а не начинать заново
+    setFamilies(watcher.isRunning() ? watcher.result() : fontFamilies());
+}
+
+void LazyFontComboBox::setFamilies(const QStringList& families) {
+    if (populated)
+        return;
+    populated = true;
+
+    const QString current = currentText();
+    const bool blocked = blockSignals(true);
+    clear();
+    addItems(families);
+    int index = findText(current);
+    if (index < 0) {
+        insertItem(0, current);
+        index = 0;
+    }
+    setCurrentIndex(index);
+    blockSignals(blocked);
+}
+
+void LazyFontComboBox::showPopup() {
+    populate();
+    QComboBox::showPopup();
+}
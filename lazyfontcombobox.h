@@ -0,0 +1,37 @@
+// lazyfontcombobox.h
+#ifndef LAZYFONTCOMBOBOX_H
+#define LAZYFONTCOMBOBOX_H
+
+#include <QComboBox>
+#include <QFont>
+#include <QFutureWatcher>
+#include <QStringList>
+
+// Замена QFontComboBox без затрат на старте: список семейств шрифтов
+// перечисляется в фоне (populateAsync) или при первом открытии, без превью
+class LazyFontComboBox : public QComboBox {
+    Q_OBJECT
+public:
+    explicit LazyFontComboBox(QWidget* parent = nullptr);
+
+    QFont currentFont() const;
+    bool  isPopulated() const { return populated; }
+
+public slots:
+    void populate();
+    void populateAsync();
+
+signals:
+    void currentFontChanged(const QFont& font);
+
+protected:
+    void showPopup() override;
+
+private:
+    void setFamilies(const QStringList& families);
+
+    bool                        populated;
+    QFutureWatcher<QStringList> watcher;
+};
+
+#endif // LAZYFONTCOMBOBOX_H
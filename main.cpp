@@ -1,11 +1,68 @@
 #include "mainwindow.h"
+#include "sessionrecorder.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// Безголовое проигрывание записанной сессии: печатает задержки и контрольную сумму сцены
+static int replaySession(const QString& path, bool realTime)
+{
+    QTextStream out(stdout);
+    QVector<SessionEvent> events;
+    if (!SessionRecorder::load(path, &events)) {
+        out << "cannot read session " << path << Qt::endl;
+        return 1;
+    }
+
+    const ReplayReport r = SessionReplayer::replay(
+        events, realTime ? SessionReplayer::Pacing::RealTime
+                         : SessionReplayer::Pacing::FullSpeed);
+
+    out << "events:   " << r.events << " (skipped " << r.skipped << ")" << Qt::endl;
+    out << "total:    " << r.totalNs / 1e6 << " ms" << Qt::endl;
+    out << "latency:  p50 " << r.p50Ns / 1e3 << " us, p90 " << r.p90Ns / 1e3
+        << " us, p99 " << r.p99Ns / 1e3 << " us, max " << r.maxNs / 1e3 << " us" << Qt::endl;
+    out << "shapes:   " << r.shapes << Qt::endl;
+    out << "checksum: " << r.checksum << Qt::endl;
+    out << "memory:   " << r.memory.summary() << Qt::endl;
+    for (const QString& line : r.memory.details())
+        out << "          " << line << Qt::endl;
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startupClock;
+    startupClock.start();
+
     QApplication a(argc, argv);
+    a.setApplicationName("GraphicEditor");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption recordOpt("record",   "Record the editing session to <file>.", "file");
+    QCommandLineOption replayOpt("replay",   "Replay a recorded session headlessly and report latency.", "file");
+    QCommandLineOption realTimeOpt("realtime", "Replay with the recorded timing instead of full speed.");
+    QCommandLineOption startupOpt("measure-startup", "Print the time from process start to the first paint.");
+    parser.addOption(recordOpt);
+    parser.addOption(replayOpt);
+    parser.addOption(realTimeOpt);
+    parser.addOption(startupOpt);
+    parser.process(a);
+
+    if (parser.isSet(replayOpt))
+        return replaySession(parser.value(replayOpt), parser.isSet(realTimeOpt));
+
     MainWindow w;
+    if (parser.isSet(startupOpt))
+        w.measureStartup(startupClock);
+    // Запись ведётся с пустого документа, чтобы её можно было проиграть на чистой сцене
+    if (parser.isSet(recordOpt))
+        w.setSessionRecorder(new SessionRecorder(parser.value(recordOpt), &w));
+    else
+        w.enableAutosave();
     w.show();
     return a.exec();
 }
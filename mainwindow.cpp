@@ -1,20 +1,52 @@
 // mainwindow.cpp
 #include "mainwindow.h"
 #include <QAction>
+#include <QKeySequence>
 #include <QColorDialog>
 #include <QStyle>
+#include <QStandardPaths>
+#include <QDockWidget>
+#include <QTimer>
+#include <QStatusBar>
+#include <QLabel>
+#include <QFileDialog>
+#include <QMenu>
+#include <QMessageBox>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+#include "memorypool.h"
+#include "vectorexporter.h"
+
+namespace {
+
+struct ExportResult {
+    bool                  ok = false;
+    QString               error;
+    VectorExporter::Stats stats;
+};
+
+} // namespace
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
     , view(nullptr)
     , toolBar(nullptr)
+    , minimap(nullptr)
+    , layerPanel(nullptr)
+    , findDialog(nullptr)
     , fontCombo(nullptr)
     , sizeCombo(nullptr)
     , boldBtn(nullptr)
     , italicBtn(nullptr)
     , underlineBtn(nullptr)
+    , fontAnchor(nullptr)
+    , memoryLabel(nullptr)
+    , firstPaintDone(false)
     , model(new GraphicModel(this))
     , controller(new GraphicController(model, this))
+    , journal(nullptr)
+    , recorder(nullptr)
+    , animation(new AnimationEngine(model, this))
 {
     setupUI();
     setupToolBar();
@@ -24,18 +56,29 @@ MainWindow::MainWindow(QWidget* parent)
 MainWindow::~MainWindow() {}
 
 void MainWindow::setupUI() {
-    view = new QGraphicsView(this);
-    view->setScene(model->getScene());
-    view->setRenderHint(QPainter::Antialiasing);
+    // Зум колесом, панорама средней кнопкой; качество падает только на время жеста
+    view = new EditorView(model->getScene(), this);
 
     // Полный режим обновления: при любом изменении сцены вьюпорт перерисовывается целиком
     view->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
 
-    view->setDragMode(QGraphicsView::RubberBandDrag);
+    // Простые фигуры рисуются пакетами по типу и цвету, а не по одной
+    model->getScene()->setBatchedRendering(true);
+
+    // На сцене только фигуры у видимой области: большой документ не держит
+    // в индексе сцены миллионы элементов
+    model->setVirtualized(true);
+    connect(view, &EditorView::visibleRectChanged, model, &GraphicModel::setViewport);
+
+    // Резиновую рамку ведёт контроллер через выделение модели, а не QGraphicsView
+    view->setDragMode(QGraphicsView::NoDrag);
     setCentralWidget(view);
 
     toolBar = new QToolBar("Tools", this);
     addToolBar(Qt::LeftToolBarArea, toolBar);
+
+    // Первый кадр ловим на вьюпорте: после него достраиваем остальной интерфейс
+    view->viewport()->installEventFilter(this);
 }
 
 void MainWindow::setupToolBar() {
@@ -45,6 +88,8 @@ void MainWindow::setupToolBar() {
     QAction* rectAction    = toolBar->addAction("Rectangle");
     QAction* ellipseAction = toolBar->addAction("Ellipse");
     QAction* starAction    = toolBar->addAction("Star");
+    QAction* curveAction   = toolBar->addAction("Curve");
+    QAction* penAction     = toolBar->addAction("Pen");
     QAction* textAction    = toolBar->addAction("Text");
     toolBar->addSeparator();
 
@@ -57,8 +102,144 @@ void MainWindow::setupToolBar() {
     QAction* clearAction  = toolBar->addAction("Clear");
     toolBar->addSeparator();
 
-    // Шрифтовые виджеты
-    fontCombo    = new QFontComboBox(this);
+    // Буфер обмена
+    QAction* copyAction      = toolBar->addAction("Copy");
+    QAction* pasteAction     = toolBar->addAction("Paste");
+    QAction* duplicateAction = toolBar->addAction("Duplicate");
+    QAction* exportAction    = toolBar->addAction("Export");
+    QAction* imageAction     = toolBar->addAction("Image");
+    QAction* findAction      = toolBar->addAction("Find");
+    copyAction->setShortcut(QKeySequence::Copy);
+    pasteAction->setShortcut(QKeySequence::Paste);
+    duplicateAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_D));
+    findAction->setShortcut(QKeySequence::Find);
+    toolBar->addSeparator();
+
+    // Порядок наложения и перенос выделенного в текущий слой
+    QAction* frontAction   = toolBar->addAction("Front");
+    QAction* backAction    = toolBar->addAction("Back");
+    QAction* toLayerAction = toolBar->addAction("To Layer");
+    frontAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_BracketRight));
+    backAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_BracketLeft));
+
+    // Выравнивание и распределение выделенного — одной кнопкой с меню
+    QMenu* alignMenu = new QMenu(this);
+    const struct { const char* text; ShapeLayout::Align how; } aligns[] = {
+        { "Align Left",   ShapeLayout::Align::Left    },
+        { "Align Center", ShapeLayout::Align::HCenter },
+        { "Align Right",  ShapeLayout::Align::Right   },
+        { "Align Top",    ShapeLayout::Align::Top     },
+        { "Align Middle", ShapeLayout::Align::VCenter },
+        { "Align Bottom", ShapeLayout::Align::Bottom  },
+    };
+    for (const auto& a : aligns) {
+        const ShapeLayout::Align how = a.how;
+        connect(alignMenu->addAction(a.text), &QAction::triggered, this,
+                [this, how] { controller->alignSelection(how); });
+    }
+    alignMenu->addSeparator();
+    connect(alignMenu->addAction("Distribute Horizontally"), &QAction::triggered, this,
+            [this] { controller->distributeSelection(Qt::Horizontal); });
+    connect(alignMenu->addAction("Distribute Vertically"), &QAction::triggered, this,
+            [this] { controller->distributeSelection(Qt::Vertical); });
+    QToolButton* alignBtn = new QToolButton(this);
+    alignBtn->setText("Align");
+    alignBtn->setMenu(alignMenu);
+    alignBtn->setPopupMode(QToolButton::InstantPopup);
+    toolBar->addWidget(alignBtn);
+
+    // Анимация по ключам: ключ — текущее состояние выделенного, следующий ставится
+    // через секунду; воспроизведение — предпросмотр вне Undo
+    QMenu* animMenu = new QMenu(this);
+    QAction* keyAction = animMenu->addAction("Set Keyframe");
+    keyAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_K));
+    addAction(keyAction);   // сочетание работает и при закрытом меню
+    connect(keyAction, &QAction::triggered, this, [this] {
+        const qreal at = animation->currentTime();
+        for (Shape* s : model->getSelection()->shapes())
+            animation->setKeys(s, at);
+        animation->seek(at + 1.0);
+    });
+    connect(animMenu->addAction("Play / Pause"), &QAction::triggered, this, [this] {
+        if (animation->isPlaying())
+            animation->pause();
+        else
+            animation->play();
+    });
+    connect(animMenu->addAction("Rewind"), &QAction::triggered, this,
+            [this] { animation->seek(0); });
+    connect(animMenu->addAction("Clear Animation"), &QAction::triggered, this,
+            [this] { animation->clear(); });
+    QToolButton* animBtn = new QToolButton(this);
+    animBtn->setText("Animate");
+    animBtn->setMenu(animMenu);
+    animBtn->setPopupMode(QToolButton::InstantPopup);
+    toolBar->addWidget(animBtn);
+
+    // Пересечения: проверка чертежа и подсветка при перетаскивании
+    QMenu* overlapMenu = new QMenu(this);
+    connect(overlapMenu->addAction("Select Overlapping"), &QAction::triggered, this,
+            [this] { controller->selectOverlapping(); });
+    connect(overlapMenu->addAction("Find Intersecting Pairs"), &QAction::triggered, this, [this] {
+        // Участники пар выделяются; число пар — отдельным сообщением,
+        // строку состояния перепишет счётчик выделения
+        const int n = controller->selectIntersectingPairs();
+        QMessageBox::information(this, "Intersecting Pairs",
+                                 n ? QString("Intersecting pairs: %1").arg(n)
+                                   : QString("No intersecting shapes"));
+    });
+    QAction* highlightAction = overlapMenu->addAction("Highlight While Dragging");
+    highlightAction->setCheckable(true);
+    connect(highlightAction, &QAction::toggled, this,
+            [this](bool on) { controller->setOverlapHighlighting(on); });
+    QToolButton* overlapBtn = new QToolButton(this);
+    overlapBtn->setText("Overlaps");
+    overlapBtn->setMenu(overlapMenu);
+    overlapBtn->setPopupMode(QToolButton::InstantPopup);
+    toolBar->addWidget(overlapBtn);
+    toolBar->addSeparator();
+
+    // Место под шрифтовые виджеты — они создаются после первого кадра
+    fontAnchor = toolBar->addSeparator();
+
+    // Undo/Redo стрелками
+    QAction* undoAct = new QAction(style()->standardIcon(QStyle::SP_ArrowBack),  "", this);
+    QAction* redoAct = new QAction(style()->standardIcon(QStyle::SP_ArrowForward), "", this);
+    undoAct->setToolTip("Undo");
+    redoAct->setToolTip("Redo");
+    toolBar->addAction(undoAct);
+    toolBar->addAction(redoAct);
+
+    toolBar->setToolButtonStyle(Qt::ToolButtonIconOnly);
+
+    // Сигналы тулбара
+    connect(selectAction,  &QAction::triggered, this, &MainWindow::onSelectAction);
+    connect(lineAction,    &QAction::triggered, this, &MainWindow::onLineAction);
+    connect(rectAction,    &QAction::triggered, this, &MainWindow::onRectAction);
+    connect(ellipseAction, &QAction::triggered, this, &MainWindow::onEllipseAction);
+    connect(starAction,    &QAction::triggered, this, &MainWindow::onStarAction);
+    connect(curveAction,   &QAction::triggered, this, &MainWindow::onCurveAction);
+    connect(penAction,     &QAction::triggered, this, &MainWindow::onPenAction);
+    connect(textAction,    &QAction::triggered, this, &MainWindow::onTextAction);
+    connect(colorAction,   &QAction::triggered, this, &MainWindow::onColorAction);
+    connect(deleteAction,  &QAction::triggered, this, &MainWindow::onDeleteAction);
+    connect(clearAction,   &QAction::triggered, this, &MainWindow::onClearAction);
+    connect(copyAction,      &QAction::triggered, this, &MainWindow::onCopyAction);
+    connect(pasteAction,     &QAction::triggered, this, &MainWindow::onPasteAction);
+    connect(duplicateAction, &QAction::triggered, this, &MainWindow::onDuplicateAction);
+    connect(exportAction,    &QAction::triggered, this, &MainWindow::onExportAction);
+    connect(imageAction,     &QAction::triggered, this, &MainWindow::onImageAction);
+    connect(findAction,      &QAction::triggered, this, &MainWindow::onFindAction);
+    connect(frontAction,     &QAction::triggered, this, &MainWindow::onFrontAction);
+    connect(backAction,      &QAction::triggered, this, &MainWindow::onBackAction);
+    connect(toLayerAction,   &QAction::triggered, this, &MainWindow::onToLayerAction);
+    connect(undoAct,       &QAction::triggered, this, &MainWindow::onUndoAction);
+    connect(redoAct,       &QAction::triggered, this, &MainWindow::onRedoAction);
+}
+
+void MainWindow::setupDeferredUI() {
+    // Шрифтовые виджеты: список семейств заполнится при первом открытии
+    fontCombo    = new LazyFontComboBox(this);
     sizeCombo    = new QComboBox(this);
     boldBtn      = new QToolButton(this);
     italicBtn    = new QToolButton(this);
@@ -95,36 +276,70 @@ void MainWindow::setupToolBar() {
         underlineBtn->setFont(f);
     }
 
-    // Добавить в тулбар
-    toolBar->addWidget(fontCombo);
-    toolBar->addWidget(sizeCombo);
-    toolBar->addWidget(boldBtn);
-    toolBar->addWidget(italicBtn);
-    toolBar->addWidget(underlineBtn);
-    toolBar->addSeparator();
+    // Добавить в тулбар перед зарезервированным разделителем
+    toolBar->insertWidget(fontAnchor, fontCombo);
+    toolBar->insertWidget(fontAnchor, sizeCombo);
+    toolBar->insertWidget(fontAnchor, boldBtn);
+    toolBar->insertWidget(fontAnchor, italicBtn);
+    toolBar->insertWidget(fontAnchor, underlineBtn);
 
-    // Undo/Redo стрелками
-    QAction* undoAct = new QAction(style()->standardIcon(QStyle::SP_ArrowBack),  "", this);
-    QAction* redoAct = new QAction(style()->standardIcon(QStyle::SP_ArrowForward), "", this);
-    undoAct->setToolTip("Undo");
-    redoAct->setToolTip("Redo");
-    toolBar->addAction(undoAct);
-    toolBar->addAction(redoAct);
+    // Шрифтовые элементы
+    connect(fontCombo, &LazyFontComboBox::currentFontChanged,       this, &MainWindow::onFontChanged);
+    connect(sizeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onSizeChanged);
+    connect(boldBtn,      &QToolButton::toggled, this, &MainWindow::onBoldToggled);
+    connect(italicBtn,    &QToolButton::toggled, this, &MainWindow::onItalicToggled);
+    connect(underlineBtn, &QToolButton::toggled, this, &MainWindow::onUnderlineToggled);
+    fontCombo->populateAsync();
 
-    toolBar->setToolButtonStyle(Qt::ToolButtonIconOnly);
+    // Миникарта документа с рамкой видимой области
+    QDockWidget* overviewDock = new QDockWidget("Overview", this);
+    minimap = new MinimapView(model->getScene(), view, overviewDock);
+    overviewDock->setWidget(minimap);
+    // Зум меняет видимую область без движения полос прокрутки
+    connect(view, &EditorView::zoomChanged, minimap->viewport(), QOverload<>::of(&QWidget::update));
+    addDockWidget(Qt::RightDockWidgetArea, overviewDock);
 
-    // Сигналы тулбара
-    connect(selectAction,  &QAction::triggered, this, &MainWindow::onSelectAction);
-    connect(lineAction,    &QAction::triggered, this, &MainWindow::onLineAction);
-    connect(rectAction,    &QAction::triggered, this, &MainWindow::onRectAction);
-    connect(ellipseAction, &QAction::triggered, this, &MainWindow::onEllipseAction);
-    connect(starAction,    &QAction::triggered, this, &MainWindow::onStarAction);
-    connect(textAction,    &QAction::triggered, this, &MainWindow::onTextAction);
-    connect(colorAction,   &QAction::triggered, this, &MainWindow::onColorAction);
-    connect(deleteAction,  &QAction::triggered, this, &MainWindow::onDeleteAction);
-    connect(clearAction,   &QAction::triggered, this, &MainWindow::onClearAction);
-    connect(undoAct,       &QAction::triggered, this, &MainWindow::onUndoAction);
-    connect(redoAct,       &QAction::triggered, this, &MainWindow::onRedoAction);
+    // Слои документа
+    QDockWidget* layersDock = new QDockWidget("Layers", this);
+    layerPanel = new LayerPanel(model, layersDock);
+    layersDock->setWidget(layerPanel);
+    addDockWidget(Qt::RightDockWidgetArea, layersDock);
+
+    // Память документа: фигуры по типам, история Undo, заполненность пулов
+    memoryLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(memoryLabel);
+    QTimer* memoryTimer = new QTimer(this);
+    connect(memoryTimer, &QTimer::timeout, this, &MainWindow::updateMemoryStatus);
+    memoryTimer->start(500);
+    updateMemoryStatus();
+}
+
+void MainWindow::updateMemoryStatus() {
+    const MemoryUsage usage = MemoryUsage::current();
+    memoryLabel->setText(usage.summary());
+    QStringList details = usage.details();
+    details << QString("on scene: %1 of %2 shapes").arg(model->residentCount()).arg(model->shapeCount());
+    memoryLabel->setToolTip(details.join('\n'));
+}
+
+bool MainWindow::eventFilter(QObject* watched, QEvent* event) {
+    if (!firstPaintDone && event->type() == QEvent::Paint
+        && watched == view->viewport()) {
+        firstPaintDone = true;
+        view->viewport()->removeEventFilter(this);
+        // Сам кадр рисуется после фильтра — всё остальное откладываем за него
+        QTimer::singleShot(0, this, [this] {
+            if (startupClock.isValid())
+                qInfo("time-to-first-paint: %lld ms", startupClock.elapsed());
+            setupDeferredUI();
+        });
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::measureStartup(const QElapsedTimer& since) {
+    startupClock = since;
 }
 
 void MainWindow::setupConnections() {
@@ -134,44 +349,149 @@ void MainWindow::setupConnections() {
 
     // Сцена мыши
     auto sc = model->getScene();
+    // Щелчок куда угодно, и по фигуре тоже, фиксирует набираемый текст и
+    // останавливает просмотр анимации до правки, иначе кадры спорят с ней
+    connect(sc, &CustomGraphicsScene::sceneMousePressStarting, controller, [this] {
+        if (animation->isPlaying())
+            animation->pause();
+        controller->finishTextEditing(true);
+    });
+    // Правка мимо сцены (действия, Undo/Redo) тоже завершает просмотр; изменённое
+    // ею остановка не откатывает
+    connect(controller->undoStack(), &QUndoStack::indexChanged, animation, [this] {
+        if (animation->isPlaying())
+            animation->pause();
+    });
     connect(sc, &CustomGraphicsScene::sceneMousePressed,  this, &MainWindow::handleMousePressed);
     connect(sc, &CustomGraphicsScene::sceneMouseMoved,    this, &MainWindow::handleMouseMoved);
     connect(sc, &CustomGraphicsScene::sceneMouseReleased, this, &MainWindow::handleMouseReleased);
+    connect(sc, &CustomGraphicsScene::sceneMouseDoubleClicked, this, &MainWindow::handleMouseDoubleClicked);
+    connect(sc, &CustomGraphicsScene::sceneKeyPressed,    this, &MainWindow::handleKeyPressed);
+    connect(sc, &CustomGraphicsScene::shapeDragStarted,  this, &MainWindow::handleShapeDragStarted);
+    connect(sc, &CustomGraphicsScene::shapeDragged,      controller, &GraphicController::shapeDragged);
+    connect(sc, &CustomGraphicsScene::shapeDragFinished, this, &MainWindow::handleShapeDragFinished);
 
-    // Шрифтовые элементы
-    connect(fontCombo, &QFontComboBox::currentFontChanged,          this, &MainWindow::onFontChanged);
-    connect(sizeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
-            this, &MainWindow::onSizeChanged);
-    connect(boldBtn,      &QToolButton::toggled, this, &MainWindow::onBoldToggled);
-    connect(italicBtn,    &QToolButton::toggled, this, &MainWindow::onItalicToggled);
-    connect(underlineBtn, &QToolButton::toggled, this, &MainWindow::onUnderlineToggled);
+    // Одно уведомление на пачку изменений выделения
+    connect(model->getSelection(), &ShapeSelection::selectionChanged, this, [this] {
+        const int n = model->getSelection()->count();
+        statusBar()->showMessage(n ? QString("Selected: %1").arg(n) : QString());
+        // Выделение из поиска, панели слоёв и т.п. — мимо событий мыши
+        if (recorder) recorder->recordSelection(model->getSelection()->shapes());
+    });
+}
+
+void MainWindow::enableAutosave() {
+    // Автосохранение: снимок + журнал операций, восстанавливаем прошлую сессию
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+                        + "/autosave";
+    journal = new OperationJournal(dir, this);
+    journal->recover(model);
+    // Восстановленные изображения могут выходить за стартовую область сцены
+    QGraphicsScene* scene = model->getScene();
+    scene->setSceneRect(scene->sceneRect() | scene->itemsBoundingRect());
+    journal->attach(model, controller->undoStack());
+    controller->setJournal(journal);
+}
+
+void MainWindow::setSessionRecorder(SessionRecorder* r) {
+    recorder = r;
 }
 
-void MainWindow::onSelectAction()  { controller->setEditorMode(EditorMode::Select);    view->setDragMode(QGraphicsView::RubberBandDrag); }
-void MainWindow::onLineAction()    { controller->setEditorMode(EditorMode::CreateLine); view->setDragMode(QGraphicsView::NoDrag); }
-void MainWindow::onRectAction()    { controller->setEditorMode(EditorMode::CreateRect); view->setDragMode(QGraphicsView::NoDrag); }
-void MainWindow::onEllipseAction() { controller->setEditorMode(EditorMode::CreateEllipse); view->setDragMode(QGraphicsView::NoDrag); }
-void MainWindow::onStarAction()    { controller->setEditorMode(EditorMode::CreateStar); view->setDragMode(QGraphicsView::NoDrag); }
-void MainWindow::onTextAction()    { controller->setEditorMode(EditorMode::CreateText); view->setDragMode(QGraphicsView::NoDrag); }
+void MainWindow::setEditorMode(EditorMode mode) {
+    controller->setEditorMode(mode);
+    if (recorder) recorder->recordMode(mode);
+}
+
+void MainWindow::onSelectAction()  { setEditorMode(EditorMode::Select);        }
+void MainWindow::onLineAction()    { setEditorMode(EditorMode::CreateLine);    }
+void MainWindow::onRectAction()    { setEditorMode(EditorMode::CreateRect);    }
+void MainWindow::onEllipseAction() { setEditorMode(EditorMode::CreateEllipse); }
+void MainWindow::onStarAction()    { setEditorMode(EditorMode::CreateStar);    }
+void MainWindow::onCurveAction()   { setEditorMode(EditorMode::CreateCurve);   }
+void MainWindow::onPenAction()     { setEditorMode(EditorMode::CreatePen);     }
+void MainWindow::onTextAction()    { setEditorMode(EditorMode::CreateText);    }
 
 void MainWindow::onColorAction() {
     QColor c = QColorDialog::getColor(controller->getCurrentColor(), this, "Select Color");
     if (c.isValid()) {
         controller->setCurrentColor(c);
         controller->changeSelectedItemsColor(c);
+        if (recorder) recorder->recordColor(c);
     }
 }
 
-void MainWindow::onDeleteAction() { controller->deleteSelectedItems(); }
-void MainWindow::onClearAction()  { controller->clearAll();          }
-void MainWindow::onUndoAction()   { controller->undo();              }
-void MainWindow::onRedoAction()   { controller->redo();              }
+void MainWindow::onDeleteAction() { controller->deleteSelectedItems(); if (recorder) recorder->recordDelete(); }
+void MainWindow::onClearAction()  { controller->clearAll();            if (recorder) recorder->recordClear();  }
+void MainWindow::onUndoAction()   { controller->undo();                if (recorder) recorder->recordUndo();   }
+void MainWindow::onRedoAction()   { controller->redo();                if (recorder) recorder->recordRedo();   }
+void MainWindow::onCopyAction()      { controller->copySelection();      if (recorder) recorder->recordCopy();      }
+void MainWindow::onPasteAction()     { controller->paste();              if (recorder) recorder->recordPaste();     }
+void MainWindow::onDuplicateAction() { controller->duplicateSelection(); if (recorder) recorder->recordDuplicate(); }
+
+void MainWindow::onFrontAction() { controller->bringSelectionToFront(); if (recorder) recorder->recordBringToFront(); }
+void MainWindow::onBackAction()  { controller->sendSelectionToBack();   if (recorder) recorder->recordSendToBack();   }
+
+void MainWindow::onToLayerAction() {
+    controller->moveSelectionToLayer(model->getCurrentLayer());
+}
+
+void MainWindow::onFindAction() {
+    // Диалог создаётся при первом вызове и переиспользуется
+    if (!findDialog)
+        findDialog = new FindDialog(controller, model, this);
+    findDialog->show();
+    findDialog->raise();
+    findDialog->activateWindow();
+}
+
+void MainWindow::onImageAction() {
+    const QString path = QFileDialog::getOpenFileName(this, "Insert Image", QString(),
+                                                      "Images (*.png *.jpg *.jpeg *.tif *.tiff *.bmp)");
+    if (path.isEmpty())
+        return;
+    // Изображение ставится в центр видимой области
+    const QPointF center = view->mapToScene(view->viewport()->rect().center());
+    if (!controller->importImage(path, center))
+        QMessageBox::warning(this, "Insert Image", "Cannot read image: " + path);
+}
+
+void MainWindow::onExportAction() {
+    const QString path = QFileDialog::getSaveFileName(this, "Export", QString(),
+                                                      "SVG (*.svg);;PDF (*.pdf)");
+    if (path.isEmpty())
+        return;
+
+    // Экспорт идёт по снимку в фоне — документ можно править дальше
+    const DocumentSnapshot document = model->snapshot();
+    auto* watcher = new QFutureWatcher<ExportResult>(this);
+    connect(watcher, &QFutureWatcher<ExportResult>::finished, this, [this, watcher] {
+        const ExportResult r = watcher->result();
+        watcher->deleteLater();
+        if (!r.ok) {
+            QMessageBox::warning(this, "Export", "Cannot export: " + r.error);
+            return;
+        }
+        statusBar()->showMessage(QString("Exported %1 shapes, %2 styles, %3 fonts/glyphs, %4 KB")
+                                     .arg(r.stats.shapes).arg(r.stats.styles).arg(r.stats.fonts)
+                                     .arg((r.stats.bytes + 1023) / 1024), 5000);
+    });
+    statusBar()->showMessage(QString("Exporting %1 shapes...").arg(document.shapeCount()));
+    watcher->setFuture(QtConcurrent::run([document, path] {
+        VectorExporter exporter(document);
+        ExportResult r;
+        r.ok    = exporter.exportTo(path, VectorExporter::formatForPath(path));
+        r.error = exporter.errorString();
+        r.stats = exporter.stats();
+        return r;
+    }));
+}
 
 void MainWindow::onFontChanged(const QFont& font) {
     QFont f = controller->getCurrentFont();
     f.setFamily(font.family());
     controller->setCurrentFont(f);
     controller->changeSelectedItemsFont(f);
+    if (recorder) recorder->recordFont(f, true);
 }
 
 void MainWindow::onSizeChanged(int index) {
@@ -179,6 +499,7 @@ void MainWindow::onSizeChanged(int index) {
     QFont f = controller->getCurrentFont();
     f.setPointSize(size);
     controller->setCurrentFont(f);
+    if (recorder) recorder->recordFont(f, false);
 }
 
 void MainWindow::onBoldToggled(bool checked) {
@@ -186,6 +507,7 @@ void MainWindow::onBoldToggled(bool checked) {
     f.setBold(checked);
     controller->setCurrentFont(f);
     controller->changeSelectedItemsFont(f);
+    if (recorder) recorder->recordFont(f, true);
 }
 
 void MainWindow::onItalicToggled(bool checked) {
@@ -193,6 +515,7 @@ void MainWindow::onItalicToggled(bool checked) {
     f.setItalic(checked);
     controller->setCurrentFont(f);
     controller->changeSelectedItemsFont(f);
+    if (recorder) recorder->recordFont(f, true);
 }
 
 void MainWindow::onUnderlineToggled(bool checked) {
@@ -200,14 +523,62 @@ void MainWindow::onUnderlineToggled(bool checked) {
     f.setUnderline(checked);
     controller->setCurrentFont(f);
     controller->changeSelectedItemsFont(f);
+    if (recorder) recorder->recordFont(f, true);
+}
+
+void MainWindow::handleMousePressed(const QPointF& pos) {
+    if (recorder) {
+        // Щелчок мимо фигур сцена уже обработала — сняла выделение
+        recorder->recordSelection(model->getSelection()->shapes());
+        recorder->recordMousePressed(pos);
+    }
+    controller->mousePressed(pos);
+}
+
+void MainWindow::handleMouseMoved(const QPointF& pos) {
+    if (recorder) recorder->recordMouseMoved(pos);
+    controller->mouseMoved(pos);
+}
+
+void MainWindow::handleMouseReleased() {
+    if (recorder) recorder->recordMouseReleased();
+    controller->mouseReleased();
+}
+
+void MainWindow::handleShapeDragStarted(Shape* shape) {
+    // Уведомление о выделении отложено, а контроллеру выделение нужно уже сейчас
+    if (recorder) {
+        recorder->recordSelection(model->getSelection()->shapes());
+        recorder->recordShapeDragStarted(shape);
+    }
+    controller->shapeDragStarted(shape);
+}
+
+void MainWindow::handleShapeDragFinished(Shape* shape) {
+    if (recorder) recorder->recordShapeDragFinished(shape);
+    controller->shapeDragFinished(shape);
+    // Щелчок с Ctrl переключает выделение при отпускании
+    if (recorder) recorder->recordSelection(model->getSelection()->shapes());
 }
 
-void MainWindow::handleMousePressed(const QPointF& pos)  { controller->mousePressed(pos);  }
-void MainWindow::handleMouseMoved  (const QPointF& pos)  { controller->mouseMoved(pos);    }
-void MainWindow::handleMouseReleased()                  { controller->mouseReleased();    }
+void MainWindow::handleMouseDoubleClicked(const QPointF& pos) {
+    if (controller->editTextAt(pos) && recorder)
+        recorder->recordDoubleClick(pos);
+}
+
+void MainWindow::handleKeyPressed(QKeyEvent* event) {
+    // Клавиши забирает только ввод текста; остальное идёт сцене и окну как обычно
+    if (!controller->isEditingText())
+        return;
+    if (recorder) recorder->recordKey(event->key(), event->text());
+    if (controller->textKeyPressed(event->key(), event->text()))
+        event->accept();
+}
 
 void MainWindow::keyPressEvent(QKeyEvent* event) {
-    if (event->key() == Qt::Key_Delete)
+    if (event->key() == Qt::Key_Delete) {
         controller->deleteSelectedItems();
+        if (recorder) recorder->recordDelete();
+    }
     QMainWindow::keyPressEvent(event);
 }
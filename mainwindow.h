@@ -5,12 +5,21 @@
 #include <QMainWindow>
 #include <QGraphicsView>
 #include <QToolBar>
-#include <QFontComboBox>
+#include <QElapsedTimer>
 #include <QComboBox>
 #include <QToolButton>
 #include <QKeyEvent>
+#include <QLabel>
 #include "graphicmodel.h"
 #include "graphiccontroller.h"
+#include "operationjournal.h"
+#include "sessionrecorder.h"
+#include "minimapview.h"
+#include "lazyfontcombobox.h"
+#include "layerpanel.h"
+#include "editorview.h"
+#include "finddialog.h"
+#include "animationengine.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -18,8 +27,18 @@ public:
     explicit MainWindow(QWidget* parent = nullptr);
     ~MainWindow() override;
 
+    // Восстановить прошлую сессию и включить журнал автосохранения
+    void enableAutosave();
+
+    // Записывать ввод пользователя (для проигрывания через --replay)
+    void setSessionRecorder(SessionRecorder* recorder);
+
+    // Отсчёт от старта процесса (--measure-startup): по первому кадру печатается time-to-first-paint
+    void measureStartup(const QElapsedTimer& since);
+
 protected:
     void keyPressEvent(QKeyEvent* event) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
 
 private slots:
     void onSelectAction();
@@ -27,12 +46,23 @@ private slots:
     void onRectAction();
     void onEllipseAction();
     void onStarAction();
+    void onCurveAction();
+    void onPenAction();
     void onTextAction();
     void onColorAction();
     void onDeleteAction();
     void onClearAction();
     void onUndoAction();
     void onRedoAction();
+    void onCopyAction();
+    void onPasteAction();
+    void onDuplicateAction();
+    void onExportAction();
+    void onImageAction();
+    void onFrontAction();
+    void onBackAction();
+    void onToLayerAction();
+    void onFindAction();
 
     void onFontChanged(const QFont& font);
     void onSizeChanged(int index);
@@ -43,23 +73,42 @@ private slots:
     void handleMousePressed (const QPointF& pos);
     void handleMouseMoved   (const QPointF& pos);
     void handleMouseReleased();
+    void handleMouseDoubleClicked(const QPointF& pos);
+    void handleKeyPressed(QKeyEvent* event);
+    void handleShapeDragStarted (Shape* shape);
+    void handleShapeDragFinished(Shape* shape);
+
+    void updateMemoryStatus();
 
 private:
     void setupUI();
     void setupToolBar();
     void setupConnections();
+    void setupDeferredUI();
+    void setEditorMode(EditorMode mode);
 
-    QGraphicsView* view;
+    EditorView*    view;
     QToolBar*      toolBar;
+    MinimapView*   minimap;
+    LayerPanel*    layerPanel;
+    FindDialog*    findDialog;
 
-    QFontComboBox* fontCombo;
+    LazyFontComboBox* fontCombo;
     QComboBox*     sizeCombo;
     QToolButton*   boldBtn;
     QToolButton*   italicBtn;
     QToolButton*   underlineBtn;
+    QAction*       fontAnchor;
+    QLabel*        memoryLabel;
+
+    QElapsedTimer  startupClock;
+    bool           firstPaintDone;
 
     GraphicModel*      model;
     GraphicController* controller;
+    OperationJournal*  journal;
+    SessionRecorder*   recorder;
+    AnimationEngine*   animation;
 };
 
 #endif // MAINWINDOW_H
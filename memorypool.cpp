@@ -0,0 +1,222 @@
+// memorypool.cpp
+#include "memorypool.h"
+#include "tilepyramid.h"
+#include <QMutexLocker>
+#include <new>
+
+namespace {
+
+const std::size_t kAlign      = 16;
+const std::size_t kHeader     = 16;          // указатель на слэб перед каждым блоком
+const std::size_t kSlabBytes  = 64 * 1024;
+const std::size_t kMaxPooled  = 1024;        // крупнее — напрямую у системы
+
+QString kilobytes(qint64 bytes) {
+    return QString::number((bytes + 1023) / 1024) + " KB";
+}
+
+} // namespace
+
+struct MemoryPool::Slab {
+    char* memory       = nullptr;
+    void* freeList     = nullptr;
+    int   live         = 0;
+    int   capacity     = 0;
+    int   classIndex   = 0;
+    int   slabIndex    = -1;
+    int   partialIndex = -1;
+    std::size_t bytes  = 0;
+};
+
+MemoryPool::MemoryPool(const char* name)
+    : poolName(name)
+{ }
+
+MemoryPool::~MemoryPool() {
+    for (SizeClass& cls : classes)
+        for (Slab* s : cls.slabs) {
+            ::operator delete(s->memory);
+            delete s;
+        }
+}
+
+MemoryPool::Slab* MemoryPool::newSlab(SizeClass& cls) {
+    const std::size_t stride = kHeader + cls.blockSize;
+
+    Slab* s = new Slab;
+    s->capacity   = int(qMax<std::size_t>(1, kSlabBytes / stride));
+    s->bytes      = std::size_t(s->capacity) * stride;
+    s->memory     = static_cast<char*>(::operator new(s->bytes));
+    s->classIndex = int(cls.blockSize / kAlign) - 1;
+
+    for (int i = s->capacity - 1; i >= 0; --i) {
+        char* block = s->memory + std::size_t(i) * stride;
+        *reinterpret_cast<Slab**>(block) = s;
+        void* obj = block + kHeader;
+        *static_cast<void**>(obj) = s->freeList;
+        s->freeList = obj;
+    }
+
+    s->slabIndex = cls.slabs.size();
+    cls.slabs.append(s);
+    s->partialIndex = cls.partial.size();
+    cls.partial.append(s);
+
+    ++counters.slabs;
+    counters.bytesReserved += qint64(s->bytes);
+    return s;
+}
+
+void MemoryPool::releaseSlab(SizeClass& cls, Slab* s) {
+    if (s->partialIndex >= 0) {
+        Slab* last = cls.partial.last();
+        cls.partial[s->partialIndex] = last;
+        last->partialIndex = s->partialIndex;
+        cls.partial.removeLast();
+    }
+    Slab* last = cls.slabs.last();
+    cls.slabs[s->slabIndex] = last;
+    last->slabIndex = s->slabIndex;
+    cls.slabs.removeLast();
+
+    --counters.slabs;
+    counters.bytesReserved -= qint64(s->bytes);
+    ::operator delete(s->memory);
+    delete s;
+}
+
+void* MemoryPool::allocate(std::size_t size) {
+    QMutexLocker lock(&mutex);
+    ++counters.liveObjects;
+    counters.bytesInUse += qint64(size);
+
+    if (size == 0 || size > kMaxPooled) {
+        counters.bytesReserved += qint64(size);
+        return ::operator new(size);
+    }
+
+    const int ci = int((size + kAlign - 1) / kAlign) - 1;
+    if (classes.size() <= ci) {
+        const int from = classes.size();
+        classes.resize(ci + 1);
+        for (int i = from; i <= ci; ++i)
+            classes[i].blockSize = std::size_t(i + 1) * kAlign;
+    }
+    SizeClass& cls = classes[ci];
+
+    Slab* s = cls.partial.isEmpty() ? newSlab(cls) : cls.partial.last();
+    void* obj   = s->freeList;
+    s->freeList = *static_cast<void**>(obj);
+    ++s->live;
+    if (!s->freeList) {
+        // Слэб заполнен — он всегда последний в partial
+        cls.partial.removeLast();
+        s->partialIndex = -1;
+    }
+    return obj;
+}
+
+void MemoryPool::deallocate(void* p, std::size_t size) {
+    if (!p)
+        return;
+    QMutexLocker lock(&mutex);
+    --counters.liveObjects;
+    counters.bytesInUse -= qint64(size);
+
+    if (size == 0 || size > kMaxPooled) {
+        counters.bytesReserved -= qint64(size);
+        ::operator delete(p);
+        return;
+    }
+
+    Slab* s = *reinterpret_cast<Slab**>(static_cast<char*>(p) - kHeader);
+    SizeClass& cls = classes[s->classIndex];
+    *static_cast<void**>(p) = s->freeList;
+    s->freeList = p;
+    --s->live;
+    if (s->partialIndex < 0) {
+        s->partialIndex = cls.partial.size();
+        cls.partial.append(s);
+    }
+}
+
+void MemoryPool::trim() {
+    QMutexLocker lock(&mutex);
+    for (SizeClass& cls : classes)
+        for (int i = cls.slabs.size() - 1; i >= 0; --i)
+            if (cls.slabs.at(i)->live == 0)
+                releaseSlab(cls, cls.slabs.at(i));
+}
+
+MemoryPool::Stats MemoryPool::stats() const {
+    QMutexLocker lock(&mutex);
+    return counters;
+}
+
+MemoryPool& shapeMemoryPool() {
+    static MemoryPool pool("shapes");
+    return pool;
+}
+
+MemoryPool& commandMemoryPool() {
+    static MemoryPool pool("undo");
+    return pool;
+}
+
+// ---------------- MemoryUsage ----------------
+
+MemoryUsage MemoryUsage::current() {
+    MemoryUsage u;
+    for (int i = 0; i < kShapeTypeCount; ++i) {
+        u.shapeCount[i] = Shape::liveCount(ShapeType(i));
+        u.shapeBytes[i] = Shape::liveBytes(ShapeType(i));
+    }
+    u.shapePool   = shapeMemoryPool().stats();
+    u.commandPool = commandMemoryPool().stats();
+    u.imageTiles     = TilePyramid::cachedTiles();
+    u.imageTileBytes = TilePyramid::cachedBytes();
+    return u;
+}
+
+qint64 MemoryUsage::totalShapeBytes() const {
+    qint64 total = 0;
+    for (qint64 b : shapeBytes)
+        total += b;
+    return total;
+}
+
+QString MemoryUsage::summary() const {
+    int shapes = 0;
+    for (int n : shapeCount)
+        shapes += n;
+    return QString("Shapes: %1 (%2) | Undo: %3 | Pool: %4, %5% unused")
+        .arg(shapes)
+        .arg(kilobytes(totalShapeBytes()))
+        .arg(kilobytes(undoBytes()))
+        .arg(kilobytes(shapePool.bytesReserved + commandPool.bytesReserved))
+        .arg(qRound(shapePool.fragmentation() * 100));
+}
+
+QStringList MemoryUsage::details() const {
+    QStringList lines;
+    for (int i = 0; i < kShapeTypeCount; ++i)
+        lines << QString("%1: %2 shapes, %3")
+                     .arg(shapeTypeName(ShapeType(i)))
+                     .arg(shapeCount[i])
+                     .arg(kilobytes(shapeBytes[i]));
+    lines << QString("undo history: %1 commands, %2")
+                 .arg(commandPool.liveObjects)
+                 .arg(kilobytes(undoBytes()));
+    lines << QString("shape pool: %1 slabs, %2 reserved, %3% unused")
+                 .arg(shapePool.slabs)
+                 .arg(kilobytes(shapePool.bytesReserved))
+                 .arg(qRound(shapePool.fragmentation() * 100));
+    lines << QString("command pool: %1 slabs, %2 reserved, %3% unused")
+                 .arg(commandPool.slabs)
+                 .arg(kilobytes(commandPool.bytesReserved))
+                 .arg(qRound(commandPool.fragmentation() * 100));
+    lines << QString("image tiles: %1 mapped, %2")
+                 .arg(imageTiles)
+                 .arg(kilobytes(imageTileBytes));
+    return lines;
+}
@@ -0,0 +1,78 @@
+// memorypool.h
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <cstddef>
+#include "shape.h"
+
+// Пул для множества однотипных объектов (фигуры, команды Undo).
+// Память берётся слэбами по 64 КБ, внутри слэба — блоки одного размерного класса
+// со своим списком свободных. Пустые слэбы отдаются системе через trim().
+class MemoryPool {
+public:
+    struct Stats {
+        qint64 liveObjects   = 0;
+        qint64 bytesInUse    = 0;  // запрошено живыми объектами
+        qint64 bytesReserved = 0;  // взято у системы
+        qint64 slabs         = 0;
+
+        // Доля зарезервированной памяти, не занятой объектами
+        double fragmentation() const {
+            return bytesReserved ? 1.0 - double(bytesInUse) / double(bytesReserved) : 0.0;
+        }
+    };
+
+    explicit MemoryPool(const char* name);
+    ~MemoryPool();
+
+    void* allocate(std::size_t size);
+    void  deallocate(void* p, std::size_t size);
+
+    // Вернуть системе полностью свободные слэбы
+    void  trim();
+
+    Stats       stats() const;
+    const char* name() const { return poolName; }
+
+private:
+    struct Slab;
+    struct SizeClass {
+        std::size_t     blockSize = 0;
+        QVector<Slab*>  slabs;
+        QVector<Slab*>  partial;   // слэбы, где есть свободные блоки
+    };
+
+    Slab* newSlab(SizeClass& cls);
+    void  releaseSlab(SizeClass& cls, Slab* slab);
+
+    mutable QMutex     mutex;
+    const char*        poolName;
+    QVector<SizeClass> classes;
+    Stats              counters;
+};
+
+MemoryPool& shapeMemoryPool();
+MemoryPool& commandMemoryPool();
+
+// Сводка по памяти документа для статус-бара и отчёта --replay
+struct MemoryUsage {
+    int    shapeCount[kShapeTypeCount] = {};
+    qint64 shapeBytes[kShapeTypeCount] = {};
+    MemoryPool::Stats shapePool;
+    MemoryPool::Stats commandPool;
+    int    imageTiles     = 0;   // плитки изображений, отображённые в память (tilepyramid.h)
+    qint64 imageTileBytes = 0;
+
+    static MemoryUsage current();
+
+    qint64      totalShapeBytes() const;
+    qint64      undoBytes() const { return commandPool.bytesInUse; }
+    QString     summary() const;
+    QStringList details() const;
+};
+
+#endif // MEMORYPOOL_H
@@ -0,0 +1,213 @@
+// minimapview.cpp
+#include "minimapview.h"
+#include "graphicmodel.h"
+#include <QGuiApplication>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtConcurrent/QtConcurrent>
+
+namespace {
+
+const int kCacheSize          = 512;  // длинная сторона растра, px
+const int kIdleIntervalMs     = 50;
+const int kDragIntervalMs     = 250;  // пока тянут мышью, обновляемся реже
+
+MinimapPatch renderPatch(const QVector<MinimapItem>& items,
+                         const QRect& pixels,
+                         const QRectF& sceneRect,
+                         qreal scale)
+{
+    MinimapPatch patch;
+    patch.at    = pixels.topLeft();
+    patch.image = QImage(pixels.size(), QImage::Format_ARGB32_Premultiplied);
+    patch.image.fill(Qt::white);
+
+    QPainter p(&patch.image);
+    p.translate(-pixels.topLeft());
+    p.scale(scale, scale);
+    p.translate(-sceneRect.topLeft());
+
+    for (const MinimapItem& it : items) {
+        p.setPen(QPen(it.color, 0));
+        p.setBrush(Qt::NoBrush);
+        switch (it.type) {
+        case ShapeType::Line:      p.drawLine(it.line);                          break;
+        case ShapeType::Rectangle: p.drawRect(it.rect);                          break;
+        case ShapeType::Ellipse:   p.drawEllipse(it.rect);                       break;
+        case ShapeType::Star:      p.drawPolygon(Shape::starPolygon(it.rect));   break;
+        case ShapeType::Text:      p.fillRect(it.rect, it.color);                break; // при таком масштабе текст — просто полоса
+        case ShapeType::Image:     p.drawRect(it.rect);                          break; // растр на миникарте не декодируется
+        case ShapeType::Path:      p.drawPolyline(it.polyline);                  break;
+        }
+    }
+    return patch;
+}
+
+} // namespace
+
+MinimapView::MinimapView(CustomGraphicsScene* source,
+                         QGraphicsView* mainView,
+                         QWidget* parent)
+    : QGraphicsView(parent)
+    , source(source)
+    , mainView(mainView)
+    , cacheScale(1.0)
+{
+    setScene(&overview);
+    setInteractive(false);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setRenderHint(QPainter::SmoothPixmapTransform);
+    setMinimumSize(160, 160);
+
+    throttle.setSingleShot(true);
+    connect(&throttle, &QTimer::timeout, this, &MinimapView::startRender);
+    connect(&watcher, &QFutureWatcher<MinimapPatch>::finished,
+            this, &MinimapView::onRenderFinished);
+    connect(source, &QGraphicsScene::changed, this, &MinimapView::onSceneChanged);
+    connect(source, &QGraphicsScene::sceneRectChanged, this, &MinimapView::onSceneRectChanged);
+
+    // Рамка видимой области следует за прокруткой основного вида
+    connect(mainView->horizontalScrollBar(), &QScrollBar::valueChanged,
+            viewport(), QOverload<>::of(&QWidget::update));
+    connect(mainView->verticalScrollBar(), &QScrollBar::valueChanged,
+            viewport(), QOverload<>::of(&QWidget::update));
+
+    resetCache(source->sceneRect());
+}
+
+void MinimapView::resetCache(const QRectF& sceneRect) {
+    const QImage old = cache;
+    const QRectF oldRect = cacheSceneRect;
+
+    cacheSceneRect = sceneRect;
+    cacheScale     = kCacheSize / qMax<qreal>(1, qMax(sceneRect.width(), sceneRect.height()));
+    cache = QImage((cacheSceneRect.size() * cacheScale).toSize(),
+                   QImage::Format_ARGB32_Premultiplied);
+    cache.fill(Qt::white);
+    if (!old.isNull()) {
+        QPainter p(&cache);
+        p.scale(cacheScale, cacheScale);
+        p.translate(-cacheSceneRect.topLeft());
+        p.drawImage(oldRect, old);
+    }
+
+    overview.setSceneRect(cacheSceneRect);
+    fitInView(cacheSceneRect, Qt::KeepAspectRatio);
+    dirty = QRectF();
+    markDirty(cacheSceneRect);
+}
+
+void MinimapView::onSceneRectChanged(const QRectF& rect) {
+    if (rect != cacheSceneRect)
+        resetCache(rect);
+}
+
+void MinimapView::onSceneChanged(const QList<QRectF>& region) {
+    for (const QRectF& r : region)
+        markDirty(r);
+}
+
+void MinimapView::markDirty(const QRectF& rect) {
+    dirty = dirty.united(rect.intersected(cacheSceneRect));
+    scheduleRender();
+}
+
+void MinimapView::scheduleRender() {
+    if (dirty.isEmpty() || watcher.isRunning() || throttle.isActive())
+        return;
+    const bool dragging = QGuiApplication::mouseButtons() != Qt::NoButton;
+    throttle.start(dragging ? kDragIntervalMs : kIdleIntervalMs);
+}
+
+void MinimapView::startRender() {
+    if (dirty.isEmpty() || watcher.isRunning())
+        return;
+
+    // Область в пикселях кэша, выровненная по целым, и её точный прообраз на сцене
+    const QRect pixels = QRectF((dirty.topLeft() - cacheSceneRect.topLeft()) * cacheScale,
+                                dirty.size() * cacheScale)
+                             .toAlignedRect()
+                             .intersected(cache.rect());
+    dirty = QRectF();
+    if (pixels.isEmpty())
+        return;
+
+    const QRectF patchScene(cacheSceneRect.topLeft() + QPointF(pixels.topLeft()) / cacheScale,
+                            QSizeF(pixels.size()) / cacheScale);
+    renderSceneRect = cacheSceneRect;
+
+    // Данные фигур снимаем в GUI-потоке, растеризуем — в пуле потоков.
+    // Фигуры берутся из сетки модели: при виртуализации на сцене только область у вида
+    GraphicModel* model = source->getModel();
+    if (!model)
+        return;
+    QVector<MinimapItem> items;
+    const QList<Shape*> hits = model->shapesIn(patchScene);
+    items.reserve(hits.size());
+    for (const Shape* s : hits) {
+        if (!s->isVisible())
+            continue;
+        MinimapItem mi;
+        mi.type  = s->getType();
+        mi.rect  = s->sceneBoundingRect();
+        mi.line  = QLineF(s->mapToScene(s->getStartPos()), s->mapToScene(s->getEndPos()));
+        mi.color = s->getColor();
+        if (mi.type == ShapeType::Path)
+            mi.polyline = s->getFlattened(cacheScale).translated(s->scenePos());
+        items.append(mi);
+    }
+
+    watcher.setFuture(QtConcurrent::run(renderPatch, items, pixels,
+                                        cacheSceneRect, cacheScale));
+}
+
+void MinimapView::onRenderFinished() {
+    const MinimapPatch patch = watcher.result();
+    // Пока фрагмент считался, область сцены сменилась: он посчитан под старый
+    // масштаб, а новая область уже помечена к перерисовке целиком
+    if (renderSceneRect != cacheSceneRect) {
+        scheduleRender();
+        return;
+    }
+    {
+        QPainter p(&cache);
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.drawImage(patch.at, patch.image);
+    }
+    viewport()->update();
+    scheduleRender();
+}
+
+void MinimapView::drawBackground(QPainter* painter, const QRectF& /*rect*/) {
+    painter->drawImage(cacheSceneRect, cache);
+}
+
+void MinimapView::drawForeground(QPainter* painter, const QRectF& /*rect*/) {
+    const QRectF visible =
+        mainView->mapToScene(mainView->viewport()->rect()).boundingRect();
+    painter->setPen(QPen(Qt::red, 0));
+    painter->setBrush(QColor(255, 0, 0, 30));
+    painter->drawRect(visible.intersected(cacheSceneRect));
+}
+
+void MinimapView::centerMainView(const QPoint& viewPos) {
+    mainView->centerOn(mapToScene(viewPos));
+    viewport()->update();
+}
+
+void MinimapView::mousePressEvent(QMouseEvent* e) {
+    if (e->button() == Qt::LeftButton)
+        centerMainView(e->pos());
+}
+
+void MinimapView::mouseMoveEvent(QMouseEvent* e) {
+    if (e->buttons() & Qt::LeftButton)
+        centerMainView(e->pos());
+}
+
+void MinimapView::resizeEvent(QResizeEvent* e) {
+    QGraphicsView::resizeEvent(e);
+    fitInView(cacheSceneRect, Qt::KeepAspectRatio);
+}
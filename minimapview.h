@@ -0,0 +1,72 @@
+// minimapview.h
+#ifndef MINIMAPVIEW_H
+#define MINIMAPVIEW_H
+
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QTimer>
+#include "customgraphicsscene.h"
+#include "shape.h"
+
+// Упрощённое описание фигуры для растеризации вне GUI-потока
+struct MinimapItem {
+    ShapeType type;
+    QRectF    rect;    // в координатах сцены
+    QLineF    line;
+    QPolygonF polyline;   // у пути: грубая ломаная под масштаб миникарты
+    QColor    color;
+};
+
+// Готовый фрагмент растра миникарты
+struct MinimapPatch {
+    QImage image;
+    QPoint at;
+};
+
+// Обзорная карта документа: рисует не сами фигуры, а кэшированный растр сцены
+// низкого разрешения, который дорисовывается по изменённым областям в фоне
+class MinimapView : public QGraphicsView {
+    Q_OBJECT
+public:
+    MinimapView(CustomGraphicsScene* source,
+                QGraphicsView* mainView,
+                QWidget* parent = nullptr);
+
+protected:
+    void drawBackground(QPainter* painter, const QRectF& rect) override;
+    void drawForeground(QPainter* painter, const QRectF& rect) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent (QMouseEvent* event) override;
+    void resizeEvent    (QResizeEvent* event) override;
+
+private slots:
+    void onSceneChanged(const QList<QRectF>& region);
+    void onSceneRectChanged(const QRectF& rect);
+    void startRender();
+    void onRenderFinished();
+
+private:
+    // Кэш под новую область сцены: старый растр растягивается как заготовка,
+    // затем вся область перерисовывается
+    void resetCache(const QRectF& sceneRect);
+    void markDirty(const QRectF& rect);
+    void scheduleRender();
+    void centerMainView(const QPoint& viewPos);
+
+    CustomGraphicsScene* source;
+    QGraphicsView*       mainView;
+    QGraphicsScene       overview;
+
+    QImage               cache;
+    QRectF               cacheSceneRect;
+    qreal                cacheScale;
+
+    QRectF               dirty;
+    QRectF               renderSceneRect;   // область кэша, под которую считается фрагмент
+    QTimer               throttle;
+    QFutureWatcher<MinimapPatch> watcher;
+};
+
+#endif // MINIMAPVIEW_H
@@ -0,0 +1,473 @@
+// operationjournal.cpp
+#include "operationjournal.h"
+#include "graphicmodel.h"
+#include <QDir>
+#include <QHash>
+#include <QSaveFile>
+#include <QUndoStack>
+#include <QVector>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const quint32 kSnapshotMagic   = 0x47454a53; // "GEJS"
+const quint32 kSnapshotVersion = 2;   // 2: слои и ключи z фигур
+const int     kStreamVersion   = QDataStream::Qt_5_15;
+const int     kFlushIntervalMs = 1000;
+const int     kRecordHeader    = sizeof(quint32) + sizeof(quint16);
+// Сжимать журнал, когда он перерос снимок (но не чаще, чем раз в 256 КБ правок):
+// так стоимость записи снимка амортизируется объёмом правок
+const qint64  kMinCompactBytes = 256 * 1024;
+
+// CRC покрывает и длину: испорченная длина иначе сдвинула бы разбор всех следующих записей
+quint16 recordChecksum(quint32 length, const QByteArray& payload) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << length;
+    data.append(payload);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return qChecksum(QByteArrayView(data));
+#else
+    return qChecksum(data.constData(), uint(data.size()));
+#endif
+}
+
+void syncFile(QFile& file) {
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+
+// Выполняется в потоке записи: снимок документа неизменяем
+QByteArray serializeDocument(const DocumentSnapshot& document, quint64 lastSeq) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+
+    out << kSnapshotMagic << kSnapshotVersion << lastSeq << quint32(document.layerCount());
+    for (int i = 0; i < document.layerCount(); ++i) {
+        const LayerSnapshot& layer = document.layer(i);
+        out << layer.name << layer.visible << layer.locked << quint32(layer.shapes.size());
+        for (const SnapshotShape& s : layer.shapes) {
+            out << s.id << quint8(s.shape().type) << s.zKey;
+            Shape::writeState(out, s.shape(), s.pos);
+        }
+    }
+    return data;
+}
+
+// Слой по позиции; слоёв, созданных после снимка, журнал не знает — они заводятся заново
+Layer* layerAt(GraphicModel* model, int position) {
+    while (model->getLayers().size() <= position)
+        model->addLayer(QString("Layer %1").arg(model->getLayers().size() + 1));
+    return model->getLayers().at(position);
+}
+
+} // namespace
+
+// ---------------- JournalWriter ----------------
+
+JournalWriter::JournalWriter(const QString& journalPath,
+                             const QString& snapshotPath,
+                             QObject* parent)
+    : QObject(parent)
+    , journalFile(journalPath)
+    , snapshotPath(snapshotPath)
+{ }
+
+bool JournalWriter::ensureOpen() {
+    if (journalFile.isOpen())
+        return true;
+    return journalFile.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void JournalWriter::append(const QByteArray& records) {
+    if (records.isEmpty() || !ensureOpen())
+        return;
+    journalFile.write(records);
+    syncFile(journalFile);
+}
+
+void JournalWriter::writeSnapshot(const QByteArray& snapshot) {
+    QSaveFile file(snapshotPath);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    file.write(snapshot);
+    if (!file.commit())
+        return;
+
+    // Все записи журнала уже учтены в снимке
+    if (ensureOpen()) {
+        journalFile.flush();
+        journalFile.resize(0);
+        syncFile(journalFile);
+    }
+}
+
+void JournalWriter::close() {
+    if (journalFile.isOpen()) {
+        syncFile(journalFile);
+        journalFile.close();
+    }
+}
+
+// ---------------- OperationJournal ----------------
+
+OperationJournal::OperationJournal(const QString& directory, QObject* parent)
+    : QObject(parent)
+    , journalPath(directory + "/document.journal")
+    , snapshotPath(directory + "/document.snapshot")
+    , writer(nullptr)
+    , model(nullptr)
+    , stack(nullptr)
+    , lastIndex(0)
+    , nextSeq(1)
+    , journalBytes(0)
+    , snapshotBytes(0)
+{
+    QDir().mkpath(directory);
+
+    writer = new JournalWriter(journalPath, snapshotPath);
+    writer->moveToThread(&writerThread);
+    connect(&writerThread, &QThread::finished, writer, &QObject::deleteLater);
+    writerThread.start(QThread::LowPriority);
+
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(kFlushIntervalMs);
+    connect(&flushTimer, &QTimer::timeout, this, &OperationJournal::flush);
+}
+
+OperationJournal::~OperationJournal() {
+    flushTimer.stop();
+
+    // Дописать хвост синхронно: после quit() очередь потока уже не разбирается
+    JournalWriter* w = writer;
+    const QByteArray rest = pending;
+    QMetaObject::invokeMethod(w, [w, rest] {
+        w->append(rest);
+        w->close();
+    }, Qt::BlockingQueuedConnection);
+
+    writerThread.quit();
+    writerThread.wait();
+}
+
+void OperationJournal::attach(GraphicModel* m, QUndoStack* s) {
+    model     = m;
+    stack     = s;
+    lastIndex = s->index();
+    connect(stack, &QUndoStack::indexChanged, this, &OperationJournal::onIndexChanged);
+}
+
+void OperationJournal::onIndexChanged(int index) {
+    if (index > lastIndex) {
+        for (int i = lastIndex; i < index; ++i)
+            if (auto* c = dynamic_cast<const JournaledCommand*>(stack->command(i)))
+                c->journalRedo(this);
+    } else {
+        for (int i = lastIndex - 1; i >= index; --i)
+            if (auto* c = dynamic_cast<const JournaledCommand*>(stack->command(i)))
+                c->journalUndo(this);
+    }
+    lastIndex = index;
+}
+
+// ---- запись ----
+
+void OperationJournal::recordAdd(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Add) << s->getId() << quint8(s->getType());
+    s->writeState(out);
+    commitRecord(payload);    // Возврат удалённой фигуры (Undo) — в её прежний слой и на прежнее место
+    recordPlace(s);
+}
+
+void OperationJournal::recordRemove(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Remove) << s->getId();
+    commitRecord(payload);
+}
+
+void OperationJournal::recordMove(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Move) << s->getId() << s->pos();
+    commitRecord(payload);
+}
+
+void OperationJournal::recordColor(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Color) << s->getId() << s->getColor();
+    commitRecord(payload);
+}
+
+void OperationJournal::recordUpdate(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Update) << s->getId();
+    s->writeState(out);
+    commitRecord(payload);
+}
+
+void OperationJournal::recordClear() {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Clear) << quint64(0);
+    commitRecord(payload);
+}
+
+void OperationJournal::recordPlace(const Shape* s) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << nextSeq++ << quint8(Op::Place) << s->getId()
+        << qint32(s->getLayer() ? s->getLayer()->getPosition() : 0) << s->getZKey();
+    commitRecord(payload);
+}
+
+void OperationJournal::commitRecord(const QByteArray& payload) {
+    const quint32 length = quint32(payload.size());
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out << length << recordChecksum(length, payload);
+
+    pending.append(header);
+    pending.append(payload);
+    journalBytes += header.size() + payload.size();
+
+    if (!flushTimer.isActive())
+        flushTimer.start();
+}
+
+void OperationJournal::flush() {
+    if (!pending.isEmpty()) {
+        JournalWriter* w = writer;
+        const QByteArray batch = pending;
+        pending.clear();
+        QMetaObject::invokeMethod(w, [w, batch] { w->append(batch); }, Qt::QueuedConnection);
+    }
+
+    if (model && journalBytes > qMax(kMinCompactBytes, snapshotBytes))
+        compact();
+}
+
+void OperationJournal::checkpoint() {
+    if (!model)
+        return;
+    // Сначала отправить накопленное, чтобы записи легли в журнал раньше снимка
+    flush();
+    compact();
+}
+
+void OperationJournal::compact() {
+    // GUI-поток только берёт снимок; сериализация и запись — в потоке записи
+    const DocumentSnapshot document = model->snapshot();
+    const quint64 lastSeq = nextSeq - 1;
+    journalBytes = 0;
+
+    JournalWriter* w = writer;
+    QMetaObject::invokeMethod(w, [this, w, document, lastSeq] {
+        const QByteArray snapshot = serializeDocument(document, lastSeq);
+        w->writeSnapshot(snapshot);
+        const qint64 bytes = snapshot.size();
+        QMetaObject::invokeMethod(this, [this, bytes] { snapshotBytes = bytes; },
+                                  Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+// ---- восстановление ----
+
+bool OperationJournal::recover(GraphicModel* m) {
+    quint64 snapshotSeq = 0;
+    const bool fromSnapshot = loadSnapshot(m, &snapshotSeq);
+    const bool fromJournal  = replayJournal(m, snapshotSeq);
+    nextSeq = qMax(nextSeq, snapshotSeq + 1);
+    return fromSnapshot || fromJournal;
+}
+
+bool OperationJournal::loadSnapshot(GraphicModel* m, quint64* snapshotSeq) {
+    QFile file(snapshotPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(kStreamVersion);
+
+    quint32 magic = 0, version = 0, count = 0;
+    quint64 seq = 0;
+    in >> magic >> version >> seq >> count;
+    // Версия 1 — все фигуры подряд в одном слое
+    if (magic != kSnapshotMagic || version < 1 || version > kSnapshotVersion)
+        return false;
+
+    struct LayerState {
+        QString name;
+        bool    visible = true;
+        bool    locked  = false;
+        int     first   = 0;     // фигуры слоя в shapes — с first по конец следующего
+    };
+    QVector<LayerState> layerStates;
+    QVector<Shape*>     shapes;
+    QVector<qint64>     keys;
+    const quint32 layerCount = version == 1 ? 1 : count;
+    for (quint32 l = 0; l < layerCount && in.status() == QDataStream::Ok; ++l) {
+        LayerState ls;
+        quint32 n = count;
+        if (version > 1)
+            in >> ls.name >> ls.visible >> ls.locked >> n;
+        ls.first = shapes.size();
+        layerStates.append(ls);
+        for (quint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+            quint64 id;
+            quint8  type;
+            qint64  zKey = i;
+            in >> id >> type;
+            if (version > 1)
+                in >> zKey;
+            Shape* s = new Shape(ShapeType(type), QPointF(), Qt::black);
+            s->setId(id);
+            s->readState(in);
+            shapes.append(s);
+            keys.append(zKey);
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        qDeleteAll(shapes);
+        return false;
+    }
+
+    // Фигуры — в слои на свои ключи, затем слоям — имена и состояние
+    // (блокировка снимает фигуры со сцены, поэтому после расстановки)
+    m->setShapes(QVector<Shape*>());
+    for (int l = 0; l < layerStates.size(); ++l) {
+        Layer* layer = layerAt(m, l);
+        const int end = l + 1 < layerStates.size() ? layerStates.at(l + 1).first : shapes.size();
+        QList<Shape*> part;
+        for (int i = layerStates.at(l).first; i < end; ++i) {
+            shapes.at(i)->setLayerPlacement(layer, keys.at(i));
+            part.append(shapes.at(i));
+        }
+        m->addExistingShapes(part);
+    }
+    for (int l = 0; l < layerStates.size(); ++l) {
+        const LayerState& ls = layerStates.at(l);
+        Layer* layer = m->getLayers().at(l);
+        if (version > 1)
+            m->renameLayer(layer, ls.name);
+        m->setLayerVisible(layer, ls.visible);
+        m->setLayerLocked(layer, ls.locked);
+    }
+    m->setCurrentLayer(m->getLayers().first());
+    snapshotBytes = file.size();
+    *snapshotSeq  = seq;
+    return true;
+}
+
+bool OperationJournal::replayJournal(GraphicModel* m, quint64 snapshotSeq) {
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    QHash<quint64, Shape*> byId;
+    for (Shape* s : m->getShapes())
+        byId.insert(s->getId(), s);
+
+    bool   applied  = false;
+    qint64 validEnd = 0;
+    for (;;) {
+        const QByteArray header = file.read(kRecordHeader);
+        if (header.size() < kRecordHeader)
+            break;
+
+        quint32 length;
+        quint16 crc;
+        QDataStream hs(header);
+        hs >> length >> crc;
+
+        const QByteArray payload = file.read(length);
+        if (payload.size() != int(length) || recordChecksum(length, payload) != crc)
+            break; // оборванная запись в хвосте — всё, что дальше, не доверяем
+        validEnd = file.pos();
+
+        QDataStream in(payload);
+        in.setVersion(kStreamVersion);
+        quint64 seq, id;
+        quint8  op;
+        in >> seq >> op >> id;
+        nextSeq = qMax(nextSeq, seq + 1);
+        if (seq <= snapshotSeq)
+            continue;
+
+        Shape* s = byId.value(id, nullptr);
+        switch (Op(op)) {
+        case Op::Add: {
+            quint8 type;
+            in >> type;
+            if (s)
+                break;
+            s = new Shape(ShapeType(type), QPointF(), Qt::black);
+            s->setId(id);
+            s->readState(in);
+            m->addExistingShape(s);
+            byId.insert(id, s);
+            break;
+        }
+        case Op::Remove:
+            if (s) {
+                byId.remove(id);
+                m->removeShape(s);
+            }
+            break;
+        case Op::Move: {
+            QPointF p;
+            in >> p;
+            if (s) s->setPos(p);
+            break;
+        }
+        case Op::Color: {
+            QColor c;
+            in >> c;
+            if (s) s->setColor(c);
+            break;
+        }
+        case Op::Update:
+            if (s) s->readState(in);
+            break;
+        case Op::Clear:
+            m->clear();
+            byId.clear();
+            break;
+        case Op::Place: {
+            qint32 position;
+            qint64 zKey;
+            in >> position >> zKey;
+            if (s && position >= 0)
+                m->placeShape(s, layerAt(m, position), zKey);
+            break;
+        }
+        }
+        applied = true;
+    }
+
+    if (validEnd < file.size())
+        file.resize(validEnd);
+    journalBytes = validEnd;
+    return applied;
+}
@@ -0,0 +1,107 @@
+// operationjournal.h
+#ifndef OPERATIONJOURNAL_H
+#define OPERATIONJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+#include <QByteArray>
+#include <QString>
+#include "shape.h"
+
+class GraphicModel;
+class QUndoStack;
+class OperationJournal;
+
+// Команда, которая умеет описать свой эффект в журнале.
+// Журнал вызывает эти методы уже после выполнения redo()/undo(),
+// поэтому записи фиксируют текущее состояние фигур.
+class JournaledCommand {
+public:
+    virtual ~JournaledCommand() {}
+    virtual void journalRedo(OperationJournal* journal) const = 0;
+    virtual void journalUndo(OperationJournal* journal) const = 0;
+};
+
+// Пишет пакеты журнала и снимки на диск в фоновом потоке
+class JournalWriter : public QObject {
+    Q_OBJECT
+public:
+    JournalWriter(const QString& journalPath,
+                  const QString& snapshotPath,
+                  QObject* parent = nullptr);
+
+public slots:
+    void append(const QByteArray& records);
+    void writeSnapshot(const QByteArray& snapshot);
+    void close();
+
+private:
+    bool ensureOpen();
+
+    QFile   journalFile;
+    QString snapshotPath;
+};
+
+// Append-only журнал операций для автосохранения и восстановления после сбоя.
+// Каждая запись: [quint32 длина][quint16 crc длины и данных][seq, операция, данные].
+// Снимок хранит номер последней учтённой записи, поэтому повторное
+// применение уже сжатых записей при восстановлении исключено.
+// Место фигуры (слой по позиции и ключ z) пишется и в снимок, и записью Place;
+// сами слои (имена, видимость, блокировка) — только в снимок.
+class OperationJournal : public QObject {
+    Q_OBJECT
+public:
+    enum class Op : quint8 { Add = 1, Remove, Move, Color, Update, Clear, Place };
+
+    explicit OperationJournal(const QString& directory, QObject* parent = nullptr);
+    ~OperationJournal() override;
+
+    // Восстановить документ: последний снимок + хвост журнала
+    bool recover(GraphicModel* model);
+
+    // Начать журналирование команд стека
+    void attach(GraphicModel* model, QUndoStack* stack);
+
+    void recordAdd   (const Shape* shape);
+    void recordRemove(const Shape* shape);
+    void recordMove  (const Shape* shape);
+    void recordColor (const Shape* shape);
+    void recordUpdate(const Shape* shape);
+    void recordClear ();
+    void recordPlace (const Shape* shape);
+
+    // Отправить накопленные записи в фоновый поток
+    void flush();
+    // Записать снимок документа вместо длинной серии записей (например, после
+    // отмены «Очистить всё»): журнал после него начинается заново
+    void checkpoint();
+
+private slots:
+    void onIndexChanged(int index);
+
+private:
+    void         commitRecord(const QByteArray& payload);
+    void         compact();
+    bool         replayJournal(GraphicModel* model, quint64 snapshotSeq);
+    bool         loadSnapshot (GraphicModel* model, quint64* snapshotSeq);
+
+    QString       journalPath;
+    QString       snapshotPath;
+
+    QThread       writerThread;
+    JournalWriter* writer;
+    QTimer        flushTimer;
+
+    GraphicModel* model;
+    QUndoStack*   stack;
+    int           lastIndex;
+
+    QByteArray    pending;
+    quint64       nextSeq;
+    qint64        journalBytes;
+    qint64        snapshotBytes;
+};
+
+#endif // OPERATIONJOURNAL_H
@@ -0,0 +1,348 @@
+// sessionrecorder.cpp
+#include "sessionrecorder.h"
+#include "graphicmodel.h"
+#include <QCryptographicHash>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+const quint32 kSessionMagic   = 0x47455352; // "GESR"
+const quint32 kSessionVersion = 3;   // 2: двойной щелчок и клавиши ввода текста; 3: выделение и перетаскивание сценой
+const int     kStreamVersion  = QDataStream::Qt_5_15;
+
+void writeEvent(QDataStream& out, const SessionEvent& e) {
+    out << quint8(e.type) << e.timeNs;
+    switch (e.type) {
+    case SessionEvent::MousePress:
+    case SessionEvent::MouseMove:
+    case SessionEvent::DoubleClick:
+        out << e.pos;
+        break;
+    case SessionEvent::Key:
+        out << e.key << e.text;
+        break;
+    case SessionEvent::Mode:
+        out << e.mode;
+        break;
+    case SessionEvent::Color:
+        out << e.color;
+        break;
+    case SessionEvent::Font:
+        out << e.font << e.applyToSelection;
+        break;
+    case SessionEvent::Selection:
+        out << e.ids;
+        break;
+    case SessionEvent::ShapeDragStart:
+        out << e.shapeId;
+        break;
+    case SessionEvent::ShapeDragFinish:
+        out << e.shapeId << e.pos << e.startPoint << e.endPoint;
+        break;
+    default:
+        break;
+    }
+}
+
+bool readEvent(QDataStream& in, SessionEvent* e) {
+    quint8 type;
+    in >> type >> e->timeNs;
+    e->type = SessionEvent::Type(type);
+    switch (e->type) {
+    case SessionEvent::MousePress:
+    case SessionEvent::MouseMove:
+    case SessionEvent::DoubleClick:
+        in >> e->pos;
+        break;
+    case SessionEvent::Key:
+        in >> e->key >> e->text;
+        break;
+    case SessionEvent::Mode:
+        in >> e->mode;
+        break;
+    case SessionEvent::Color:
+        in >> e->color;
+        break;
+    case SessionEvent::Font:
+        in >> e->font >> e->applyToSelection;
+        break;
+    case SessionEvent::Selection:
+        in >> e->ids;
+        break;
+    case SessionEvent::ShapeDragStart:
+        in >> e->shapeId;
+        break;
+    case SessionEvent::ShapeDragFinish:
+        in >> e->shapeId >> e->pos >> e->startPoint >> e->endPoint;
+        break;
+    default:
+        break;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+qint64 percentile(const QVector<qint64>& sorted, double q) {
+    if (sorted.isEmpty())
+        return 0;
+    const int i = int(q * (sorted.size() - 1) + 0.5);
+    return sorted.at(qBound(0, i, int(sorted.size()) - 1));
+}
+
+} // namespace
+
+// ---------------- SessionRecorder ----------------
+
+SessionRecorder::SessionRecorder(const QString& path, QObject* parent)
+    : QObject(parent)
+    , file(path)
+{
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        out.setDevice(&file);
+        out.setVersion(kStreamVersion);
+        out << kSessionMagic << kSessionVersion;
+    }
+    clock.start();
+}
+
+SessionRecorder::~SessionRecorder() {
+    if (file.isOpen())
+        file.close();
+}
+
+bool SessionRecorder::isOpen() const {
+    return file.isOpen();
+}
+
+void SessionRecorder::write(SessionEvent& e) {
+    if (!file.isOpen())
+        return;
+    e.timeNs = clock.nsecsElapsed();
+    writeEvent(out, e);
+}
+
+void SessionRecorder::recordMousePressed(const QPointF& pos) {
+    SessionEvent e;
+    e.type = SessionEvent::MousePress;
+    e.pos  = pos;
+    write(e);
+}
+
+void SessionRecorder::recordMouseMoved(const QPointF& pos) {
+    SessionEvent e;
+    e.type = SessionEvent::MouseMove;
+    e.pos  = pos;
+    write(e);
+}
+
+void SessionRecorder::recordMouseReleased() {
+    SessionEvent e;
+    e.type = SessionEvent::MouseRelease;
+    write(e);
+}
+
+void SessionRecorder::recordMode(EditorMode mode) {
+    SessionEvent e;
+    e.type = SessionEvent::Mode;
+    e.mode = qint32(mode);
+    write(e);
+}
+
+void SessionRecorder::recordColor(const QColor& color) {
+    SessionEvent e;
+    e.type  = SessionEvent::Color;
+    e.color = color;
+    write(e);
+}
+
+void SessionRecorder::recordFont(const QFont& font, bool applyToSelection) {
+    SessionEvent e;
+    e.type = SessionEvent::Font;
+    e.font = font;
+    e.applyToSelection = applyToSelection;
+    write(e);
+}
+
+void SessionRecorder::recordDelete() { SessionEvent e; e.type = SessionEvent::Delete; write(e); }
+void SessionRecorder::recordClear()  { SessionEvent e; e.type = SessionEvent::Clear;  write(e); }
+void SessionRecorder::recordUndo()   { SessionEvent e; e.type = SessionEvent::Undo;   write(e); }
+void SessionRecorder::recordRedo()   { SessionEvent e; e.type = SessionEvent::Redo;   write(e); }
+void SessionRecorder::recordCopy()      { SessionEvent e; e.type = SessionEvent::Copy;      write(e); }
+void SessionRecorder::recordPaste()     { SessionEvent e; e.type = SessionEvent::Paste;     write(e); }
+void SessionRecorder::recordDuplicate() { SessionEvent e; e.type = SessionEvent::Duplicate; write(e); }
+void SessionRecorder::recordBringToFront() { SessionEvent e; e.type = SessionEvent::BringToFront; write(e); }
+void SessionRecorder::recordSendToBack()   { SessionEvent e; e.type = SessionEvent::SendToBack;   write(e); }
+
+void SessionRecorder::recordDoubleClick(const QPointF& pos) {
+    SessionEvent e;
+    e.type = SessionEvent::DoubleClick;
+    e.pos  = pos;
+    write(e);
+}
+
+void SessionRecorder::recordKey(int key, const QString& text) {
+    SessionEvent e;
+    e.type = SessionEvent::Key;
+    e.key  = key;
+    e.text = text;
+    write(e);
+}
+
+void SessionRecorder::recordSelection(const QList<Shape*>& selected) {
+    SessionEvent e;
+    e.type = SessionEvent::Selection;
+    e.ids.reserve(selected.size());
+    for (const Shape* s : selected)
+        e.ids.append(s->getId());
+    write(e);
+}
+
+void SessionRecorder::recordShapeDragStarted(const Shape* shape) {
+    SessionEvent e;
+    e.type    = SessionEvent::ShapeDragStart;
+    e.shapeId = shape->getId();
+    write(e);
+}
+
+void SessionRecorder::recordShapeDragFinished(const Shape* shape) {
+    SessionEvent e;
+    e.type       = SessionEvent::ShapeDragFinish;
+    e.shapeId    = shape->getId();
+    e.pos        = shape->pos();
+    e.startPoint = shape->getStartPos();
+    e.endPoint   = shape->getEndPos();
+    write(e);
+}
+
+bool SessionRecorder::load(const QString& path, QVector<SessionEvent>* events) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    in.setVersion(kStreamVersion);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    // Версии 1 и 2 — подмножества текущей, читаются как есть
+    if (magic != kSessionMagic || version < 1 || version > kSessionVersion)
+        return false;
+
+    // Запись могла оборваться вместе с приложением — берём всё, что прочиталось целиком
+    while (!in.atEnd()) {
+        SessionEvent e;
+        if (!readEvent(in, &e))
+            break;
+        events->append(e);
+    }
+    return true;
+}
+
+// ---------------- SessionReplayer ----------------
+
+ReplayReport SessionReplayer::replay(const QVector<SessionEvent>& events, Pacing pacing) {
+    GraphicModel      model;
+    GraphicController controller(&model);
+
+    ReplayReport report;
+    QVector<qint64> latencies;
+    latencies.reserve(events.size());
+
+    QElapsedTimer session;
+    session.start();
+
+    for (const SessionEvent& e : events) {
+        if (pacing == Pacing::RealTime) {
+            const qint64 wait = e.timeNs - session.nsecsElapsed();
+            if (wait > 0)
+                QThread::usleep(quint64(wait / 1000));
+        }
+
+        QElapsedTimer t;
+        t.start();
+        switch (e.type) {
+        case SessionEvent::MousePress:   controller.mousePressed(e.pos); break;
+        case SessionEvent::MouseMove:    controller.mouseMoved(e.pos);   break;
+        case SessionEvent::MouseRelease: controller.mouseReleased();     break;
+        case SessionEvent::Mode:
+            controller.setEditorMode(EditorMode(e.mode));
+            break;
+        case SessionEvent::Color:
+            controller.setCurrentColor(e.color);
+            controller.changeSelectedItemsColor(e.color);
+            break;
+        case SessionEvent::Font:
+            controller.setCurrentFont(e.font);
+            if (e.applyToSelection)
+                controller.changeSelectedItemsFont(e.font);
+            break;
+        case SessionEvent::Delete: controller.deleteSelectedItems(); break;
+        case SessionEvent::Clear:  controller.clearAll();            break;
+        case SessionEvent::Undo:   controller.undo();                break;
+        case SessionEvent::Redo:   controller.redo();                break;
+        case SessionEvent::Copy:      controller.copySelection();      break;
+        case SessionEvent::Paste:     controller.paste();              break;
+        case SessionEvent::Duplicate: controller.duplicateSelection(); break;
+        case SessionEvent::BringToFront: controller.bringSelectionToFront(); break;
+        case SessionEvent::SendToBack:   controller.sendSelectionToBack();   break;
+        case SessionEvent::DoubleClick:  controller.editTextAt(e.pos);       break;
+        case SessionEvent::Key:          controller.textKeyPressed(e.key, e.text); break;
+        case SessionEvent::Selection:
+            model.clearSelection();
+            for (quint64 id : e.ids) {
+                if (Shape* s = model.shapeById(id))
+                    s->setSelected(true);
+                else
+                    ++report.skipped;
+            }
+            break;
+        case SessionEvent::ShapeDragStart:
+            if (Shape* s = model.shapeById(e.shapeId))
+                controller.shapeDragStarted(s);
+            else
+                ++report.skipped;
+            break;
+        case SessionEvent::ShapeDragFinish:
+            if (Shape* s = model.shapeById(e.shapeId)) {
+                // Как сцена Qt: все выделенные фигуры на сцене сдвигаются вместе со схваченной
+                const QPointF delta = e.pos - s->pos();
+                if (!delta.isNull()) {
+                    for (Shape* moved : model.getSelection()->shapes())
+                        if (moved->scene())
+                            moved->setPos(moved->pos() + delta);
+                }
+                s->setGeometry(e.startPoint, e.endPoint);
+                controller.shapeDragFinished(s);
+            } else {
+                ++report.skipped;
+            }
+            break;
+        }
+        latencies.append(t.nsecsElapsed());
+    }
+
+    report.totalNs = session.nsecsElapsed();
+    report.events  = latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    report.p50Ns   = percentile(latencies, 0.50);
+    report.p90Ns   = percentile(latencies, 0.90);
+    report.p99Ns   = percentile(latencies, 0.99);
+    report.maxNs   = latencies.isEmpty() ? 0 : latencies.last();
+    report.shapes  = model.getShapes().size();
+    report.checksum = sceneChecksum(&model);
+    report.memory   = MemoryUsage::current();
+    return report;
+}
+
+// Контрольная сумма итоговой сцены: порядок, тип и полное состояние каждой фигуры
+QByteArray SessionReplayer::sceneChecksum(const GraphicModel* model) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const Shape* s : model->getShapes()) {
+        QByteArray state;
+        QDataStream out(&state, QIODevice::WriteOnly);
+        out.setVersion(kStreamVersion);
+        out << quint8(s->getType());
+        s->writeState(out);
+        hash.addData(state);
+    }
+    return hash.result().toHex();
+}
@@ -0,0 +1,108 @@
+// sessionrecorder.h
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPointF>
+#include <QColor>
+#include <QFont>
+#include "graphiccontroller.h"
+#include "memorypool.h"
+
+// Одно событие пользовательской сессии
+struct SessionEvent {
+    enum Type : quint8 {
+        MousePress = 1, MouseMove, MouseRelease,
+        Mode, Color, Font,
+        Delete, Clear, Undo, Redo,
+        Copy, Paste, Duplicate,
+        BringToFront, SendToBack,
+        DoubleClick, Key,
+        Selection, ShapeDragStart, ShapeDragFinish
+    };
+
+    Type    type   = MousePress;
+    qint64  timeNs = 0;        // от начала записи
+    QPointF pos;
+    qint32  mode   = 0;        // EditorMode
+    QColor  color;
+    QFont   font;
+    bool    applyToSelection = false;
+    qint32  key    = 0;        // Qt::Key при вводе текста на холсте
+    QString text;
+    QVector<quint64> ids;      // выделение по id фигур
+    quint64 shapeId = 0;       // фигура, которую тащит сама сцена
+    QPointF startPoint;        // её точки после отпускания (изменение размера ручками)
+    QPointF endPoint;
+};
+
+// Записывает поток событий сцены и тулбара с временными метками
+class SessionRecorder : public QObject {
+    Q_OBJECT
+public:
+    explicit SessionRecorder(const QString& path, QObject* parent = nullptr);
+    ~SessionRecorder() override;
+
+    bool isOpen() const;
+
+    void recordMousePressed (const QPointF& pos);
+    void recordMouseMoved   (const QPointF& pos);
+    void recordMouseReleased();
+    void recordMode (EditorMode mode);
+    void recordColor(const QColor& color);
+    void recordFont (const QFont& font, bool applyToSelection);
+    void recordDelete();
+    void recordClear();
+    void recordUndo();
+    void recordRedo();
+    void recordCopy();
+    void recordPaste();
+    void recordDuplicate();
+    void recordBringToFront();
+    void recordSendToBack();
+    void recordDoubleClick(const QPointF& pos);
+    void recordKey(int key, const QString& text);
+    // Щелчки и перетаскивание фигур обрабатывает сама сцена, мимо контроллера:
+    // пишется итог — выделение и конечное положение схваченной фигуры
+    void recordSelection(const QList<Shape*>& selected);
+    void recordShapeDragStarted (const Shape* shape);
+    void recordShapeDragFinished(const Shape* shape);
+
+    static bool load(const QString& path, QVector<SessionEvent>* events);
+
+private:
+    void write(SessionEvent& e);
+
+    QFile         file;
+    QDataStream   out;
+    QElapsedTimer clock;
+};
+
+// Итог проигрывания сессии
+struct ReplayReport {
+    int     events    = 0;
+    int     skipped   = 0;
+    qint64  totalNs   = 0;
+    qint64  p50Ns     = 0;
+    qint64  p90Ns     = 0;
+    qint64  p99Ns     = 0;
+    qint64  maxNs     = 0;
+    int     shapes    = 0;
+    QByteArray checksum;
+    MemoryUsage memory;     // снимается до разрушения модели и истории
+};
+
+// Проигрывает записанную сессию без окна прямо на GraphicController
+class SessionReplayer {
+public:
+    enum class Pacing { FullSpeed, RealTime };
+
+    static ReplayReport replay(const QVector<SessionEvent>& events, Pacing pacing);
+    static QByteArray   sceneChecksum(const GraphicModel* model);
+};
+
+#endif // SESSIONRECORDER_H
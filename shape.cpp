@@ -1,14 +1,205 @@
 // shape.cpp
 #include "shape.h"
+#include "customgraphicsscene.h"
+#include "graphicmodel.h"
+#include "memorypool.h"
+#include "tilepyramid.h"
 #include <QCursor>
 #include <QGraphicsSceneMouseEvent>
-#include <QGraphicsSceneHoverEvent>
 #include <QtMath>
 #include <QPainter>
 #include <QPen>
 #include <QBrush>
 #include <QFontMetrics>
 #include <QPolygonF>
+#include <atomic>
+#include <limits>
+
+namespace {
+
+// Допуск попадания вокруг тонких линий (перо 2px + запас под курсор)
+const qreal kHitTolerance = 4.0;
+
+qreal distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b) {
+    const QPointF ab = b - a;
+    const qreal len2 = QPointF::dotProduct(ab, ab);
+    qreal t = len2 > 0 ? QPointF::dotProduct(p - a, ab) / len2 : 0;
+    t = qBound<qreal>(0, t, 1);
+    const QPointF d = p - (a + t * ab);
+    return qSqrt(QPointF::dotProduct(d, d));
+}
+
+qreal distanceToPolyline(const QPointF& p, const QPolygonF& line) {
+    qreal best = std::numeric_limits<qreal>::max();
+    for (int i = 1; i < line.size(); ++i)
+        best = qMin(best, distanceToSegment(p, line.at(i - 1), line.at(i)));
+    return best;
+}
+
+// Масштаб, под который рисует painter: по нему выбирается ломаная пути
+qreal paintScale(const QPainter* painter) {
+    const QTransform& t = painter->worldTransform();
+    return qSqrt(qAbs(t.determinant()));
+}
+
+// Фигуры могут удаляться не в GUI-потоке, поэтому счётчики атомарные
+std::atomic<int>    g_liveCount[kShapeTypeCount];
+std::atomic<qint64> g_dataBytes[kShapeTypeCount];
+
+} // namespace
+
+QString shapeTypeName(ShapeType type) {
+    switch (type) {
+    case ShapeType::Line:      return "Line";
+    case ShapeType::Rectangle: return "Rectangle";
+    case ShapeType::Ellipse:   return "Ellipse";
+    case ShapeType::Text:      return "Text";
+    case ShapeType::Star:      return "Star";
+    case ShapeType::Image:     return "Image";
+    case ShapeType::Path:      return "Path";
+    }
+    return QString();
+}
+
+// ---------------- ShapeData ----------------
+
+ShapeData::ShapeData(ShapeType type,
+                     const QPointF& startPos,
+                     const QColor& color,
+                     const QFont& font)
+    : type(type)
+    , startPos(startPos)
+    , endPos(startPos)
+    , color(color)
+    , textFont(font)
+    , accountedBytes(0)
+{
+    // Новый путь — S-образная кривая, растягиваемая мышью как прямоугольник
+    if (type == ShapeType::Path)
+        path = BezierPath::sCurve();
+}
+
+ShapeData::ShapeData(const ShapeData& other)
+    : QSharedData(other)
+    , type(other.type)
+    , startPos(other.startPos)
+    , endPos(other.endPos)
+    , color(other.color)
+    , text(other.text)
+    , textFont(other.textFont)
+    , path(other.path)
+    , starCache(other.starCache)
+    , textRect(other.textRect)
+    , hitPath(other.hitPath)
+    , pyramid(other.pyramid)
+    , flat(other.flat)
+    , accountedBytes(0)
+{
+    account();
+}
+
+ShapeData::~ShapeData() {
+    g_dataBytes[int(type)] -= accountedBytes;
+}
+
+void ShapeData::account() const {
+    // Разделяемые данные учитываются один раз, сколько бы фигур на них ни ссылалось
+    const qint64 bytes = qint64(sizeof(ShapeData))
+                       + qint64(text.capacity())      * qint64(sizeof(QChar))
+                       + qint64(starCache.capacity()) * qint64(sizeof(QPointF))
+                       + qint64(path.pointCount())    * qint64(sizeof(QPointF))
+                       + flat.bytes()
+                       + qint64(hitPath.elementCount()) * qint64(sizeof(QPainterPath::Element));
+    g_dataBytes[int(type)] += bytes - accountedBytes;
+    accountedBytes = bytes;
+}
+
+QRectF ShapeData::outlineRect() const {
+    if (type == ShapeType::Text)
+        return textRect;
+    // Изображение точно по размеру, без запаса под перо
+    if (type == ShapeType::Image)
+        return QRectF(startPos, endPos).normalized();
+    return QRectF(startPos, endPos)
+    .normalized()
+        .adjusted(-10, -10, +10, +10);
+}
+
+QRectF ShapeData::boundingRect() const {
+    // +1 на половину пера
+    return outlineRect().adjusted(-1, -1, +1, +1);
+}
+
+void ShapeData::updateGeometryCache() {
+    if (type == ShapeType::Text) {
+        QFontMetrics fm(textFont);
+        textRect = QRectF(startPos,
+                          QSizeF(fm.horizontalAdvance(text),
+                                 fm.height()));
+    }
+    starCache = (type == ShapeType::Star) ? Shape::starPolygon(outlineRect()) : QPolygonF();
+    // Пирамида открывается (и при необходимости строится в фоне) по смене источника
+    if (type == ShapeType::Image && (!pyramid || pyramid->getSourcePath() != text))
+        pyramid = text.isEmpty() ? QSharedPointer<TilePyramid>() : TilePyramid::open(text);
+
+    // Ломаные старого пути больше не годятся
+    flat.clear();
+
+    // Контур для запросов по области (резиновая рамка, коллизии Qt);
+    // строится один раз на изменение геометрии, а не на каждый запрос
+    hitPath = QPainterPath();
+    switch (type) {
+    case ShapeType::Line: {
+        QPointF dir = endPos - startPos;
+        const qreal len = qSqrt(QPointF::dotProduct(dir, dir));
+        dir = len > 0 ? dir * (kHitTolerance / len) : QPointF(kHitTolerance, 0);
+        const QPointF n(-dir.y(), dir.x());
+        hitPath.addPolygon(QPolygonF() << startPos - dir + n << endPos + dir + n
+                                       << endPos + dir - n << startPos - dir - n);
+        hitPath.closeSubpath();
+        break;
+    }
+    case ShapeType::Rectangle:
+        // С тем же допуском, что и Shape::contains
+        hitPath.addRect(outlineRect().adjusted(-kHitTolerance, -kHitTolerance,
+                                               +kHitTolerance, +kHitTolerance));
+        break;
+    case ShapeType::Text:
+    case ShapeType::Image:
+        hitPath.addRect(outlineRect());
+        break;
+    case ShapeType::Ellipse:
+        hitPath.addEllipse(outlineRect().adjusted(-kHitTolerance, -kHitTolerance,
+                                                  +kHitTolerance, +kHitTolerance));
+        break;
+    case ShapeType::Star:
+        hitPath.addPolygon(starCache);
+        hitPath.closeSubpath();
+        break;
+    case ShapeType::Path: {
+        // Полоса вокруг ломаной обычного масштаба: рамка выделения ловит кривую, а не её хорды
+        QPainterPath line;
+        line.addPolygon(flattened(1.0));
+        QPainterPathStroker stroker;
+        stroker.setWidth(2 * kHitTolerance);
+        hitPath = stroker.createStroke(line);
+        break;
+    }
+    }
+    account();
+}
+
+const QPolygonF& ShapeData::flattened(qreal scale) const {
+    const int bucket = FlatteningCache::bucketFor(scale);
+    if (const QPolygonF* hit = flat.find(bucket))
+        return *hit;
+    const QPolygonF& line = flat.insert(bucket, path.mapped(QRectF(startPos, endPos))
+                                                    .flatten(FlatteningCache::toleranceFor(bucket)));
+    account();
+    return line;
+}
+
+// ---------------- Shape ----------------
 
 Shape::Shape(ShapeType type,
              const QPointF& startPos,
@@ -16,143 +207,426 @@ Shape::Shape(ShapeType type,
              const QFont& font,
              QGraphicsItem* parent)
     : QGraphicsItem(parent)
-    , type(type)
-    , startPos(startPos)
-    , endPos(startPos)
-    , color(color)
-    , textFont(font)
+    , d(new ShapeData(type, startPos, color, font))
+    , id(0)
+    , layer(nullptr)
+    , zKey(0)
+    , isEditing(false)
+    , editCursor(0)
+    , batched(false)
+    , quiet(false)
+    , currentHandle(None)
+    , isResizing(false)
+{
+    setFlags(ItemIsSelectable | ItemIsMovable | ItemSendsGeometryChanges);
+    d->updateGeometryCache();
+    ++g_liveCount[int(type)];
+}
+
+Shape::Shape(const QSharedDataPointer<ShapeData>& data, QGraphicsItem* parent)
+    : QGraphicsItem(parent)
+    , d(data)
+    , id(0)
+    , layer(nullptr)
+    , zKey(0)
     , isEditing(false)
+    , editCursor(0)
+    , batched(false)
+    , quiet(false)
     , currentHandle(None)
     , isResizing(false)
 {
-    setFlags(ItemIsSelectable | ItemIsMovable);
-    setAcceptHoverEvents(true);
+    // Кэши геометрии приходят вместе с данными — пересчитывать нечего
+    setFlags(ItemIsSelectable | ItemIsMovable | ItemSendsGeometryChanges);
+    ++g_liveCount[int(this->data().type)];
+}
+
+Shape::~Shape() {
+    --g_liveCount[int(data().type)];
+}
+
+void* Shape::operator new(std::size_t size) {
+    return shapeMemoryPool().allocate(size);
+}
+
+void Shape::operator delete(void* p, std::size_t size) {
+    shapeMemoryPool().deallocate(p, size);
+}
+
+int Shape::liveCount(ShapeType type) {
+    return g_liveCount[int(type)];
+}
+
+qint64 Shape::liveBytes(ShapeType type) {
+    return qint64(g_liveCount[int(type)]) * qint64(sizeof(Shape)) + g_dataBytes[int(type)];
+}
+
+QSharedDataPointer<ShapeData> Shape::sharedData() const {
+    return d;
+}
+
+QRectF Shape::outlineRect() const {
+    return data().outlineRect();
 }
 
 QRectF Shape::boundingRect() const {
-    return QRectF(startPos, endPos)
-    .normalized()
-        .adjusted(-10, -10, +10, +10);
+    // При вводе текста — запас под рамку редактирования
+    return isEditing ? data().boundingRect().adjusted(-3, -3, +3, +3) : data().boundingRect();
+}
+
+QPainterPath Shape::shape() const {
+    // Нажатие Qt проверяет по shape(), а не по contains(): ручки выделенной фигуры
+    // могут лежать вне контура (углы линии, эллипса, звезды) — добавляем их
+    const ShapeData& sd = data();
+    if (!isSelected() || sd.type == ShapeType::Text)
+        return sd.hitPath;
+    QPainterPath path = sd.hitPath;
+    path.setFillRule(Qt::WindingFill);
+    for (int i = TopLeft; i <= BottomRight; ++i)
+        path.addRect(getHandleRect(ResizeHandle(i)));
+    return path;
+}
+
+bool Shape::contains(const QPointF& p) const {
+    // Ручки выделенной фигуры могут лежать вне самой фигуры (например, у линии)
+    if (isSelected() && getResizeHandle(p) != None)
+        return true;
+
+    const ShapeData& sd = data();
+    switch (sd.type) {
+    case ShapeType::Line:
+        return distanceToSegment(p, sd.startPos, sd.endPos) <= kHitTolerance;
+    case ShapeType::Rectangle:
+        return outlineRect().adjusted(-kHitTolerance, -kHitTolerance,
+                                      +kHitTolerance, +kHitTolerance).contains(p);
+    case ShapeType::Ellipse: {
+        const QRectF r  = outlineRect();
+        const qreal  rx = r.width()  / 2 + kHitTolerance;
+        const qreal  ry = r.height() / 2 + kHitTolerance;
+        const qreal  dx = (p.x() - r.center().x()) / rx;
+        const qreal  dy = (p.y() - r.center().y()) / ry;
+        return dx*dx + dy*dy <= 1.0;
+    }
+    case ShapeType::Star:
+        return sd.starCache.containsPoint(p, Qt::OddEvenFill);
+    case ShapeType::Text:
+        return sd.textRect.contains(p);
+    case ShapeType::Image:
+        return outlineRect().contains(p);
+    case ShapeType::Path: {
+        // Ломаная под текущий зум вида — та же, что на экране
+        const auto* sc = qobject_cast<CustomGraphicsScene*>(scene());
+        return distanceToPolyline(p, sd.flattened(sc ? sc->getViewScale() : 1.0)) <= kHitTolerance;
+    }
+    }
+    return false;
 }
 
 void Shape::paint(QPainter* painter,
                   const QStyleOptionGraphicsItem* /*opt*/,
                   QWidget* /*w*/)
 {
-    // теперь QPainter и QPen уже полноценно видны
-    painter->setPen(QPen(color, 2));
+    auto* sc = qobject_cast<CustomGraphicsScene*>(scene());
+    // Пакетную фигуру рисует её серия (один раз на серию, на месте первой фигуры)
+    if (batched && sc && sc->paintBatched(painter, this))
+        return;
 
-    switch (type) {
+    // Только чтение — отрисовка не должна отделять общие данные
+    const ShapeData& sd = data();
+    const bool draft = sc && sc->isDraftMode();
+    painter->setPen(QPen(sd.color, draft ? 0 : 2));
+
+    switch (sd.type) {
     case ShapeType::Line:
-        painter->drawLine(startPos, endPos);
+        painter->drawLine(sd.startPos, sd.endPos);
         break;
     case ShapeType::Rectangle:
-        painter->drawRect(boundingRect());
+        painter->drawRect(outlineRect());
         break;
     case ShapeType::Ellipse:
-        painter->drawEllipse(boundingRect());
-        break;
-    case ShapeType::Star: {
-        QRectF r = boundingRect();
-        QPointF c = r.center();
-        qreal  R = qMin(r.width(), r.height()) / 2;
-        QPolygonF star;
-        const int pts = 5;
-        for (int i = 0; i < 2*pts; ++i) {
-            qreal angle = M_PI/pts * i;
-            qreal rad   = (i % 2 == 0 ? R : R/2);
-            star << QPointF(
-                c.x() + rad * qCos(angle - M_PI_2),
-                c.y() + rad * qSin(angle - M_PI_2)
-                );
-        }
-        painter->drawPolygon(star);
+        painter->drawEllipse(outlineRect());
+        break;
+    case ShapeType::Star:
+        painter->drawPolygon(sd.starCache);
         break;
-    }
     case ShapeType::Text: {
-        QFontMetrics fm(textFont);
-        QRectF tr(startPos,
-                  QSizeF(fm.horizontalAdvance(text),
-                         fm.height()));
-        if (isSelected()) {
-            painter->save();
-            painter->setBrush(QColor(0,120,215,50));
-            painter->setPen(Qt::NoPen);
-            painter->drawRect(tr);
-            painter->restore();
+        // Вёрстка текста — самое дорогое в кадре; в черновике хватает полосы
+        if (draft) {
+            painter->fillRect(sd.textRect, QColor(sd.color.red(), sd.color.green(),
+                                                  sd.color.blue(), 60));
+            break;
+        }
+        painter->setFont(sd.textFont);
+        painter->drawText(sd.textRect, Qt::AlignLeft | Qt::AlignTop | Qt::TextSingleLine, sd.text);
+        if (isEditing) {
+            // Рамка ввода и курсор; ширина префикса — только до курсора
+            const qreal x = sd.textRect.left()
+                          + QFontMetrics(sd.textFont).horizontalAdvance(sd.text.left(editCursor));
+            painter->setPen(QPen(sd.color, 0));
+            painter->drawLine(QPointF(x, sd.textRect.top()), QPointF(x, sd.textRect.bottom()));
+            painter->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+            painter->drawRect(sd.textRect.adjusted(-2, -2, +2, +2));
         }
-        painter->setFont(textFont);
-        painter->drawText(startPos + QPointF(0, fm.ascent()), text);
         break;
     }
+    case ShapeType::Image:
+        // Только видимые плитки уровня под текущий масштаб; пока пирамида
+        // строится — полупрозрачная заглушка, сцена перерисуется по готовности
+        if (sd.pyramid && sd.pyramid->isReady()) {
+            sd.pyramid->paint(painter, outlineRect(), draft);
+            break;
+        }
+        if (sd.pyramid && scene())
+            sd.pyramid->notifyWhenReady(scene());
+        painter->fillRect(outlineRect(), QColor(sd.color.red(), sd.color.green(),
+                                                sd.color.blue(), 30));
+        painter->drawRect(outlineRect());
+        break;
+    case ShapeType::Path:
+        // Ломаная из кэша корзины масштаба: кривые перестраиваются, только когда
+        // зум переходит в другую корзину, а не на каждый кадр
+        painter->drawPolyline(sd.flattened(paintScale(painter)));
+        break;
     }
+    // Рамку и ручки выделения рисует сцена поверх всего (CustomGraphicsScene::drawForeground)
+}
 
-    // рамка и ручки ресайза
-    if (isSelected() || isEditing) {
-        painter->setPen(QPen(Qt::blue,1,Qt::DashLine));
-        painter->drawRect(boundingRect());
-        if (type != ShapeType::Text) {
-            painter->setBrush(Qt::white);
-            painter->setPen(QPen(Qt::black,1));
-            for (int i = 1; i <= 4; ++i)
-                painter->drawRect(getHandleRect(
-                    static_cast<ResizeHandle>(i)
-                    ));
-        }
+QPolygonF Shape::starPolygon(const QRectF& r) {
+    QPointF c = r.center();
+    qreal  R = qMin(r.width(), r.height()) / 2;
+    QPolygonF star;
+    const int pts = 5;
+    for (int i = 0; i < 2*pts; ++i) {
+        qreal angle = M_PI/pts * i;
+        qreal rad   = (i % 2 == 0 ? R : R/2);
+        star << QPointF(
+            c.x() + rad * qCos(angle - M_PI_2),
+            c.y() + rad * qSin(angle - M_PI_2)
+            );
     }
+    return star;
 }
+
 void Shape::setEndPos(const QPointF& ep) {
     prepareGeometryChange();
-    endPos = ep;
+    d->endPos = ep;
+    d->updateGeometryCache();
+    contentChanged();
+    update();
+}
+
+void Shape::setGeometry(const QPointF& sp, const QPointF& ep) {
+    if (data().startPos == sp && data().endPos == ep)
+        return;
+    prepareGeometryChange();
+    ShapeData* sd = d.data();
+    sd->startPos = sp;
+    sd->endPos   = ep;
+    sd->updateGeometryCache();
+    contentChanged();
     update();
 }
 
 void Shape::setText(const QString& t) {
-    text = t;
+    if (data().text == t)
+        return;    // не отделять общие данные и не перевёрстывать впустую
+    prepareGeometryChange();
+    d->text = t;
+    d->updateGeometryCache();
+    attributesChanged();
     update();
 }
 
 QString Shape::getText() const {
-    return text;
+    return data().text;
 }
 
 void Shape::setFont(const QFont& f) {
-    textFont = f;
+    prepareGeometryChange();
+    d->textFont = f;
+    d->updateGeometryCache();
+    contentChanged();
     update();
 }
 
 QFont Shape::getFont() const {
-    return textFont;
+    return data().textFont;
+}
+
+void Shape::setImageSource(const QString& path, const QSizeF& size) {
+    prepareGeometryChange();
+    d->text   = path;
+    d->endPos = d->startPos + QPointF(size.width(), size.height());
+    d->updateGeometryCache();
+    attributesChanged();
+    update();
+}
+
+void Shape::setCurve(const BezierPath& curve) {
+    prepareGeometryChange();
+    const QRectF bounds = curve.controlBounds();
+    ShapeData* sd = d.data();
+    sd->startPos = bounds.topLeft();
+    sd->endPos   = bounds.bottomRight();
+    sd->path     = curve.normalized(bounds);
+    sd->updateGeometryCache();
+    contentChanged();
+    update();
+}
+
+BezierPath Shape::getCurve() const {
+    return data().path.mapped(QRectF(data().startPos, data().endPos));
+}
+
+const QPolygonF& Shape::getFlattened(qreal scale) const {
+    return data().flattened(scale);
 }
 
 void Shape::setColor(const QColor& c) {
-    color = c;
+    if (data().color == c)
+        return;    // не отделять общие данные впустую
+    d->color = c;
+    attributesChanged();
     update();
 }
 
 QColor Shape::getColor() const {
-    return color;
+    return data().color;
+}
+
+void Shape::setAnimatedState(int fields, const QPointF& p, const QColor& c, const QPointF& ep) {
+    quiet = true;
+    if ((fields & AnimateEnd) && data().endPos != ep) {
+        prepareGeometryChange();
+        d->endPos = ep;
+        d->updateGeometryCache();
+    }
+    if ((fields & AnimateColor) && data().color != c)
+        d->color = c;
+    if (fields & AnimatePos)
+        setPos(p);
+    quiet = false;
+    // Перерисовку делает модель — одним обновлением сцены на весь кадр
 }
 
 void Shape::setEditing(bool e) {
-    isEditing = e;
+    if (e == isEditing)
+        return;
+    prepareGeometryChange();
+    isEditing  = e;
+    editCursor = data().text.size();
+    updateBatchState();
     update();
 }
 
+bool Shape::isEditingText() const {
+    return isEditing;
+}
+
+void Shape::setEditCursor(int cursor) {
+    cursor = qBound(0, cursor, int(data().text.size()));
+    if (cursor == editCursor)
+        return;
+    editCursor = cursor;
+    update();
+}
+
+int Shape::getEditCursor() const {
+    return editCursor;
+}
+
 ShapeType Shape::getType() const {
-    return type;
+    return data().type;
+}
+
+QPolygonF Shape::getStarPolygon() const {
+    return data().starCache;
+}
+
+bool Shape::isBatched() const {
+    return batched;
+}
+
+void Shape::updateBatchState() {
+    auto* sc = qobject_cast<CustomGraphicsScene*>(scene());
+    // Выделение фигура больше не рисует сама — выделенные тоже идут в корзину;
+    // текст и изображение всегда рисуются своим paint()
+    const bool b = sc && sc->isBatchedRendering()
+                   && !isEditing
+                   && data().type != ShapeType::Text
+                   && data().type != ShapeType::Image;
+    if (b == batched)
+        return;
+    batched = b;
+    // Фигура переходит между серией сцены и собственным paint()
+    update();
+}
+
+void Shape::contentChanged() {
+    if (layer)
+        layer->shapeChanged(this);
+}
+
+void Shape::attributesChanged() {
+    if (layer)
+        layer->attributesChanged(this);
+}
+
+quint64 Shape::getId() const {
+    return id;
+}
+
+void Shape::setId(quint64 i) {
+    id = i;
+}
+
+Layer* Shape::getLayer() const {
+    return layer;
+}
+
+qint64 Shape::getZKey() const {
+    return zKey;
+}
+
+void Shape::setLayerPlacement(Layer* l, qint64 key) {
+    layer = l;
+    zKey  = key;
+}
+
+void Shape::writeState(QDataStream& out) const {
+    writeState(out, data(), pos());
+}
+
+void Shape::writeState(QDataStream& out, const ShapeData& sd, const QPointF& pos) {
+    out << sd.startPos << sd.endPos << pos << sd.color << sd.textFont << sd.text;
+    // Точки пути — только у пути: записи остальных типов остались прежними
+    if (sd.type == ShapeType::Path)
+        out << sd.path;
+}
+
+void Shape::readState(QDataStream& in) {
+    QPointF p;
+    prepareGeometryChange();
+    ShapeData* sd = d.data();
+    in >> sd->startPos >> sd->endPos >> p >> sd->color >> sd->textFont >> sd->text;
+    if (sd->type == ShapeType::Path)
+        in >> sd->path;
+    d->updateGeometryCache();
+    attributesChanged();
+    setPos(p);
+    update();
 }
 
 QPointF Shape::getStartPos() const {
-    return startPos;
+    return data().startPos;
 }
 
 QPointF Shape::getEndPos() const {
-    return endPos;
+    return data().endPos;
 }
 
 Shape::ResizeHandle Shape::getResizeHandle(const QPointF& pos) const {
-    if (type == ShapeType::Text) return None;
+    if (data().type == ShapeType::Text) return None;
     for (int i = 1; i <= 4; ++i) {
         ResizeHandle h = static_cast<ResizeHandle>(i);
         if (getHandleRect(h).contains(pos))
@@ -162,7 +636,7 @@ Shape::ResizeHandle Shape::getResizeHandle(const QPointF& pos) const {
 }
 
 QRectF Shape::getHandleRect(ResizeHandle handle) const {
-    QRectF r = QRectF(startPos, endPos).normalized();
+    QRectF r = QRectF(data().startPos, data().endPos).normalized();
     const qreal hs = 8;
     switch (handle) {
     case TopLeft:
@@ -187,8 +661,8 @@ void Shape::mousePressEvent(QGraphicsSceneMouseEvent* e) {
         currentHandle = getResizeHandle(e->pos());
         isResizing    = (currentHandle != None);
         if (isResizing) {
-            resizeStartPos = startPos;
-            resizeStartEnd = endPos;
+            resizeStartPos = data().startPos;
+            resizeStartEnd = data().endPos;
         }
     }
     QGraphicsItem::mousePressEvent(e);
@@ -197,21 +671,24 @@ void Shape::mousePressEvent(QGraphicsSceneMouseEvent* e) {
 void Shape::mouseMoveEvent(QGraphicsSceneMouseEvent* e) {
     if (isResizing && (e->buttons() & Qt::LeftButton)) {
         prepareGeometryChange();
-        QPointF d = e->scenePos() - e->lastScenePos();
+        const QPointF delta = e->scenePos() - e->lastScenePos();
+        ShapeData* sd = d.data();
         switch (currentHandle) {
-        case TopLeft:     startPos += d; break;
+        case TopLeft:     sd->startPos += delta; break;
         case TopRight:
-            endPos.setX(endPos.x() + d.x());
-            startPos.setY(startPos.y() + d.y());
+            sd->endPos.setX(sd->endPos.x() + delta.x());
+            sd->startPos.setY(sd->startPos.y() + delta.y());
             break;
         case BottomLeft:
-            startPos.setX(startPos.x() + d.x());
-            endPos.setY(endPos.y() + d.y());
+            sd->startPos.setX(sd->startPos.x() + delta.x());
+            sd->endPos.setY(sd->endPos.y() + delta.y());
             break;
         case BottomRight:
-            endPos += d; break;
+            sd->endPos += delta; break;
         default: break;
         }
+        d->updateGeometryCache();
+        contentChanged();
         update();
     } else {
         QGraphicsItem::mouseMoveEvent(e);
@@ -224,17 +701,27 @@ void Shape::mouseReleaseEvent(QGraphicsSceneMouseEvent* e) {
     QGraphicsItem::mouseReleaseEvent(e);
 }
 
-void Shape::hoverMoveEvent(QGraphicsSceneHoverEvent* e) {
-    ResizeHandle h = getResizeHandle(e->pos());
-    switch (h) {
-    case TopLeft:
-    case BottomRight:
-        setCursor(QCursor(Qt::SizeFDiagCursor)); break;
-    case TopRight:
-    case BottomLeft:
-        setCursor(QCursor(Qt::SizeBDiagCursor)); break;
+QVariant Shape::itemChange(GraphicsItemChange change, const QVariant& value) {
+    if (quiet)
+        return QGraphicsItem::itemChange(change, value);
+    switch (change) {
+    case ItemSelectedChange:
+        // shape() зависит от выделения (ручки)
+        prepareGeometryChange();
+        break;
+    case ItemSelectedHasChanged:
+        // Через слой, а не через сцену: фигура может быть снята со сцены виртуализацией
+        if (layer)
+            layer->selectionChanged(this, value.toBool());
+        break;
+    case ItemPositionHasChanged:
+        contentChanged();
+        break;
+    case ItemSceneHasChanged:
+        updateBatchState();
+        break;
     default:
-        setCursor(QCursor(Qt::ArrowCursor));      break;
+        break;
     }
-    QGraphicsItem::hoverMoveEvent(e);
+    return QGraphicsItem::itemChange(change, value);
 }
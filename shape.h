@@ -7,8 +7,70 @@
 #include <QFont>
 #include <QString>
 #include <QPointF>
+#include <QDataStream>
+#include <QPolygonF>
+#include <QPainterPath>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QSharedPointer>
+#include <cstddef>
+#include "bezierpath.h"
+
+class TilePyramid;
+
+enum class ShapeType { Line, Rectangle, Ellipse, Text, Star, Image, Path };
+const int kShapeTypeCount = 7;
+
+// Имя типа для отчётов и подсказок
+QString shapeTypeName(ShapeType type);
+
+// Содержимое фигуры с неявным разделением (copy-on-write): копии, дубликаты
+// и вставки из буфера делят одни данные, пока одну из фигур не изменят
+class ShapeData : public QSharedData {
+public:
+    ShapeData(ShapeType type,
+              const QPointF& startPos,
+              const QColor& color,
+              const QFont& font);
+    ShapeData(const ShapeData& other);
+    ~ShapeData();
+
+    // Прямоугольник контура фигуры (см. Shape::outlineRect)
+    QRectF outlineRect() const;
+    // Контур с запасом на половину пера (см. Shape::boundingRect)
+    QRectF boundingRect() const;
+
+    // Пересчитать кэш звезды, текста и контура попадания после изменения геометрии;
+    // заодно обновляет учёт памяти
+    void updateGeometryCache();
+
+    // Ломаная пути для масштаба вида scale (из кэша корзин допуска, см. FlatteningCache);
+    // только GUI-поток
+    const QPolygonF& flattened(qreal scale) const;
+
+    ShapeType type;
+    QPointF   startPos;
+    QPointF   endPos;
+    QColor    color;
+    QString   text;        // у изображения — путь к файлу-источнику
+    QFont     textFont;
+    BezierPath path;       // у пути — в единичном квадрате, растянутом на startPos..endPos
 
-enum class ShapeType { Line, Rectangle, Ellipse, Text, Star };
+    // Кэши геометрии зависят только от данных и разделяются вместе с ними
+    QPolygonF    starCache;
+    QRectF       textRect;
+    QPainterPath hitPath;
+    QSharedPointer<TilePyramid> pyramid;   // плитки изображения (общие для одного файла)
+    FlatteningCache flat;                  // ломаные пути по корзинам масштаба
+
+private:
+    // Учесть байты данных в счётчиках памяти
+    void account() const;
+
+    mutable qint64 accountedBytes;   // кэш ломаных растёт и при отрисовке
+};
+
+class Layer;
 
 class Shape : public QGraphicsItem {
 public:
@@ -17,8 +79,28 @@ public:
           const QColor& color,
           const QFont& font = QFont(),
           QGraphicsItem* parent = nullptr);
+    // Новая фигура поверх уже существующих данных (без копирования)
+    explicit Shape(const QSharedDataPointer<ShapeData>& data,
+                   QGraphicsItem* parent = nullptr);
+    ~Shape() override;
+
+    // Фигуры живут в слэбовом пуле (memorypool.h), а не в общей куче
+    static void* operator new(std::size_t size);
+    static void  operator delete(void* p, std::size_t size);
+
+    // Учёт памяти: число живых фигур типа и их байты (объекты + общие данные)
+    static int    liveCount(ShapeType type);
+    static qint64 liveBytes(ShapeType type);
 
     QRectF boundingRect() const override;
+
+    // Точные попадания по типу фигуры вместо ограничивающего прямоугольника
+    QPainterPath shape() const override;
+    bool         contains(const QPointF& point) const override;
+
+    // Прямоугольник, по которому рисуются прямоугольник/эллипс/звезда и рамка выделения
+    QRectF outlineRect() const;
+
     void paint(QPainter* painter,
                const QStyleOptionGraphicsItem* option,
                QWidget* widget = nullptr) override;
@@ -27,6 +109,8 @@ public:
     QPointF getStartPos() const;
     QPointF getEndPos()   const;
     void    setEndPos(const QPointF& endPos);
+    // Обе точки разом (изменение размера ручками и его Undo)
+    void    setGeometry(const QPointF& startPos, const QPointF& endPos);
 
     // Текст
     void    setText(const QString& text);
@@ -35,35 +119,94 @@ public:
     void    setFont(const QFont& font);
     QFont   getFont() const;
 
+    // Изображение: файл-источник и размер на сцене (startPos — левый верхний угол)
+    void    setImageSource(const QString& path, const QSizeF& size);
+
+    // Путь Безье в координатах фигуры; startPos/endPos становятся габаритами его точек
+    void       setCurve(const BezierPath& path);
+    BezierPath getCurve() const;
+    // Ломаная пути под масштаб вида (для пакетной отрисовки и миникарты)
+    const QPolygonF& getFlattened(qreal scale) const;
+
     // Цвет
     void   setColor(const QColor& color);
     QColor getColor() const;
 
-    // Режим редактирования текста
+    // Кадр анимации: позиция, цвет и конец одним шагом, без уведомлений слоя
+    // и перерисовки — их пакетом на весь кадр делает GraphicModel::applyFrame
+    enum AnimatedField { AnimatePos = 0x1, AnimateColor = 0x2, AnimateEnd = 0x4 };
+    void    setAnimatedState(int fields, const QPointF& pos, const QColor& color, const QPointF& endPos);
+
+    // Ввод текста на холсте: рамка и курсор рисуются самой фигурой
     void    setEditing(bool editing);
+    bool    isEditingText() const;
+    // Позиция курсора ввода в символах
+    void    setEditCursor(int cursor);
+    int     getEditCursor() const;
 
     // Тип фигуры
     ShapeType getType() const;
 
+    // Контур звезды из кэша (пусто у остальных типов)
+    QPolygonF getStarPolygon() const;
+
+    // Пакетная отрисовка (см. ShapeBatch): простую фигуру рисует серия сцены
+    // (CustomGraphicsScene::paintBatched) вместе с соседями по z
+    bool isBatched() const;
+    void updateBatchState();
+
+    // Общие данные фигуры: копия указателя не копирует содержимое
+    QSharedDataPointer<ShapeData> sharedData() const;
+
+    // Контур звезды, вписанной в прямоугольник (общий для отрисовки и экспорта)
+    static QPolygonF starPolygon(const QRectF& rect);
+
+    // Идентификатор фигуры в документе (назначается моделью)
+    quint64 getId() const;
+    void    setId(quint64 id);
+
+    // Слой и ключ z внутри слоя (назначаются моделью; сохраняются после
+    // удаления фигуры, чтобы Undo вернул её на прежнее место)
+    Layer*  getLayer() const;
+    qint64  getZKey() const;
+    void    setLayerPlacement(Layer* layer, qint64 zKey);
+
+    // Ручки ресайза (в координатах фигуры); рисует и опрашивает их
+    // оверлей выделения сцены, фигуре события наведения не нужны
+    enum ResizeHandle { None, TopLeft, TopRight, BottomLeft, BottomRight };
+    ResizeHandle getResizeHandle(const QPointF& pos) const;
+    QRectF       getHandleRect(ResizeHandle handle) const;
+
+    // Сериализация состояния (всё, кроме типа и идентификатора)
+    void writeState(QDataStream& out) const;
+    void readState (QDataStream& in);
+    // То же для данных без живой фигуры (снимок документа)
+    static void writeState(QDataStream& out, const ShapeData& data, const QPointF& pos);
+
 protected:
     void mousePressEvent  (QGraphicsSceneMouseEvent* event) override;
     void mouseMoveEvent   (QGraphicsSceneMouseEvent* event) override;
     void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
-    void hoverMoveEvent   (QGraphicsSceneHoverEvent* event) override;
+    QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
 
 private:
-    enum ResizeHandle { None, TopLeft, TopRight, BottomLeft, BottomRight };
-    ResizeHandle getResizeHandle(const QPointF& pos) const;
-    QRectF        getHandleRect(ResizeHandle handle) const;
 
-    ShapeType type;
-    QPointF   startPos;
-    QPointF   endPos;
-    QColor    color;
+    // Содержимое изменилось: снимок слоя (DocumentSnapshot) устарел, габариты в сетке модели — тоже
+    void contentChanged();
+    // Цвет или текст изменились: вдобавок обновить индекс атрибутов (ShapeIndex)
+    void attributesChanged();
 
-    QString   text;
-    QFont     textFont;
+    // Только чтение: не отделяет разделяемые данные даже в неконстантных методах
+    const ShapeData& data() const { return *d.constData(); }
+
+    QSharedDataPointer<ShapeData> d;
+    quint64   id;
+    Layer*    layer;
+    qint64    zKey;
     bool      isEditing;
+    int       editCursor;
+    bool      batched;
+    bool      quiet;       // идёт setAnimatedState: itemChange ничего не рассылает
 
     ResizeHandle currentHandle;
     bool         isResizing;
@@ -0,0 +1,162 @@
+// shapebatch.cpp
+#include "shapebatch.h"
+#include <QPainter>
+#include <QPen>
+
+namespace {
+
+const int kMaxBuckets = 256;   // столько разных цветов на экране — повод начать заново
+
+// Эмиттеры по типам: сбор геометрии в корзину и один вызов отрисовки на корзину.
+// Специализации выбираются при компиляции, в цикле по фигурам нет виртуальных вызовов.
+template <ShapeType T> struct Emitter;
+
+template <> struct Emitter<ShapeType::Line> {
+    static void collect(ShapeBatch::Bucket& b, const Shape* s, const QPointF& o) {
+        b.lines.append(QLineF(s->getStartPos() + o, s->getEndPos() + o));
+    }
+    static void draw(QPainter* p, const ShapeBatch::Bucket& b) {
+        p->drawLines(b.lines);
+    }
+};
+
+template <> struct Emitter<ShapeType::Rectangle> {
+    static void collect(ShapeBatch::Bucket& b, const Shape* s, const QPointF& o) {
+        b.rects.append(s->outlineRect().translated(o));
+    }
+    static void draw(QPainter* p, const ShapeBatch::Bucket& b) {
+        p->drawRects(b.rects);
+    }
+};
+
+template <> struct Emitter<ShapeType::Ellipse> {
+    static void collect(ShapeBatch::Bucket& b, const Shape* s, const QPointF& o) {
+        b.path.addEllipse(s->outlineRect().translated(o));
+    }
+    static void draw(QPainter* p, const ShapeBatch::Bucket& b) {
+        p->drawPath(b.path);
+    }
+};
+
+// Звезда — замкнутая ломаная из кэша фигуры, рёбра идут в общий drawLines
+template <> struct Emitter<ShapeType::Star> {
+    static void collect(ShapeBatch::Bucket& b, const Shape* s, const QPointF& o) {
+        const QPolygonF star = s->getStarPolygon();
+        const int n = star.size();
+        for (int i = 0; i < n; ++i)
+            b.lines.append(QLineF(star.at(i) + o, star.at((i + 1) % n) + o));
+    }
+    static void draw(QPainter* p, const ShapeBatch::Bucket& b) {
+        p->drawLines(b.lines);
+    }
+};
+
+// Путь — ломаная из кэша фигуры под масштаб кадра, рёбра идут в общий drawLines
+template <> struct Emitter<ShapeType::Path> {
+    static void collect(ShapeBatch::Bucket& b, const Shape* s, const QPointF& o, qreal scale) {
+        const QPolygonF& line = s->getFlattened(scale);
+        for (int i = 1; i < line.size(); ++i)
+            b.lines.append(QLineF(line.at(i - 1) + o, line.at(i) + o));
+    }
+    static void draw(QPainter* p, const ShapeBatch::Bucket& b) {
+        p->drawLines(b.lines);
+    }
+};
+
+} // namespace
+
+int ShapeBatch::bucket(ShapeType type, const QColor& color) {
+    const quint64 key = (quint64(type) << 32) | color.rgba();
+    auto it = index.constFind(key);
+    if (it != index.constEnd())
+        return it.value();
+
+    if (buckets.size() >= kMaxBuckets) {
+        // Собранное не теряется: сначала рисуем, потом начинаем корзины заново
+        flush();
+        buckets.clear();
+        index.clear();
+    }
+    index.insert(key, buckets.size());
+    buckets.append(Bucket());
+    Bucket& b = buckets.last();
+    b.type  = type;
+    b.color = color;
+    return buckets.size() - 1;
+}
+
+void ShapeBatch::begin(QPainter* p, bool d) {
+    painter = p;
+    draft   = d;
+    shapes  = 0;
+}
+
+void ShapeBatch::add(const Shape* s) {
+    switch (s->getType()) {
+    case ShapeType::Text:
+    case ShapeType::Image:
+        return;   // текст всегда рисуется самой фигурой, изображение — плитками
+    default:
+        break;
+    }
+
+    const QRectF area = s->sceneBoundingRect();
+    int bi = bucket(s->getType(), s->getColor());
+    // Более поздние корзины рисуются позже: если фигура лежит под их содержимым,
+    // дорисовать всё накопленное, иначе она окажется поверх
+    for (int i = bi + 1; i < buckets.size(); ++i) {
+        if (buckets.at(i).used && buckets.at(i).bounds.intersects(area)) {
+            flush();
+            break;
+        }
+    }
+
+    Bucket& b = buckets[bi];
+    b.used = true;
+    b.bounds |= area;
+    const QPointF o = s->scenePos();
+    switch (s->getType()) {
+    case ShapeType::Line:      Emitter<ShapeType::Line>::collect(b, s, o);      break;
+    case ShapeType::Rectangle: Emitter<ShapeType::Rectangle>::collect(b, s, o); break;
+    case ShapeType::Ellipse:   Emitter<ShapeType::Ellipse>::collect(b, s, o);   break;
+    case ShapeType::Star:      Emitter<ShapeType::Star>::collect(b, s, o);      break;
+    case ShapeType::Path:      Emitter<ShapeType::Path>::collect(b, s, o, viewScale); break;
+    case ShapeType::Text:
+    case ShapeType::Image:     break;
+    }
+    ++shapes;
+}
+
+void ShapeBatch::end() {
+    flush();
+    painter = nullptr;
+}
+
+void ShapeBatch::flush() {
+    if (!painter)
+        return;
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
+    for (Bucket& b : buckets) {
+        if (!b.used)
+            continue;
+        // Перо как в Shape::paint — одно на корзину
+        painter->setPen(QPen(b.color, draft ? 0 : 2));
+        switch (b.type) {
+        case ShapeType::Line:      Emitter<ShapeType::Line>::draw(painter, b);      break;
+        case ShapeType::Rectangle: Emitter<ShapeType::Rectangle>::draw(painter, b); break;
+        case ShapeType::Ellipse:   Emitter<ShapeType::Ellipse>::draw(painter, b);   break;
+        case ShapeType::Star:      Emitter<ShapeType::Star>::draw(painter, b);      break;
+        case ShapeType::Text:      break;
+        case ShapeType::Image:     break;
+        case ShapeType::Path:      Emitter<ShapeType::Path>::draw(painter, b);      break;
+        }
+        // Ёмкость векторов сохраняется до следующего кадра
+        b.lines.clear();
+        b.rects.clear();
+        b.path.clear();
+        b.bounds = QRectF();
+        b.used   = false;
+    }
+    painter->restore();
+}
@@ -0,0 +1,58 @@
+// shapebatch.h
+#ifndef SHAPEBATCH_H
+#define SHAPEBATCH_H
+
+#include <QColor>
+#include <QHash>
+#include <QLineF>
+#include <QPainterPath>
+#include <QRectF>
+#include <QVector>
+#include "shape.h"
+
+class QPainter;
+
+// Пакетная отрисовка простых фигур: подряд идущие по z фигуры раскладываются
+// по корзинам (тип, цвет пера), и на корзину уходит один вызов
+// drawLines/drawRects/drawPath вместо paint() и смены пера на каждую фигуру.
+// Корзины рисуются в порядке появления; если фигура ложится в более раннюю
+// корзину, а перекрывает фигуры более поздней, накопленное сначала рисуется —
+// порядок наложения сохраняется. Корзины переиспользуются между кадрами.
+class ShapeBatch {
+public:
+    // Масштаб кадра: по нему пути берут ломаную своей корзины допуска
+    void setScale(qreal scale) { viewScale = scale; }
+
+    // draft — косметическое перо толщиной в пиксель: заметно дешевле широкого
+    void begin(QPainter* painter, bool draft = false);
+    // Фигуры — по возрастанию z
+    void add(const Shape* shape);
+    // Дорисовать накопленное
+    void end();
+
+    int shapeCount() const { return shapes; }
+
+    struct Bucket {
+        ShapeType       type = ShapeType::Line;
+        QColor          color;
+        QVector<QLineF> lines;
+        QVector<QRectF> rects;
+        QPainterPath    path;
+        QRectF          bounds;   // габариты собранного: по ним видно, перекрывает ли его новая фигура
+        bool            used = false;
+    };
+
+private:
+    int  bucket(ShapeType type, const QColor& color);
+    // Нарисовать заполненные корзины и очистить их (ёмкость сохраняется)
+    void flush();
+
+    QPainter*              painter = nullptr;
+    bool                   draft = false;
+    QVector<Bucket>        buckets;
+    QHash<quint64, int>    index;     // (тип, rgba) -> номер корзины
+    int                    shapes = 0;
+    qreal                  viewScale = 1.0;
+};
+
+#endif // SHAPEBATCH_H
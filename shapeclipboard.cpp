@@ -0,0 +1,138 @@
+// shapeclipboard.cpp
+#include "shapeclipboard.h"
+#include <QClipboard>
+#include <QDataStream>
+#include <QGuiApplication>
+#include <QHash>
+#include <QIODevice>
+#include <QMimeData>
+#include <QStringList>
+
+namespace {
+
+const quint32 kClipMagic     = 0x47454350; // "GECP"
+const quint16 kClipVersion   = 1;
+const int     kStreamVersion = QDataStream::Qt_5_15;
+
+} // namespace
+
+const char ShapeClipboard::kMimeType[] = "application/x-grapheditor-shapes";
+
+QVector<ShapeClip> ShapeClipboard::capture(const QList<Shape*>& shapes) {
+    QVector<ShapeClip> clips;
+    clips.reserve(shapes.size());
+    for (Shape* s : shapes)
+        clips.append(ShapeClip{ s->sharedData(), s->pos() });
+    return clips;
+}
+
+// Формат: заголовок, таблица шрифтов без повторов, затем по записи на фигуру:
+// тип, точки, позиция, цвет RGBA, индекс шрифта и — только у текста — строка
+QByteArray ShapeClipboard::encode(const QVector<ShapeClip>& clips) {
+    QStringList         fonts;
+    QHash<QString, int> fontIndex;
+    QVector<quint32>    shapeFont;
+    shapeFont.reserve(clips.size());
+    for (const ShapeClip& c : clips) {
+        const QString key = c.data->textFont.toString();
+        auto it = fontIndex.constFind(key);
+        if (it == fontIndex.constEnd()) {
+            it = fontIndex.insert(key, fonts.size());
+            fonts.append(key);
+        }
+        shapeFont.append(quint32(it.value()));
+    }
+
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(kStreamVersion);
+    out << kClipMagic << kClipVersion;
+    out << quint32(fonts.size());
+    for (const QString& f : fonts)
+        out << f;
+    out << quint32(clips.size());
+    for (int i = 0; i < clips.size(); ++i) {
+        const ShapeData& d = *clips.at(i).data;
+        out << quint8(d.type) << d.startPos << d.endPos << clips.at(i).pos
+            << quint32(d.color.rgba()) << shapeFont.at(i);
+        if (d.type == ShapeType::Text || d.type == ShapeType::Image)
+            out << d.text;
+        if (d.type == ShapeType::Path)
+            out << d.path;
+    }
+    return bytes;
+}
+
+QVector<ShapeClip> ShapeClipboard::decode(const QByteArray& bytes) {
+    QDataStream in(bytes);
+    in.setVersion(kStreamVersion);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != kClipMagic || version != kClipVersion)
+        return {};
+
+    quint32 fontCount = 0;
+    in >> fontCount;
+    QVector<QFont> fonts;
+    for (quint32 i = 0; i < fontCount && in.status() == QDataStream::Ok; ++i) {
+        QString key;
+        in >> key;
+        QFont f;
+        f.fromString(key);
+        fonts.append(f);
+    }
+
+    quint32 count = 0;
+    in >> count;
+    QVector<ShapeClip> clips;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint8  type;
+        QPointF start, end, pos;
+        quint32 rgba, font;
+        in >> type >> start >> end >> pos >> rgba >> font;
+        if (type >= kShapeTypeCount || font >= quint32(fonts.size()))
+            return {};
+
+        ShapeData* d = new ShapeData(ShapeType(type), start,
+                                     QColor::fromRgba(rgba), fonts.at(int(font)));
+        d->endPos = end;
+        if (d->type == ShapeType::Text || d->type == ShapeType::Image)
+            in >> d->text;
+        if (d->type == ShapeType::Path)
+            in >> d->path;
+        d->updateGeometryCache();
+        clips.append(ShapeClip{ QSharedDataPointer<ShapeData>(d), pos });
+    }
+    if (in.status() != QDataStream::Ok)
+        return {};
+    return clips;
+}
+
+void ShapeClipboard::copy(const QList<Shape*>& shapes) {
+    if (shapes.isEmpty())
+        return;
+    local      = capture(shapes);
+    localBytes = encode(local);
+
+    QMimeData* mime = new QMimeData;
+    mime->setData(kMimeType, localBytes);
+    QGuiApplication::clipboard()->setMimeData(mime);
+}
+
+bool ShapeClipboard::canPaste() const {
+    const QMimeData* mime = QGuiApplication::clipboard()->mimeData();
+    return mime && mime->hasFormat(kMimeType);
+}
+
+QVector<ShapeClip> ShapeClipboard::paste() const {
+    const QMimeData* mime = QGuiApplication::clipboard()->mimeData();
+    if (!mime || !mime->hasFormat(kMimeType))
+        return {};
+    const QByteArray bytes = mime->data(kMimeType);
+    // В буфере всё ещё наша копия — вставляем общие данные, а не разобранные байты
+    if (bytes == localBytes)
+        return local;
+    return decode(bytes);
+}
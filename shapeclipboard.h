@@ -0,0 +1,42 @@
+// shapeclipboard.h
+#ifndef SHAPECLIPBOARD_H
+#define SHAPECLIPBOARD_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPointF>
+#include <QSharedDataPointer>
+#include <QVector>
+#include "shape.h"
+
+// Одна скопированная фигура: общие данные и позиция элемента на сцене
+struct ShapeClip {
+    QSharedDataPointer<ShapeData> data;
+    QPointF                       pos;
+};
+
+// Буфер обмена фигур. Наружу уходит компактный двоичный формат
+// (application/x-grapheditor-shapes); вставка в том же процессе берёт
+// общие данные скопированных фигур, не разбирая байты
+class ShapeClipboard {
+public:
+    static const char kMimeType[];
+
+    // Снять фигуры без копирования содержимого (только ссылки на общие данные)
+    static QVector<ShapeClip> capture(const QList<Shape*>& shapes);
+
+    static QByteArray         encode(const QVector<ShapeClip>& clips);
+    static QVector<ShapeClip> decode(const QByteArray& bytes);
+
+    void copy(const QList<Shape*>& shapes);
+    bool canPaste() const;
+
+    // Содержимое системного буфера; пусто, если там не наши фигуры
+    QVector<ShapeClip> paste() const;
+
+private:
+    QVector<ShapeClip> local;        // последнее, что скопировали мы сами
+    QByteArray         localBytes;   // и как оно было закодировано
+};
+
+#endif // SHAPECLIPBOARD_H
@@ -0,0 +1,168 @@
+// shapegrid.cpp
+#include "shapegrid.h"
+#include <cmath>
+
+namespace {
+
+// Фигура шире этого числа клеток в клетки не раскладывается
+const qint64 kMaxCellsPerShape = 64;
+// Номера клеток ограничены, чтобы далёкие координаты не переполнили int
+const qreal  kMaxCell = 1 << 24;
+
+void removeOne(QVector<Shape*>& v, Shape* s) {
+    const int i = v.indexOf(s);
+    if (i < 0)
+        return;
+    v[i] = v.last();
+    v.removeLast();
+}
+
+} // namespace
+
+ShapeGrid::ShapeGrid(qreal cellSize)
+    : cellSize(cellSize)
+{ }
+
+QRect ShapeGrid::cellsOf(const QRectF& r) const {
+    auto cell = [this](qreal v) {
+        return int(qBound(-kMaxCell, std::floor(v / cellSize), kMaxCell));
+    };
+    return QRect(QPoint(cell(r.left()), cell(r.top())),
+                 QPoint(cell(r.right()), cell(r.bottom())));
+}
+
+bool ShapeGrid::isLarge(const QRect& c) {
+    return qint64(c.width()) * c.height() > kMaxCellsPerShape;
+}
+
+quint64 ShapeGrid::key(int cx, int cy) {
+    return (quint64(quint32(cx)) << 32) | quint32(cy);
+}
+
+void ShapeGrid::link(Shape* s, const QRectF& b) {
+    const QRect c = cellsOf(b);
+    if (isLarge(c)) {
+        large.append(s);
+        return;
+    }
+    for (int y = c.top(); y <= c.bottom(); ++y)
+        for (int x = c.left(); x <= c.right(); ++x)
+            cells[key(x, y)].append(s);
+}
+
+void ShapeGrid::unlink(Shape* s, const QRectF& b) {
+    const QRect c = cellsOf(b);
+    if (isLarge(c)) {
+        removeOne(large, s);
+        return;
+    }
+    for (int y = c.top(); y <= c.bottom(); ++y) {
+        for (int x = c.left(); x <= c.right(); ++x) {
+            auto it = cells.find(key(x, y));
+            if (it == cells.end())
+                continue;
+            removeOne(*it, s);
+            if (it->isEmpty())
+                cells.erase(it);
+        }
+    }
+}
+
+void ShapeGrid::insert(Shape* s) {
+    if (bounds.contains(s))
+        return;
+    const QRectF b = s->sceneBoundingRect();
+    bounds.insert(s, b);
+    link(s, b);
+}
+
+void ShapeGrid::remove(Shape* s) {
+    auto it = bounds.find(s);
+    if (it == bounds.end())
+        return;
+    unlink(s, *it);
+    bounds.erase(it);
+}
+
+QRectF ShapeGrid::update(Shape* s) {
+    auto it = bounds.find(s);
+    if (it == bounds.end())
+        return QRectF();
+    const QRectF old = *it;
+    const QRectF b   = s->sceneBoundingRect();
+    if (b == old)
+        return old;
+    *it = b;
+    // Сдвиг внутри тех же клеток (обычный шаг перетаскивания) клетки не трогает
+    if (cellsOf(b) != cellsOf(old)) {
+        unlink(s, old);
+        link(s, b);
+    }
+    return old;
+}
+
+void ShapeGrid::clear() {
+    cells.clear();
+    large.clear();
+    bounds.clear();
+}
+
+void ShapeGrid::swap(ShapeGrid& other) {
+    qSwap(cellSize, other.cellSize);
+    cells.swap(other.cells);
+    large.swap(other.large);
+    bounds.swap(other.bounds);
+}
+
+bool ShapeGrid::contains(Shape* s) const {
+    return bounds.contains(s);
+}
+
+int ShapeGrid::count() const {
+    return bounds.size();
+}
+
+QList<Shape*> ShapeGrid::shapes() const {
+    return bounds.keys();
+}
+
+QList<Shape*> ShapeGrid::query(const QRectF& rect) const {
+    QList<Shape*> out;
+    const QRectF r = rect.normalized();
+    const QRect  c = cellsOf(r);
+
+    auto visit = [&](int x, int y, const QVector<Shape*>& list) {
+        for (Shape* s : list) {
+            const QRectF b = bounds.value(s);
+            // Фигура на нескольких клетках отвечает один раз — из первой общей клетки
+            const QRect sc = cellsOf(b);
+            if (x != qMax(sc.left(), c.left()) || y != qMax(sc.top(), c.top()))
+                continue;
+            if (b.intersects(r))
+                out.append(s);
+        }
+    };
+
+    // Область больше занятых клеток (сильно отдалённый вид) — обходим занятые клетки
+    if (qint64(c.width()) * c.height() <= cells.size()) {
+        for (int y = c.top(); y <= c.bottom(); ++y) {
+            for (int x = c.left(); x <= c.right(); ++x) {
+                const auto it = cells.constFind(key(x, y));
+                if (it != cells.constEnd())
+                    visit(x, y, *it);
+            }
+        }
+    } else {
+        for (auto it = cells.constBegin(); it != cells.constEnd(); ++it) {
+            const int x = int(quint32(it.key() >> 32));
+            const int y = int(quint32(it.key()));
+            if (c.contains(x, y))
+                visit(x, y, it.value());
+        }
+    }
+
+    for (Shape* s : large)
+        if (bounds.value(s).intersects(r))
+            out.append(s);
+    return out;
+}
@@ -0,0 +1,50 @@
+// shapegrid.h
+#ifndef SHAPEGRID_H
+#define SHAPEGRID_H
+
+#include <QHash>
+#include <QList>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+#include "shape.h"
+
+// Равномерная сетка по габаритам фигур на сцене: какие фигуры лежат в области,
+// без обхода документа и без QGraphicsScene. Держит все фигуры видимых
+// незаблокированных слоёв, в том числе снятые со сцены виртуализацией
+// (GraphicModel::setVirtualized), поэтому попадания, резиновая рамка и миникарта
+// не зависят от того, какие фигуры сейчас стоят на сцене.
+class ShapeGrid {
+public:
+    explicit ShapeGrid(qreal cellSize = 512);
+
+    void insert(Shape* shape);
+    void remove(Shape* shape);
+    // Перечитать габариты фигуры; вернуть прежние (пусто, если фигуры нет в сетке)
+    QRectF update(Shape* shape);
+    void clear();
+    // Обменяться содержимым с другой сеткой за O(1)
+    void swap(ShapeGrid& other);
+
+    bool contains(Shape* shape) const;
+    int  count() const;
+    QList<Shape*> shapes() const;
+
+    // Фигуры, чьи габариты пересекают rect; без повторов, порядок не определён
+    QList<Shape*> query(const QRectF& rect) const;
+
+private:
+    QRect cellsOf(const QRectF& rect) const;
+    void  link(Shape* shape, const QRectF& bounds);
+    void  unlink(Shape* shape, const QRectF& bounds);
+
+    static bool    isLarge(const QRect& cells);
+    static quint64 key(int cx, int cy);
+
+    qreal                           cellSize;
+    QHash<quint64, QVector<Shape*>> cells;
+    QVector<Shape*>                 large;    // накрывают слишком много клеток — проверяются перебором
+    QHash<Shape*, QRectF>           bounds;   // габариты, по которым фигура разложена в клетки
+};
+
+#endif // SHAPEGRID_H
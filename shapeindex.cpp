@@ -0,0 +1,205 @@
+// shapeindex.cpp
+#include "shapeindex.h"
+#include <algorithm>
+
+namespace {
+
+const QSet<Shape*> kNoShapes;
+
+QStringList uniqueTokens(const Shape* s) {
+    if (s->getType() != ShapeType::Text)
+        return QStringList();
+    QStringList t = ShapeIndex::tokenize(s->getText());
+    t.removeDuplicates();
+    return t;
+}
+
+} // namespace
+
+QStringList ShapeIndex::tokenize(const QString& text) {
+    QStringList out;
+    QString word;
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            word += c.toLower();
+        } else if (!word.isEmpty()) {
+            out.append(word);
+            word.clear();
+        }
+    }
+    if (!word.isEmpty())
+        out.append(word);
+    return out;
+}
+
+void ShapeIndex::insert(Shape* s) {
+    if (entries.contains(s))
+        return;
+    Entry e;
+    e.type   = s->getType();
+    e.rgba   = s->getColor().rgba();
+    e.tokens = uniqueTokens(s);
+
+    byType[int(e.type)].insert(s);
+    byColor[e.rgba].insert(s);
+    addTokens(s, e.tokens);
+    entries.insert(s, e);
+}
+
+void ShapeIndex::remove(Shape* s) {
+    auto it = entries.find(s);
+    if (it == entries.end())
+        return;
+    const Entry& e = it.value();
+    byType[int(e.type)].remove(s);
+    auto c = byColor.find(e.rgba);
+    c->remove(s);
+    if (c->isEmpty())
+        byColor.erase(c);
+    removeTokens(s, e.tokens);
+    entries.erase(it);
+}
+
+void ShapeIndex::update(Shape* s) {
+    auto it = entries.find(s);
+    if (it == entries.end())
+        return;
+    Entry& e = it.value();
+
+    const QRgb rgba = s->getColor().rgba();
+    if (rgba != e.rgba) {
+        auto c = byColor.find(e.rgba);
+        c->remove(s);
+        if (c->isEmpty())
+            byColor.erase(c);
+        byColor[rgba].insert(s);
+        e.rgba = rgba;
+    }
+
+    const QStringList tokens = uniqueTokens(s);
+    if (tokens != e.tokens) {
+        removeTokens(s, e.tokens);
+        addTokens(s, tokens);
+        e.tokens = tokens;
+    }
+}
+
+void ShapeIndex::clear() {
+    entries.clear();
+    for (QSet<Shape*>& t : byType)
+        t.clear();
+    byColor.clear();
+    byToken.clear();
+}
+
+void ShapeIndex::swap(ShapeIndex& other) {
+    entries.swap(other.entries);
+    for (int i = 0; i < kShapeTypeCount; ++i)
+        byType[i].swap(other.byType[i]);
+    byColor.swap(other.byColor);
+    byToken.swap(other.byToken);
+}
+
+void ShapeIndex::addTokens(Shape* s, const QStringList& tokens) {
+    for (const QString& t : tokens)
+        byToken[t].insert(s);
+}
+
+void ShapeIndex::removeTokens(Shape* s, const QStringList& tokens) {
+    for (const QString& t : tokens) {
+        auto it = byToken.find(t);
+        if (it == byToken.end())
+            continue;
+        it->remove(s);
+        if (it->isEmpty())
+            byToken.erase(it);
+    }
+}
+
+int ShapeIndex::countOfType(ShapeType type) const {
+    return byType[int(type)].size();
+}
+
+const QSet<Shape*>* ShapeIndex::narrowest(const ShapeQuery& q,
+                                          const QStringList& tokens,
+                                          QSet<Shape*>* prefixMatches) const
+{
+    const QSet<Shape*>* best = nullptr;
+    auto consider = [&best](const QSet<Shape*>* set) {
+        if (!best || set->size() < best->size())
+            best = set;
+    };
+
+    if (!q.anyType)
+        consider(&byType[int(q.type)]);
+    if (!q.anyColor) {
+        auto c = byColor.constFind(q.color.rgba());
+        consider(c == byColor.constEnd() ? &kNoShapes : &c.value());
+    }
+    // Все слова, кроме последнего, — точные
+    for (int i = 0; i + 1 < tokens.size(); ++i) {
+        auto t = byToken.constFind(tokens.at(i));
+        consider(t == byToken.constEnd() ? &kNoShapes : &t.value());
+    }
+    if (best || tokens.isEmpty())
+        return best;
+
+    // Единственное условие — префикс: объединение списков слов с этим началом,
+    // это ровно множество совпадений
+    const QString& prefix = tokens.last();
+    for (auto it = byToken.lowerBound(prefix);
+         it != byToken.constEnd() && it.key().startsWith(prefix); ++it)
+        *prefixMatches += it.value();
+    return prefixMatches;
+}
+
+bool ShapeIndex::matches(Shape* s, const ShapeQuery& q, const QStringList& tokens) const {
+    const auto it = entries.constFind(s);
+    if (it == entries.constEnd())
+        return false;
+    const Entry& e = it.value();
+    if (!q.anyType && e.type != q.type)
+        return false;
+    if (!q.anyColor && e.rgba != q.color.rgba())
+        return false;
+    if (tokens.isEmpty())
+        return true;
+    for (int i = 0; i + 1 < tokens.size(); ++i)
+        if (!e.tokens.contains(tokens.at(i)))
+            return false;
+    const QString& prefix = tokens.last();
+    return std::any_of(e.tokens.cbegin(), e.tokens.cend(),
+                       [&prefix](const QString& t) { return t.startsWith(prefix); });
+}
+
+QList<Shape*> ShapeIndex::find(const ShapeQuery& q) const {
+    const QStringList tokens = tokenize(q.text);
+    QSet<Shape*> prefixMatches;
+    const QSet<Shape*>* candidates = narrowest(q, tokens, &prefixMatches);
+
+    QList<Shape*> result;
+    if (!candidates) {
+        // Условий нет — совпадает всё
+        result = entries.keys();
+    } else {
+        result.reserve(candidates->size());
+        for (Shape* s : *candidates)
+            if (matches(s, q, tokens))
+                result.append(s);
+    }
+    // Порядок id — как у ShapeSelection::shapes(), результаты воспроизводимы
+    std::sort(result.begin(), result.end(),
+              [](const Shape* a, const Shape* b) { return a->getId() < b->getId(); });
+    return result;
+}
+
+int ShapeIndex::count(const ShapeQuery& q) const {
+    // Одно условие по типу или цвету — размер списка без обхода
+    if (q.text.isEmpty() && q.anyColor)
+        return q.anyType ? entries.size() : countOfType(q.type);
+    if (q.text.isEmpty() && q.anyType) {
+        auto c = byColor.constFind(q.color.rgba());
+        return c == byColor.constEnd() ? 0 : c->size();
+    }
+    return find(q).size();
+}
@@ -0,0 +1,72 @@
+// shapeindex.h
+#ifndef SHAPEINDEX_H
+#define SHAPEINDEX_H
+
+#include <QColor>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include "shape.h"
+
+// Запрос по атрибутам: незаданные поля не ограничивают выборку
+struct ShapeQuery {
+    bool      anyType  = true;
+    ShapeType type     = ShapeType::Line;
+    bool      anyColor = true;
+    QColor    color;
+    QString   text;              // слова, которые должны встретиться в тексте фигуры
+
+    static ShapeQuery ofType(ShapeType t)      { ShapeQuery q; q.anyType = false;  q.type = t;  return q; }
+    static ShapeQuery ofColor(const QColor& c) { ShapeQuery q; q.anyColor = false; q.color = c; return q; }
+    static ShapeQuery withText(const QString& s) { ShapeQuery q; q.text = s; return q; }
+};
+
+// Вторичные индексы документа: по типу, по цвету и обратный индекс слов текста.
+// Ведутся инкрементально при добавлении/удалении фигур и смене цвета/текста.
+// Запрос начинается с самого короткого списка и проверяет остальные условия
+// по нему, поэтому стоит пропорционально числу кандидатов, а не размеру документа.
+class ShapeIndex {
+public:
+    void insert(Shape* shape);
+    void remove(Shape* shape);
+    // Перечитать атрибуты фигуры; для фигур вне индекса ничего не делает
+    void update(Shape* shape);
+    void clear();
+    // Обменяться содержимым с другим индексом за O(1) (смена документа целиком)
+    void swap(ShapeIndex& other);
+
+    QList<Shape*> find(const ShapeQuery& query) const;
+    int           count(const ShapeQuery& query) const;
+
+    int countOfType(ShapeType type) const;
+
+    // Слова текста в нижнем регистре — так же режется и строка запроса
+    static QStringList tokenize(const QString& text);
+
+private:
+    // Что проиндексировано для фигуры — чтобы снять старые ключи при смене атрибутов
+    struct Entry {
+        ShapeType   type;
+        QRgb        rgba;
+        QStringList tokens;
+    };
+
+    // Кандидаты от самого узкого условия (nullptr — условий нет)
+    const QSet<Shape*>* narrowest(const ShapeQuery& query,
+                                  const QStringList& tokens,
+                                  QSet<Shape*>* prefixMatches) const;
+    bool matches(Shape* shape, const ShapeQuery& query, const QStringList& tokens) const;
+
+    void addTokens(Shape* shape, const QStringList& tokens);
+    void removeTokens(Shape* shape, const QStringList& tokens);
+
+    QHash<Shape*, Entry>          entries;
+    QSet<Shape*>                  byType[kShapeTypeCount];
+    QHash<QRgb, QSet<Shape*>>     byColor;
+    QMap<QString, QSet<Shape*>>   byToken;   // упорядочен: последнее слово запроса ищется как префикс
+};
+
+#endif // SHAPEINDEX_H
@@ -0,0 +1,145 @@
+// shapelayout.cpp
+#include "shapelayout.h"
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// На меньших выделениях раздача задач пулу дороже самого счёта
+const int kParallelThreshold = 1024;
+
+struct Item {
+    Shape*  shape;
+    QPointF pos;
+    QRectF  extent;   // контур фигуры в координатах сцены
+    QPointF target;
+};
+
+void measure(Item& it) {
+    it.pos    = it.shape->pos();
+    it.extent = it.shape->outlineRect().translated(it.pos);
+    it.target = it.pos;
+}
+
+QRectF extentOf(const Item& it) {
+    return it.extent;
+}
+
+void unite(QRectF& bounds, const QRectF& r) {
+    bounds |= r;
+}
+
+void add(qreal& total, const qreal& v) {
+    total += v;
+}
+
+// Параллельное применение к каждой фигуре; каждая задача пишет только свой элемент
+template <typename Fn>
+void forEachItem(QVector<Item>& items, Fn fn) {
+    if (items.size() < kParallelThreshold) {
+        for (Item& it : items)
+            fn(it);
+        return;
+    }
+    QtConcurrent::blockingMap(items, fn);
+}
+
+QVector<Item> measured(const QList<Shape*>& shapes) {
+    QVector<Item> items;
+    items.reserve(shapes.size());
+    for (Shape* s : shapes)
+        items.append(Item{ s, QPointF(), QRectF(), QPointF() });
+    forEachItem(items, measure);
+    return items;
+}
+
+// Объединение габаритов — параллельная свёртка
+QRectF boundsOf(const QVector<Item>& items) {
+    if (items.size() < kParallelThreshold) {
+        QRectF bounds;
+        for (const Item& it : items)
+            unite(bounds, it.extent);
+        return bounds;
+    }
+    return QtConcurrent::blockingMappedReduced<QRectF>(items, extentOf, unite,
+                                                       QtConcurrent::UnorderedReduce);
+}
+
+template <typename Span>
+qreal totalSpan(const QVector<Item>& items, Span span) {
+    if (items.size() < kParallelThreshold) {
+        qreal total = 0;
+        for (const Item& it : items)
+            total += span(it);
+        return total;
+    }
+    return QtConcurrent::blockingMappedReduced<qreal>(items, span, add,
+                                                      QtConcurrent::UnorderedReduce);
+}
+
+QVector<QPointF> targets(const QVector<Item>& items) {
+    QVector<QPointF> out;
+    out.reserve(items.size());
+    for (const Item& it : items)
+        out.append(it.target);
+    return out;
+}
+
+} // namespace
+
+QVector<QPointF> ShapeLayout::align(const QList<Shape*>& shapes, Align how) {
+    QVector<Item> items = measured(shapes);
+    const QRectF b = boundsOf(items);
+    forEachItem(items, [b, how](Item& it) {
+        const QRectF& e = it.extent;
+        QPointF d;
+        switch (how) {
+        case Align::Left:    d.setX(b.left()       - e.left());       break;
+        case Align::HCenter: d.setX(b.center().x() - e.center().x()); break;
+        case Align::Right:   d.setX(b.right()      - e.right());      break;
+        case Align::Top:     d.setY(b.top()        - e.top());        break;
+        case Align::VCenter: d.setY(b.center().y() - e.center().y()); break;
+        case Align::Bottom:  d.setY(b.bottom()     - e.bottom());     break;
+        }
+        it.target = it.pos + d;
+    });
+    return targets(items);
+}
+
+QVector<QPointF> ShapeLayout::distribute(const QList<Shape*>& shapes, Qt::Orientation orientation) {
+    QVector<Item> items = measured(shapes);
+    if (items.size() < 3)
+        return targets(items);
+
+    const bool horizontal = orientation == Qt::Horizontal;
+    auto lead   = [horizontal](const QRectF& r) { return horizontal ? r.left()       : r.top(); };
+    auto center = [horizontal](const QRectF& r) { return horizontal ? r.center().x() : r.center().y(); };
+    auto span   = [horizontal](const Item& it) {
+        return horizontal ? it.extent.width() : it.extent.height();
+    };
+
+    // Порядок вдоль оси — по центрам; сортируется индекс, результат остаётся в порядке shapes
+    QVector<int> order(items.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return center(items.at(a).extent) < center(items.at(b).extent);
+    });
+
+    // Свободное место между крайними делится поровну (промежуток отрицателен,
+    // если фигуры вместе длиннее отрезка)
+    const QRectF first = items.at(order.first()).extent;
+    const QRectF last  = items.at(order.last()).extent;
+    const qreal  gap   = (lead(last) + (horizontal ? last.width() : last.height()) - lead(first)
+                          - totalSpan(items, span)) / (items.size() - 1);
+
+    // Начала по порядку — префиксная сумма, она последовательна и дешева
+    qreal at = lead(first);
+    for (int i : order) {
+        Item& it = items[i];
+        const qreal shift = at - lead(it.extent);
+        it.target = it.pos + (horizontal ? QPointF(shift, 0) : QPointF(0, shift));
+        at += span(it) + gap;
+    }
+    return targets(items);
+}
@@ -0,0 +1,25 @@
+// shapelayout.h
+#ifndef SHAPELAYOUT_H
+#define SHAPELAYOUT_H
+
+#include <QList>
+#include <QPointF>
+#include <QVector>
+#include "shape.h"
+
+// Выравнивание и распределение фигур. Считает только целевые позиции (pos()),
+// сами фигуры не двигает — это делает одна команда Undo (MoveShapesCommand).
+// Габариты фигур, их объединение и новые позиции на больших выделениях
+// считаются в пуле потоков (QtConcurrent); фигуры при этом только читаются.
+class ShapeLayout {
+public:
+    enum class Align { Left, HCenter, Right, Top, VCenter, Bottom };
+
+    // Прижать габариты фигур к общей стороне или центру их объединения
+    static QVector<QPointF> align(const QList<Shape*>& shapes, Align how);
+
+    // Равные промежутки между соседями вдоль оси; крайние фигуры остаются на месте
+    static QVector<QPointF> distribute(const QList<Shape*>& shapes, Qt::Orientation orientation);
+};
+
+#endif // SHAPELAYOUT_H
@@ -0,0 +1,356 @@
+// shapeoverlap.cpp
+#include "shapeoverlap.h"
+#include "graphicmodel.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// На меньших документах раздача задач пулу дороже самого счёта
+const int   kParallelThreshold = 1024;
+// Столько фигур из развёртки уходит одной задаче пула
+const int   kChunk = 256;
+// Отклонение ломаной от эллипса при проверке эллипса с эллипсом
+const qreal kEllipseTolerance = 0.1;
+// Запас вокруг движущихся фигур, по которому собираются соседи (доля их размера)
+const qreal kGatherMargin = 1.0;
+const qreal kGatherMinMargin = 64;
+
+typedef ShapeOverlap::Geometry Geometry;
+
+// Габариты по замкнутым границам: у горизонтальной линии нулевая высота,
+// а QRectF::intersects такие прямоугольники не пересекает
+bool boxesOverlap(const QRectF& a, const QRectF& b) {
+    return a.left() <= b.right() && b.left() <= a.right()
+        && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+qreal cross(const QPointF& o, const QPointF& a, const QPointF& b) {
+    return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+bool onSegment(const QPointF& a, const QPointF& b, const QPointF& p) {
+    return qMin(a.x(), b.x()) <= p.x() && p.x() <= qMax(a.x(), b.x())
+        && qMin(a.y(), b.y()) <= p.y() && p.y() <= qMax(a.y(), b.y());
+}
+
+// Пересечение отрезков с учётом касаний и наложений на одной прямой
+bool segmentsCross(const QPointF& p1, const QPointF& p2, const QPointF& q1, const QPointF& q2) {
+    const qreal d1 = cross(q1, q2, p1);
+    const qreal d2 = cross(q1, q2, p2);
+    const qreal d3 = cross(p1, p2, q1);
+    const qreal d4 = cross(p1, p2, q2);
+    if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0))
+        && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0)))
+        return true;
+    return (d1 == 0 && onSegment(q1, q2, p1))
+        || (d2 == 0 && onSegment(q1, q2, p2))
+        || (d3 == 0 && onSegment(p1, p2, q1))
+        || (d4 == 0 && onSegment(p1, p2, q2));
+}
+
+// Квадрат расстояния от начала координат до отрезка
+qreal distanceToOrigin2(const QPointF& a, const QPointF& b) {
+    const QPointF d = b - a;
+    const qreal len2 = QPointF::dotProduct(d, d);
+    qreal t = len2 > 0 ? -QPointF::dotProduct(a, d) / len2 : 0;
+    t = qBound<qreal>(0, t, 1);
+    const QPointF p = a + d * t;
+    return QPointF::dotProduct(p, p);
+}
+
+int edgeCount(const Geometry& g) {
+    const int n = g.points.size();
+    if (g.kind == Geometry::Polygon)
+        return n > 2 ? n : n - 1;
+    return n - 1;
+}
+
+QPointF edgeEnd(const Geometry& g, int i) {
+    return g.points.at((i + 1) % g.points.size());
+}
+
+bool edgesCross(const Geometry& a, const Geometry& b) {
+    const int na = edgeCount(a);
+    const int nb = edgeCount(b);
+    for (int i = 0; i < na; ++i) {
+        const QPointF a1 = a.points.at(i);
+        const QPointF a2 = edgeEnd(a, i);
+        const QRectF ea = QRectF(a1, a2).normalized();
+        for (int j = 0; j < nb; ++j) {
+            const QPointF b1 = b.points.at(j);
+            const QPointF b2 = edgeEnd(b, j);
+            if (boxesOverlap(ea, QRectF(b1, b2).normalized()) && segmentsCross(a1, a2, b1, b2))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool inside(const Geometry& polygon, const QPointF& p) {
+    return polygon.points.size() > 2 && polygon.points.containsPoint(p, Qt::OddEvenFill);
+}
+
+// Эллипс растягивается в единичный круг — вторая фигура остаётся многоугольником
+// или ломаной, и проверка сводится к расстояниям до центра
+bool ellipseHits(const Geometry& e, const Geometry& other) {
+    QPolygonF pts;
+    pts.reserve(other.points.size());
+    for (const QPointF& p : other.points)
+        pts.append(QPointF((p.x() - e.center.x()) / e.rx, (p.y() - e.center.y()) / e.ry));
+    if (pts.isEmpty())
+        return false;
+    if (pts.size() == 1)
+        return QPointF::dotProduct(pts.first(), pts.first()) <= 1;
+
+    if (other.kind == Geometry::Polygon && pts.size() > 2
+        && pts.containsPoint(QPointF(0, 0), Qt::OddEvenFill))
+        return true;
+    Geometry scaled;
+    scaled.kind   = other.kind;
+    scaled.points = pts;
+    const int n = edgeCount(scaled);
+    for (int i = 0; i < n; ++i)
+        if (distanceToOrigin2(pts.at(i), edgeEnd(scaled, i)) <= 1)
+            return true;
+    return false;
+}
+
+// Вписанный многоугольник эллипса с отклонением не больше kEllipseTolerance
+Geometry ellipsePolygon(const Geometry& e) {
+    const qreal r = qMax(e.rx, e.ry);
+    int n = 16;
+    if (r > kEllipseTolerance)
+        n = qBound(16, int(std::ceil(M_PI / std::acos(1 - kEllipseTolerance / r))), 512);
+    Geometry g;
+    g.shape = e.shape;
+    g.kind  = Geometry::Polygon;
+    g.box   = e.box;
+    g.points.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        const qreal a = 2 * M_PI * i / n;
+        g.points.append(e.center + QPointF(e.rx * std::cos(a), e.ry * std::sin(a)));
+    }
+    return g;
+}
+
+bool overlapsExact(const Geometry& a, const Geometry& b) {
+    if (a.kind == Geometry::Ellipse && b.kind == Geometry::Ellipse)
+        return ellipseHits(a, ellipsePolygon(b));
+    if (a.kind == Geometry::Ellipse)
+        return ellipseHits(a, b);
+    if (b.kind == Geometry::Ellipse)
+        return ellipseHits(b, a);
+
+    if (edgesCross(a, b))
+        return true;
+    // Без пересечения рёбер одна фигура либо целиком внутри залитой другой, либо снаружи
+    if (a.kind == Geometry::Polygon && !b.points.isEmpty() && inside(a, b.points.first()))
+        return true;
+    if (b.kind == Geometry::Polygon && !a.points.isEmpty() && inside(b, a.points.first()))
+        return true;
+    return false;
+}
+
+// Порядок пар не зависит от раскладки задач по потокам
+bool pairLess(const ShapeOverlap::Pair& a, const ShapeOverlap::Pair& b) {
+    if (a.first->getId() != b.first->getId())
+        return a.first->getId() < b.first->getId();
+    return a.second->getId() < b.second->getId();
+}
+
+ShapeOverlap::Pair orderedPair(Shape* a, Shape* b) {
+    return a->getId() < b->getId() ? qMakePair(a, b) : qMakePair(b, a);
+}
+
+// Кусок развёртки: фигуры [from, to) по возрастанию левого края и найденные пары
+struct Sweep {
+    const QVector<Geometry>* sorted;
+    int                      from;
+    int                      to;
+    QVector<ShapeOverlap::Pair> pairs;
+};
+
+void sweep(Sweep& s) {
+    const QVector<Geometry>& g = *s.sorted;
+    for (int i = s.from; i < s.to; ++i) {
+        const Geometry& a = g.at(i);
+        // Соседи по x — только пока их левый край не правее правого края a
+        for (int j = i + 1; j < g.size() && g.at(j).box.left() <= a.box.right(); ++j) {
+            const Geometry& b = g.at(j);
+            if (a.box.top() <= b.box.bottom() && b.box.top() <= a.box.bottom()
+                && overlapsExact(a, b))
+                s.pairs.append(orderedPair(a.shape, b.shape));
+        }
+    }
+}
+
+bool leftLess(const Geometry& a, const Geometry& b) {
+    return a.box.left() < b.box.left();
+}
+
+} // namespace
+
+ShapeOverlap::Geometry ShapeOverlap::geometryOf(Shape* s) {
+    Geometry g;
+    g.shape = s;
+    const QPointF o = s->pos();
+    const QRectF outline = s->outlineRect().translated(o);
+    switch (s->getType()) {
+    case ShapeType::Line:
+        g.kind   = Geometry::Polyline;
+        g.points << s->getStartPos() + o << s->getEndPos() + o;
+        break;
+    case ShapeType::Rectangle:
+    case ShapeType::Text:
+    case ShapeType::Image:
+        g.kind   = Geometry::Polygon;
+        g.points << outline.topLeft() << outline.topRight()
+                 << outline.bottomRight() << outline.bottomLeft();
+        break;
+    case ShapeType::Ellipse:
+        g.kind   = Geometry::Ellipse;
+        g.center = outline.center();
+        g.rx     = outline.width() / 2;
+        g.ry     = outline.height() / 2;
+        if (g.rx > 0 && g.ry > 0) {
+            g.box = outline;
+            return g;
+        }
+        // Вырожденный эллипс — отрезок вдоль его габаритов
+        g.kind   = Geometry::Polyline;
+        g.points << outline.topLeft() << outline.bottomRight();
+        break;
+    case ShapeType::Star:
+        g.kind   = Geometry::Polygon;
+        g.points = s->getStarPolygon().translated(o);
+        break;
+    case ShapeType::Path:
+        g.kind   = Geometry::Polyline;
+        g.points = s->getFlattened(1.0).translated(o);
+        break;
+    }
+    g.box = g.points.boundingRect();
+    return g;
+}
+
+bool ShapeOverlap::intersects(const Geometry& a, const Geometry& b) {
+    return boxesOverlap(a.box, b.box) && overlapsExact(a, b);
+}
+
+bool ShapeOverlap::intersects(Shape* a, Shape* b) {
+    return intersects(geometryOf(a), geometryOf(b));
+}
+
+QList<Shape*> ShapeOverlap::overlapping(const GraphicModel* model, Shape* shape) {
+    const Geometry g = geometryOf(shape);
+    QList<Shape*> hits;
+    for (Shape* s : model->shapesIn(g.box))
+        if (s != shape && intersects(g, geometryOf(s)))
+            hits.append(s);
+    return hits;
+}
+
+QVector<ShapeOverlap::Pair> ShapeOverlap::allPairs(const QList<Shape*>& shapes) {
+    // Геометрия — в GUI-потоке (кэши ломаных фигур), дальше только чтение
+    QVector<Geometry> sorted;
+    sorted.reserve(shapes.size());
+    for (Shape* s : shapes)
+        sorted.append(geometryOf(s));
+    std::sort(sorted.begin(), sorted.end(), leftLess);
+
+    QVector<Sweep> chunks;
+    for (int from = 0; from < sorted.size(); from += kChunk)
+        chunks.append(Sweep{ &sorted, from, qMin(from + kChunk, int(sorted.size())), {} });
+    if (sorted.size() < kParallelThreshold) {
+        for (Sweep& c : chunks)
+            sweep(c);
+    } else {
+        QtConcurrent::blockingMap(chunks, sweep);
+    }
+
+    QVector<Pair> pairs;
+    for (const Sweep& c : chunks)
+        pairs += c.pairs;
+    std::sort(pairs.begin(), pairs.end(), pairLess);
+    return pairs;
+}
+
+// ---------------- Перетаскивание ----------------
+
+OverlapTracker::OverlapTracker(const GraphicModel* model)
+    : model(model)
+    , maxWidth(0)
+{ }
+
+void OverlapTracker::begin(const QList<Shape*>& shapes) {
+    moving = shapes;
+    gathered = QRectF();
+    statics.clear();
+    hits.clear();
+}
+
+void OverlapTracker::end() {
+    moving.clear();
+    gathered = QRectF();
+    statics.clear();
+    hits.clear();
+}
+
+bool OverlapTracker::isActive() const {
+    return !moving.isEmpty();
+}
+
+const QSet<Shape*>& OverlapTracker::colliding() const {
+    return hits;
+}
+
+void OverlapTracker::gather(const QRectF& area) {
+    const QSet<Shape*> skip(moving.begin(), moving.end());
+    statics.clear();
+    maxWidth = 0;
+    for (Shape* s : model->shapesIn(area)) {
+        if (skip.contains(s))
+            continue;
+        statics.append(ShapeOverlap::geometryOf(s));
+        maxWidth = qMax(maxWidth, statics.last().box.width());
+    }
+    std::sort(statics.begin(), statics.end(), leftLess);
+    gathered = area;
+}
+
+const QSet<Shape*>& OverlapTracker::update() {
+    hits.clear();
+    if (moving.isEmpty())
+        return hits;
+
+    QVector<ShapeOverlap::Geometry> movers;
+    movers.reserve(moving.size());
+    QRectF reach;
+    for (Shape* s : moving) {
+        movers.append(ShapeOverlap::geometryOf(s));
+        reach |= movers.last().box;
+    }
+    // Соседи пересобираются, только когда движущиеся выходят из собранной области
+    if (gathered.isNull() || !gathered.contains(reach)) {
+        const qreal mx = qMax(kGatherMinMargin, reach.width() * kGatherMargin);
+        const qreal my = qMax(kGatherMinMargin, reach.height() * kGatherMargin);
+        gather(reach.adjusted(-mx, -my, mx, my));
+    }
+
+    // Развёртка по x: окно соседей с левым краем в [left - maxWidth, right]
+    for (const ShapeOverlap::Geometry& m : movers) {
+        ShapeOverlap::Geometry probe;
+        probe.box = QRectF(m.box.left() - maxWidth, 0, 0, 0);
+        auto it = std::lower_bound(statics.constBegin(), statics.constEnd(), probe, leftLess);
+        for (; it != statics.constEnd() && it->box.left() <= m.box.right(); ++it) {
+            if (boxesOverlap(m.box, it->box) && overlapsExact(m, *it)) {
+                hits.insert(m.shape);
+                hits.insert(it->shape);
+            }
+        }
+    }
+    return hits;
+}
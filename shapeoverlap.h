@@ -0,0 +1,78 @@
+// shapeoverlap.h
+#ifndef SHAPEOVERLAP_H
+#define SHAPEOVERLAP_H
+
+#include <QList>
+#include <QPair>
+#include <QPolygonF>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+#include "shape.h"
+
+class GraphicModel;
+
+// Пересечения фигур: грубый отбор по габаритам (sweep-and-prune по оси x),
+// затем точная проверка по типам. Прямоугольник, текст, изображение и звезда —
+// многоугольники, эллипс — эллипс, линия и путь — ломаные; фигуры считаются
+// залитыми, т.е. фигура внутри эллипса или звезды тоже пересекается с ними.
+// Геометрия снимается с фигур в GUI-потоке, дальше считается без них —
+// поиск всех пар раздаётся пулу потоков (QtConcurrent).
+class ShapeOverlap {
+public:
+    typedef QPair<Shape*, Shape*> Pair;
+
+    // Форма фигуры в координатах сцены для точной проверки
+    struct Geometry {
+        enum Kind { Polygon, Polyline, Ellipse };
+
+        Shape*    shape = nullptr;
+        Kind      kind  = Polygon;
+        QRectF    box;              // габариты контура (без пера)
+        QPolygonF points;           // вершины многоугольника или ломаной
+        QPointF   center;           // у эллипса
+        qreal     rx = 0;
+        qreal     ry = 0;
+    };
+
+    // Только GUI-поток (ломаная пути берётся из кэша фигуры)
+    static Geometry geometryOf(Shape* shape);
+    static bool     intersects(const Geometry& a, const Geometry& b);
+    static bool     intersects(Shape* a, Shape* b);
+
+    // Фигуры модели (видимых незаблокированных слоёв), пересекающие shape, снизу вверх;
+    // кандидаты — из сетки модели
+    static QList<Shape*> overlapping(const GraphicModel* model, Shape* shape);
+
+    // Все пересекающиеся пары; пары упорядочены по id фигур
+    static QVector<Pair> allPairs(const QList<Shape*>& shapes);
+};
+
+// Пересечения при перетаскивании: перепроверяются только движущиеся фигуры.
+// Неподвижные соседи собираются из сетки модели с запасом вокруг движущихся
+// и сортируются по x один раз — пока фигуры не вышли из запаса, кадр стоит
+// O(движущихся × соседей в окне развёртки)
+class OverlapTracker {
+public:
+    explicit OverlapTracker(const GraphicModel* model);
+
+    void begin(const QList<Shape*>& moving);
+    // Перепроверить движущиеся фигуры; вернуть все фигуры, участвующие в пересечениях
+    const QSet<Shape*>& update();
+    void end();
+
+    bool isActive() const;
+    const QSet<Shape*>& colliding() const;
+
+private:
+    void gather(const QRectF& area);
+
+    const GraphicModel*                model;
+    QList<Shape*>                      moving;
+    QRectF                             gathered;   // область, по которой собраны соседи
+    QVector<ShapeOverlap::Geometry>    statics;    // соседи по возрастанию левого края
+    qreal                              maxWidth;   // самый широкий сосед: окно развёртки
+    QSet<Shape*>                       hits;
+};
+
+#endif // SHAPEOVERLAP_H
@@ -0,0 +1,120 @@
+// shapeselection.cpp
+#include "shapeselection.h"
+#include "shapegrid.h"
+#include <QPainterPath>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+// a \ b в виде не более чем четырёх прямоугольников
+void subtractRect(const QRectF& a, const QRectF& b, QVector<QRectF>* out) {
+    if (a.isEmpty())
+        return;
+    const QRectF i = a.intersected(b);
+    if (i.isEmpty()) {
+        out->append(a);
+        return;
+    }
+    if (i.top() > a.top())
+        out->append(QRectF(a.left(), a.top(), a.width(), i.top() - a.top()));
+    if (i.bottom() < a.bottom())
+        out->append(QRectF(a.left(), i.bottom(), a.width(), a.bottom() - i.bottom()));
+    if (i.left() > a.left())
+        out->append(QRectF(a.left(), i.top(), i.left() - a.left(), i.height()));
+    if (i.right() < a.right())
+        out->append(QRectF(i.right(), i.top(), a.right() - i.right(), i.height()));
+}
+
+bool intersectsBand(const Shape* s, const QRectF& band) {
+    const QRectF br = s->sceneBoundingRect();
+    if (!band.intersects(br))
+        return false;
+    if (band.contains(br))
+        return true;
+    QPainterPath path;
+    path.addRect(band);
+    return s->collidesWithPath(s->mapFromScene(path), Qt::IntersectsItemShape);
+}
+
+} // namespace
+
+ShapeSelection::ShapeSelection(const ShapeGrid* grid, QObject* parent)
+    : QObject(parent)
+    , grid(grid)
+    , notifyPending(false)
+{ }
+
+void ShapeSelection::insert(Shape* s) {
+    if (!selected.contains(s)) {
+        selected.insert(s);
+        notify();
+    }
+}
+
+void ShapeSelection::remove(Shape* s) {
+    if (selected.remove(s))
+        notify();
+}
+
+void ShapeSelection::clear() {
+    if (!selected.isEmpty()) {
+        selected.clear();
+        notify();
+    }
+}
+
+void ShapeSelection::swap(QSet<Shape*>& other) {
+    if (selected.isEmpty() && other.isEmpty())
+        return;
+    selected.swap(other);
+    notify();
+}
+
+bool ShapeSelection::contains(Shape* s) const {
+    return selected.contains(s);
+}
+
+int ShapeSelection::count() const {
+    return selected.size();
+}
+
+bool ShapeSelection::isEmpty() const {
+    return selected.isEmpty();
+}
+
+QList<Shape*> ShapeSelection::shapes() const {
+    QList<Shape*> list(selected.begin(), selected.end());
+    std::sort(list.begin(), list.end(), [](const Shape* a, const Shape* b) {
+        return a->getId() < b->getId();
+    });
+    return list;
+}
+
+void ShapeSelection::updateRubberBand(const QRectF& oldRect, const QRectF& newRect) {
+    QVector<QRectF> delta;
+    subtractRect(oldRect, newRect, &delta);
+    subtractRect(newRect, oldRect, &delta);
+
+    QSet<Shape*> visited;
+    for (const QRectF& strip : delta) {
+        for (Shape* s : grid->query(strip)) {
+            if (visited.contains(s))
+                continue;
+            visited.insert(s);
+            const bool inside = intersectsBand(s, newRect);
+            if (s->isSelected() != inside)
+                s->setSelected(inside); // вернётся в insert()/remove() через модель
+        }
+    }
+}
+
+void ShapeSelection::notify() {
+    if (notifyPending)
+        return;
+    notifyPending = true;
+    QMetaObject::invokeMethod(this, [this] {
+        notifyPending = false;
+        emit selectionChanged();
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,50 @@
+// shapeselection.h
+#ifndef SHAPESELECTION_H
+#define SHAPESELECTION_H
+
+#include <QObject>
+#include <QSet>
+#include <QList>
+#include <QRectF>
+#include "shape.h"
+
+class ShapeGrid;
+
+// Множество выделенных фигур, которое ведёт модель.
+// Обход — O(выделенных), об изменениях сообщается одним сигналом за итерацию цикла событий.
+class ShapeSelection : public QObject {
+    Q_OBJECT
+public:
+    explicit ShapeSelection(const ShapeGrid* grid, QObject* parent = nullptr);
+
+    // Вызываются моделью при смене флага выделения и при удалении фигур
+    void insert(Shape* shape);
+    void remove(Shape* shape);
+    void clear();
+    // Подменить множество целиком (смена документа): O(1), одно уведомление
+    void swap(QSet<Shape*>& other);
+
+    bool contains(Shape* shape) const;
+    int  count() const;
+    bool isEmpty() const;
+
+    const QSet<Shape*>& set() const { return selected; }
+    // Выделенные фигуры в порядке id — для детерминированного порядка команд
+    QList<Shape*>       shapes() const;
+
+    // Резиновая рамка: перепроверяются только фигуры из разности старой и новой рамки
+    // (по сетке модели — фигуры, снятые со сцены виртуализацией, тоже выделяются)
+    void updateRubberBand(const QRectF& oldRect, const QRectF& newRect);
+
+signals:
+    void selectionChanged();
+
+private:
+    void notify();
+
+    const ShapeGrid* grid;    // живые фигуры модели, в том числе вне сцены
+    QSet<Shape*>    selected;
+    bool            notifyPending;
+};
+
+#endif // SHAPESELECTION_H
@@ -0,0 +1,139 @@
+// tst_bezierpath.cpp
+#include <QtTest>
+#include <QtMath>
+#include "bezierpath.h"
+
+namespace {
+
+QPointF quadAt(const QPointF& p0, const QPointF& p1, const QPointF& p2, qreal t) {
+    const qreal u = 1 - t;
+    return u * u * p0 + 2 * u * t * p1 + t * t * p2;
+}
+
+QPointF cubicAt(const QPointF& p0, const QPointF& p1, const QPointF& p2, const QPointF& p3, qreal t) {
+    const qreal u = 1 - t;
+    return u * u * u * p0 + 3 * u * u * t * p1 + 3 * u * t * t * p2 + t * t * t * p3;
+}
+
+qreal distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b) {
+    const QPointF d = b - a;
+    const qreal len2 = QPointF::dotProduct(d, d);
+    const qreal t = len2 > 0 ? qBound<qreal>(0, QPointF::dotProduct(p - a, d) / len2, 1) : 0;
+    const QPointF q = a + d * t;
+    return qSqrt(QPointF::dotProduct(p - q, p - q));
+}
+
+// Зигзаг от руки: точки штриха, как их отдаёт мышь
+QPolygonF stroke(int count) {
+    QPolygonF pts;
+    for (int i = 0; i < count; ++i)
+        pts << QPointF(i * 7.0, (i % 2 ? 12.0 : -5.0) + i * 0.5);
+    return pts;
+}
+
+} // namespace
+
+class TestBezierPath : public QObject {
+    Q_OBJECT
+
+private slots:
+    void flattenStraightSegment();
+    void flattenQuadraticWithinTolerance_data();
+    void flattenQuadraticWithinTolerance();
+    void flattenCubicWithinTolerance();
+    void flattenCoarserToleranceGivesFewerPoints();
+    void extendSmoothedMatchesSmoothed();
+    void extendSmoothedKeepsFinishedSegments();
+};
+
+void TestBezierPath::flattenStraightSegment() {
+    // Вырожденная кривая — отрезок: хватает концов
+    BezierPath p(QPointF(0, 0));
+    p.quadTo(QPointF(5, 0), QPointF(10, 0));
+    const QPolygonF poly = p.flatten(0.25);
+    QCOMPARE(int(poly.size()), 2);
+    QCOMPARE(poly.first(), QPointF(0, 0));
+    QCOMPARE(poly.last(), QPointF(10, 0));
+}
+
+void TestBezierPath::flattenQuadraticWithinTolerance_data() {
+    QTest::addColumn<qreal>("tolerance");
+    QTest::newRow("0.1") << qreal(0.1);
+    QTest::newRow("1")   << qreal(1.0);
+    QTest::newRow("4")   << qreal(4.0);
+}
+
+void TestBezierPath::flattenQuadraticWithinTolerance() {
+    QFETCH(qreal, tolerance);
+    const QPointF p0(0, 0), p1(50, 100), p2(100, 0);
+    BezierPath p(p0);
+    p.quadTo(p1, p2);
+
+    // Деление равномерное по t: точка i — это t = i / n
+    const QPolygonF poly = p.flatten(tolerance);
+    const int n = int(poly.size()) - 1;
+    QVERIFY(n >= 1);
+    QCOMPARE(poly.last(), p2);
+    for (int i = 1; i <= n; ++i) {
+        // Середина дуги между соседними точками — дальше всего от хорды
+        const QPointF mid = quadAt(p0, p1, p2, (i - 0.5) / n);
+        QVERIFY(distanceToSegment(mid, poly.at(i - 1), poly.at(i)) <= tolerance);
+    }
+}
+
+void TestBezierPath::flattenCubicWithinTolerance() {
+    const qreal tolerance = 0.5;
+    const BezierPath p = BezierPath::sCurve().mapped(QRectF(0, 0, 300, 200));
+    QCOMPARE(int(p.segments().size()), 1);
+    const BezierSegment& s = p.segments().first();
+
+    const QPolygonF poly = p.flatten(tolerance);
+    const int n = int(poly.size()) - 1;
+    QVERIFY(n > 1);
+    QCOMPARE(poly.first(), p.start());
+    QCOMPARE(poly.last(), s.end);
+    // Проверяем по нескольку точек дуги на каждом шаге
+    for (int i = 1; i <= n; ++i)
+        for (int k = 1; k < 4; ++k) {
+            const QPointF on = cubicAt(p.start(), s.c1, s.c2, s.end, (i - 1 + k / 4.0) / n);
+            QVERIFY(distanceToSegment(on, poly.at(i - 1), poly.at(i)) <= tolerance);
+        }
+}
+
+void TestBezierPath::flattenCoarserToleranceGivesFewerPoints() {
+    const BezierPath p = BezierPath::smoothed(stroke(20));
+    const int fine   = int(p.flatten(0.1).size());
+    const int coarse = int(p.flatten(4.0).size());
+    QVERIFY(coarse < fine);
+    // Каждый сегмент даёт хотя бы одну точку
+    QVERIFY(coarse >= int(p.segments().size()) + 1);
+}
+
+void TestBezierPath::extendSmoothedMatchesSmoothed() {
+    // Путь, продолженный точка за точкой, совпадает с построенным по всей ломаной
+    const QPolygonF all = stroke(16);
+    BezierPath incremental;
+    QPolygonF pts;
+    for (const QPointF& pt : all) {
+        pts << pt;
+        incremental.extendSmoothed(pts);
+        QVERIFY2(incremental == BezierPath::smoothed(pts),
+                 qPrintable(QString("after %1 points").arg(pts.size())));
+    }
+}
+
+void TestBezierPath::extendSmoothedKeepsFinishedSegments() {
+    const QPolygonF all = stroke(10);
+    BezierPath p = BezierPath::smoothed(QPolygonF(all.mid(0, 6)));
+    const QVector<BezierSegment> before = p.segments();
+
+    p.extendSmoothed(QPolygonF(all.mid(0, 7)));
+    QCOMPARE(p.segments().size(), before.size() + 1);
+    // Все сегменты, кроме последнего прежнего, не меняются
+    for (int i = 0; i + 1 < before.size(); ++i)
+        QVERIFY(p.segments().at(i) == before.at(i));
+    QCOMPARE(p.segments().last().end, all.at(6));
+}
+
+QTEST_MAIN(TestBezierPath)
+#include "tst_bezierpath.moc"
@@ -0,0 +1,143 @@
+// tst_memorypool.cpp
+#include <QtTest>
+#include <QSet>
+#include <QVector>
+#include <cstddef>
+#include <cstring>
+#include "memorypool.h"
+
+class TestMemoryPool : public QObject {
+    Q_OBJECT
+
+private slots:
+    void freedBlockIsReused();
+    void blocksAreAlignedAndDisjoint();
+    void sizeClassesUseSeparateSlabs();
+    void fullSlabReturnsToPartialOnFree();
+    void statsAndTrim();
+    void largeBlocksBypassSlabs();
+};
+
+void TestMemoryPool::freedBlockIsReused() {
+    MemoryPool pool("test");
+    void* a = pool.allocate(40);
+    pool.deallocate(a, 40);
+    // Список свободных — стек: освобождённый блок выдаётся первым
+    QCOMPARE(pool.allocate(40), a);
+    QCOMPARE(pool.stats().slabs, qint64(1));
+    pool.deallocate(a, 40);
+}
+
+void TestMemoryPool::blocksAreAlignedAndDisjoint() {
+    MemoryPool pool("test");
+    const std::size_t size = 48;
+    QVector<void*> blocks;
+    QSet<quintptr> seen;
+    for (int i = 0; i < 3000; ++i) {
+        void* p = pool.allocate(size);
+        QVERIFY(p);
+        // Не хуже, чем у operator new: слэб от него, а шаг блоков кратен 16
+        QVERIFY(quintptr(p) % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+        QVERIFY(!seen.contains(quintptr(p)));
+        seen.insert(quintptr(p));
+        std::memset(p, i & 0xff, size);
+        blocks.append(p);
+    }
+    // Блоки не перекрываются: каждый хранит то, что в него записали
+    for (int i = 0; i < blocks.size(); ++i) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(blocks.at(i));
+        for (std::size_t k = 0; k < size; ++k)
+            QCOMPARE(int(bytes[k]), i & 0xff);
+    }
+    for (void* p : blocks)
+        pool.deallocate(p, size);
+}
+
+void TestMemoryPool::sizeClassesUseSeparateSlabs() {
+    MemoryPool pool("test");
+    void* small = pool.allocate(16);
+    void* large = pool.allocate(100);
+    QCOMPARE(pool.stats().slabs, qint64(2));
+    // Тот же размерный класс (округление до 16 байт) — тот же слэб
+    void* similar = pool.allocate(12);
+    QCOMPARE(pool.stats().slabs, qint64(2));
+    pool.deallocate(small, 16);
+    pool.deallocate(large, 100);
+    pool.deallocate(similar, 12);
+}
+
+void TestMemoryPool::fullSlabReturnsToPartialOnFree() {
+    MemoryPool pool("test");
+    const std::size_t size = 64;
+    QVector<void*> blocks;
+    for (int i = 0; i < 2000; ++i)
+        blocks.append(pool.allocate(size));
+    const qint64 slabs = pool.stats().slabs;
+    QVERIFY(slabs > 1);
+
+    // Первый слэб заполнен; после освобождения блока в нём новый блок берётся
+    // из него, а не из нового слэба
+    void* freed = blocks.at(10);
+    pool.deallocate(freed, size);
+    void* again = pool.allocate(size);
+    QCOMPARE(again, freed);
+    QCOMPARE(pool.stats().slabs, slabs);
+
+    for (void* p : blocks)
+        pool.deallocate(p, size);
+}
+
+void TestMemoryPool::statsAndTrim() {
+    MemoryPool pool("test");
+    const std::size_t size = 64;
+    const int count = 2000;
+    QVector<void*> blocks;
+    for (int i = 0; i < count; ++i)
+        blocks.append(pool.allocate(size));
+
+    MemoryPool::Stats s = pool.stats();
+    QCOMPARE(s.liveObjects, qint64(count));
+    QCOMPARE(s.bytesInUse, qint64(count) * qint64(size));
+    QVERIFY(s.bytesReserved >= s.bytesInUse);
+    QVERIFY(s.fragmentation() >= 0.0 && s.fragmentation() < 1.0);
+
+    // Половина свободна: слэбы остаются за пулом до trim()
+    for (int i = 0; i < count; i += 2)
+        pool.deallocate(blocks.at(i), size);
+    QCOMPARE(pool.stats().liveObjects, qint64(count / 2));
+    QCOMPARE(pool.stats().slabs, s.slabs);
+    pool.trim();
+    QCOMPARE(pool.stats().slabs, s.slabs);   // пустых слэбов ещё нет
+
+    for (int i = 1; i < count; i += 2)
+        pool.deallocate(blocks.at(i), size);
+    s = pool.stats();
+    QCOMPARE(s.liveObjects, qint64(0));
+    QCOMPARE(s.bytesInUse, qint64(0));
+    QVERIFY(s.slabs > 0);
+
+    pool.trim();
+    s = pool.stats();
+    QCOMPARE(s.slabs, qint64(0));
+    QCOMPARE(s.bytesReserved, qint64(0));
+
+    // После trim() пул снова выдаёт память
+    void* p = pool.allocate(size);
+    QVERIFY(p);
+    QCOMPARE(pool.stats().slabs, qint64(1));
+    pool.deallocate(p, size);
+}
+
+void TestMemoryPool::largeBlocksBypassSlabs() {
+    MemoryPool pool("test");
+    void* p = pool.allocate(4096);
+    QVERIFY(p);
+    QCOMPARE(pool.stats().slabs, qint64(0));
+    QCOMPARE(pool.stats().bytesReserved, qint64(4096));
+    pool.deallocate(p, 4096);
+    QCOMPARE(pool.stats().bytesReserved, qint64(0));
+    QCOMPARE(pool.stats().liveObjects, qint64(0));
+}
+
+QTEST_MAIN(TestMemoryPool)
+#include "tst_memorypool.moc"
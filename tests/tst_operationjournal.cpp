@@ -0,0 +1,188 @@
+// tst_operationjournal.cpp
+#include <QtTest>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include "graphicmodel.h"
+#include "operationjournal.h"
+
+namespace {
+
+const qint64 kRecordHeader = 6;   // quint32 длина + quint16 crc
+const qint64 kIdOffset     = 9;   // в данных записи: quint64 seq, quint8 операция, затем id
+
+QString journalPath(const QTemporaryDir& dir) {
+    return dir.path() + "/document.journal";
+}
+
+qint64 journalSize(const QTemporaryDir& dir) {
+    return QFileInfo(journalPath(dir)).size();
+}
+
+// Дописать в журнал добавление фигур отдельным сеансом, как после перезапуска:
+// восстановление продолжает нумерацию записей, деструктор дописывает хвост
+void appendShapes(const QTemporaryDir& dir, const QList<Shape*>& shapes) {
+    GraphicModel scratch;
+    OperationJournal journal(dir.path());
+    journal.recover(&scratch);
+    for (Shape* s : shapes)
+        journal.recordAdd(s);
+}
+
+void recover(const QTemporaryDir& dir, GraphicModel* model) {
+    OperationJournal journal(dir.path());
+    journal.recover(model);
+}
+
+void patchByte(const QTemporaryDir& dir, qint64 offset) {
+    QFile f(journalPath(dir));
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    QVERIFY(f.seek(offset));
+    char c = 0;
+    QVERIFY(f.getChar(&c));
+    QVERIFY(f.seek(offset));
+    QVERIFY(f.putChar(char(c ^ 0x5a)));
+}
+
+} // namespace
+
+class TestOperationJournal : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void recoversEveryRecord();
+    void truncatedRecordIsDropped();
+    void corruptPayloadIsDropped();
+    void corruptLengthIsDropped();
+    void recordsAfterCorruptionAreIgnored();
+    void garbageAfterLastRecordIsCut();
+
+private:
+    void verifyShapes(const GraphicModel& restored, const QList<Shape*>& expected);
+
+    QTemporaryDir* dir;
+    GraphicModel*  source;
+    QList<Shape*>  shapes;
+    qint64         intactSize;   // журнал с первыми двумя фигурами
+    qint64         fullSize;     // и с третьей
+};
+
+// Три фигуры: первые две — одним сеансом, третья — следующим
+void TestOperationJournal::init() {
+    dir    = new QTemporaryDir;
+    QVERIFY(dir->isValid());
+    source = new GraphicModel;
+    shapes.clear();
+    for (int i = 0; i < 3; ++i) {
+        Shape* s = source->addShape(ShapeType::Rectangle, QPointF(i * 40, 10), Qt::red);
+        s->setEndPos(QPointF(i * 40 + 25, 30 + i));
+        s->setPos(i * 3, -i);
+        shapes << s;
+    }
+    appendShapes(*dir, shapes.mid(0, 2));
+    intactSize = journalSize(*dir);
+    appendShapes(*dir, shapes.mid(2));
+    fullSize = journalSize(*dir);
+    QVERIFY(intactSize > 0 && fullSize > intactSize);
+}
+
+void TestOperationJournal::cleanup() {
+    delete source;
+    delete dir;
+}
+
+void TestOperationJournal::verifyShapes(const GraphicModel& restored, const QList<Shape*>& expected) {
+    QCOMPARE(int(restored.getShapes().size()), int(expected.size()));
+    for (const Shape* s : expected) {
+        const Shape* r = restored.shapeById(s->getId());
+        QVERIFY(r);
+        QVERIFY(r->getType() == s->getType());
+        QCOMPARE(r->pos(), s->pos());
+        QCOMPARE(r->getStartPos(), s->getStartPos());
+        QCOMPARE(r->getEndPos(), s->getEndPos());
+        QCOMPARE(r->getColor(), s->getColor());
+    }
+}
+
+void TestOperationJournal::recoversEveryRecord() {
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes);
+    QCOMPARE(journalSize(*dir), fullSize);
+}
+
+void TestOperationJournal::truncatedRecordIsDropped() {
+    // Сбой посреди записи третьей фигуры: заголовок есть, данных не хватает
+    QVERIFY(QFile::resize(journalPath(*dir), intactSize + kRecordHeader + 4));
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes.mid(0, 2));
+    // Оборванный хвост отрезан: следующие записи лягут сразу за целыми
+    QCOMPARE(journalSize(*dir), intactSize);
+}
+
+void TestOperationJournal::corruptPayloadIsDropped() {
+    patchByte(*dir, intactSize + kRecordHeader + kIdOffset);
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes.mid(0, 2));
+    QCOMPARE(journalSize(*dir), intactSize);
+}
+
+void TestOperationJournal::corruptLengthIsDropped() {
+    // Длина на байт короче: данные читаются не целиком, crc длины и данных не сходится
+    QFile f(journalPath(*dir));
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    QVERIFY(f.seek(intactSize));
+    quint32 length = 0;
+    {
+        QDataStream in(&f);
+        in >> length;
+    }
+    QVERIFY(length > 1);
+    QVERIFY(f.seek(intactSize));
+    {
+        QDataStream out(&f);
+        out << quint32(length - 1);
+    }
+    f.close();
+
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes.mid(0, 2));
+    QCOMPARE(journalSize(*dir), intactSize);
+}
+
+void TestOperationJournal::recordsAfterCorruptionAreIgnored() {
+    // За испорченной записью журнала верить нельзя, даже целым записям
+    Shape* fourth = source->addShape(ShapeType::Ellipse, QPointF(200, 200), Qt::blue);
+    fourth->setEndPos(QPointF(260, 240));
+    appendShapes(*dir, QList<Shape*>() << fourth);
+    QVERIFY(journalSize(*dir) > fullSize);
+
+    patchByte(*dir, intactSize + kRecordHeader + kIdOffset);
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes.mid(0, 2));
+    QVERIFY(!restored.shapeById(fourth->getId()));
+    QCOMPARE(journalSize(*dir), intactSize);
+}
+
+void TestOperationJournal::garbageAfterLastRecordIsCut() {
+    {
+        QFile f(journalPath(*dir));
+        QVERIFY(f.open(QIODevice::Append));
+        f.write(QByteArray("\x00\x00\x00\x05\x12", 5));
+    }
+    GraphicModel restored;
+    recover(*dir, &restored);
+    verifyShapes(restored, shapes);
+    QCOMPARE(journalSize(*dir), fullSize);
+}
+
+QTEST_MAIN(TestOperationJournal)
+#include "tst_operationjournal.moc"
@@ -0,0 +1,173 @@
+// tst_shapeoverlap.cpp
+#include <QtTest>
+#include <QRandomGenerator>
+#include <algorithm>
+#include "shapeoverlap.h"
+
+namespace {
+
+typedef ShapeOverlap::Geometry Geometry;
+
+Geometry polygon(const QRectF& r) {
+    Geometry g;
+    g.kind   = Geometry::Polygon;
+    g.points << r.topLeft() << r.topRight() << r.bottomRight() << r.bottomLeft();
+    g.box    = r;
+    return g;
+}
+
+Geometry polyline(const QPolygonF& points) {
+    Geometry g;
+    g.kind   = Geometry::Polyline;
+    g.points = points;
+    g.box    = points.boundingRect();
+    return g;
+}
+
+Geometry ellipse(const QPointF& center, qreal rx, qreal ry) {
+    Geometry g;
+    g.kind   = Geometry::Ellipse;
+    g.center = center;
+    g.rx     = rx;
+    g.ry     = ry;
+    g.box    = QRectF(center.x() - rx, center.y() - ry, 2 * rx, 2 * ry);
+    return g;
+}
+
+Shape* makeShape(ShapeType type, const QPointF& start, const QPointF& end, quint64 id) {
+    Shape* s = new Shape(type, start, Qt::black);
+    s->setEndPos(end);
+    s->setId(id);
+    return s;
+}
+
+} // namespace
+
+Q_DECLARE_METATYPE(ShapeOverlap::Geometry)
+
+class TestShapeOverlap : public QObject {
+    Q_OBJECT
+
+private slots:
+    void narrowPhase_data();
+    void narrowPhase();
+    void shapesUseScenePosition();
+    void allPairsMatchesBruteForce_data();
+    void allPairsMatchesBruteForce();
+};
+
+void TestShapeOverlap::narrowPhase_data() {
+    QTest::addColumn<Geometry>("a");
+    QTest::addColumn<Geometry>("b");
+    QTest::addColumn<bool>("expected");
+
+    const Geometry square = polygon(QRectF(0, 0, 10, 10));
+    QTest::newRow("polygon inside polygon")
+        << square << polygon(QRectF(3, 3, 2, 2)) << true;
+    QTest::newRow("polygons apart")
+        << square << polygon(QRectF(20, 0, 10, 10)) << false;
+    QTest::newRow("polygons share an edge")
+        << square << polygon(QRectF(10, 0, 10, 10)) << true;
+    QTest::newRow("line through polygon, no vertex inside")
+        << square << polyline(QPolygonF() << QPointF(-5, 5) << QPointF(15, 5)) << true;
+    QTest::newRow("polyline inside polygon")
+        << square << polyline(QPolygonF() << QPointF(2, 2) << QPointF(8, 3) << QPointF(4, 7)) << true;
+    QTest::newRow("polylines cross")
+        << polyline(QPolygonF() << QPointF(0, 0) << QPointF(10, 10))
+        << polyline(QPolygonF() << QPointF(0, 10) << QPointF(10, 0)) << true;
+    // Ломаная — не контур: внутренности у неё нет
+    QTest::newRow("polyline around a point")
+        << polyline(QPolygonF() << QPointF(0, 0) << QPointF(10, 0) << QPointF(10, 10) << QPointF(0, 10))
+        << polyline(QPolygonF() << QPointF(4, 4) << QPointF(6, 6)) << false;
+
+    // Габариты пересекаются, а сами фигуры — нет: угол квадрата за пределами круга
+    const Geometry circle = ellipse(QPointF(0, 0), 10, 10);
+    QTest::newRow("square in circle's box corner")
+        << circle << polygon(QRectF(8, 8, 4, 4)) << false;
+    QTest::newRow("square overlapping circle")
+        << circle << polygon(QRectF(6, 6, 4, 4)) << true;
+    QTest::newRow("circle inside polygon")
+        << ellipse(QPointF(50, 50), 5, 5) << polygon(QRectF(0, 0, 100, 100)) << true;
+    QTest::newRow("polygon inside circle")
+        << circle << polygon(QRectF(-1, -1, 2, 2)) << true;
+    QTest::newRow("chord outside circle")
+        << circle << polyline(QPolygonF() << QPointF(9, 10) << QPointF(10, 9)) << false;
+    QTest::newRow("circles apart")
+        << circle << ellipse(QPointF(25, 0), 10, 10) << false;
+    QTest::newRow("circles overlap")
+        << circle << ellipse(QPointF(19, 0), 10, 10) << true;
+    QTest::newRow("flat ellipses side by side")
+        << ellipse(QPointF(0, 0), 10, 2) << ellipse(QPointF(0, 5), 10, 2) << false;
+}
+
+void TestShapeOverlap::narrowPhase() {
+    QFETCH(Geometry, a);
+    QFETCH(Geometry, b);
+    QFETCH(bool, expected);
+    QCOMPARE(ShapeOverlap::intersects(a, b), expected);
+    QCOMPARE(ShapeOverlap::intersects(b, a), expected);
+}
+
+void TestShapeOverlap::shapesUseScenePosition() {
+    // Контур прямоугольника — с запасом 10 вокруг точек: (-10, -10) — (30, 30)
+    Shape* a = makeShape(ShapeType::Rectangle, QPointF(0, 0), QPointF(20, 20), 1);
+    Shape* b = makeShape(ShapeType::Rectangle, QPointF(0, 0), QPointF(20, 20), 2);
+    b->setPos(25, 0);
+    QVERIFY(ShapeOverlap::intersects(a, b));
+    b->setPos(100, 0);
+    QVERIFY(!ShapeOverlap::intersects(a, b));
+    a->setPos(80, 0);
+    QVERIFY(ShapeOverlap::intersects(a, b));
+    delete a;
+    delete b;
+}
+
+void TestShapeOverlap::allPairsMatchesBruteForce_data() {
+    QTest::addColumn<int>("count");
+    QTest::newRow("sequential") << 300;
+    QTest::newRow("thread pool") << 1500;   // больше порога раздачи пулу потоков
+}
+
+void TestShapeOverlap::allPairsMatchesBruteForce() {
+    QFETCH(int, count);
+    QRandomGenerator rng(42);
+    const ShapeType types[] = { ShapeType::Line, ShapeType::Rectangle, ShapeType::Ellipse,
+                                ShapeType::Star };
+    QList<Shape*> shapes;
+    for (int i = 0; i < count; ++i) {
+        const QPointF start(rng.bounded(2000.0), rng.bounded(2000.0));
+        const QPointF size(5 + rng.bounded(80.0), 5 + rng.bounded(80.0));
+        // id не по порядку создания: пары упорядочиваются по id, а не по адресам
+        shapes << makeShape(types[i % 4], start, start + size, quint64(count - i));
+    }
+
+    const QVector<ShapeOverlap::Pair> pairs = ShapeOverlap::allPairs(shapes);
+
+    // Эталон: каждая пара фигур напрямую, без развёртки
+    QVector<Geometry> geometry;
+    for (Shape* s : shapes)
+        geometry << ShapeOverlap::geometryOf(s);
+    QVector<ShapeOverlap::Pair> expected;
+    for (int i = 0; i < shapes.size(); ++i)
+        for (int j = i + 1; j < shapes.size(); ++j) {
+            if (!ShapeOverlap::intersects(geometry.at(i), geometry.at(j)))
+                continue;
+            Shape* a = shapes.at(i);
+            Shape* b = shapes.at(j);
+            expected << (a->getId() < b->getId() ? qMakePair(a, b) : qMakePair(b, a));
+        }
+    std::sort(expected.begin(), expected.end(),
+              [](const ShapeOverlap::Pair& x, const ShapeOverlap::Pair& y) {
+                  if (x.first->getId() != y.first->getId())
+                      return x.first->getId() < y.first->getId();
+                  return x.second->getId() < y.second->getId();
+              });
+
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(int(pairs.size()), int(expected.size()));
+    QVERIFY(pairs == expected);
+    qDeleteAll(shapes);
+}
+
+QTEST_MAIN(TestShapeOverlap)
+#include "tst_shapeoverlap.moc"
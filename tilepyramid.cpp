@@ -0,0 +1,461 @@
+// tilepyramid.cpp
+#include "tilepyramid.h"
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGraphicsScene>
+#include <QHash>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPaintDevice>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QWeakPointer>
+#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int     kTileSize    = 256;
+const qint64  kTileBytes   = qint64(kTileSize) * kTileSize * 4;
+const int     kCacheKb     = 64 * 1024;              // отображённых плиток на все пирамиды
+const qint64  kStripBytes  = 256LL * 1024 * 1024;    // полоса декодирования уровня 0
+const quint32 kMetaMagic   = 0x54505952;             // 'TPYR'
+const quint16 kMetaVersion = 1;
+
+QSize levelSize(const QSize& base, int level) {
+    const int step = 1 << level;
+    return QSize(qMax(1, (base.width()  + step - 1) / step),
+                 qMax(1, (base.height() + step - 1) / step));
+}
+
+int tilesAcross(int pixels) {
+    return (pixels + kTileSize - 1) / kTileSize;
+}
+
+// Уровни до первого, который целиком помещается в одну плитку
+int levelsFor(const QSize& base) {
+    int n = 1;
+    while (levelSize(base, n - 1).width() > kTileSize || levelSize(base, n - 1).height() > kTileSize)
+        ++n;
+    return n;
+}
+
+QString levelFileName(const QString& dir, int level) {
+    return dir + QString("/level%1.raw").arg(level);
+}
+
+QString cacheDirFor(const QString& sourcePath) {
+    const QFileInfo fi(sourcePath);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fi.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(fi.size()));
+    hash.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+         + "/tiles/" + QString::fromLatin1(hash.result().toHex());
+}
+
+// Наши полосы ограничены kStripBytes, а встроенный в Qt 6 предел в 128 МБ
+// отказал бы уже заголовку скана
+void allowLargeImages(QImageReader& reader) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    reader.setAllocationLimit(0);
+#else
+    Q_UNUSED(reader);
+#endif
+}
+
+bool metaMatches(const QString& dir, const QSize& size, int levels) {
+    QFile f(dir + "/meta");
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&f);
+    quint32 magic = 0;
+    quint16 version = 0;
+    QSize   s;
+    qint32  tileSize = 0, n = 0;
+    in >> magic >> version >> s >> tileSize >> n;
+    return in.status() == QDataStream::Ok && magic == kMetaMagic && version == kMetaVersion
+        && s == size && tileSize == kTileSize && n == levels;
+}
+
+// Полоса изображения во всю ширину — ряды плиток по порядку; неполные плитки
+// на краях дополняются прозрачным
+bool writeTileRows(QFile& out, const QImage& image) {
+    QImage tile(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+    const int columns = tilesAcross(image.width());
+    for (int ty = 0; ty < image.height(); ty += kTileSize) {
+        const int h = qMin(kTileSize, image.height() - ty);
+        for (int tx = 0; tx < columns; ++tx) {
+            const int w = qMin(kTileSize, image.width() - tx * kTileSize);
+            tile.fill(Qt::transparent);
+            for (int y = 0; y < h; ++y)
+                std::memcpy(tile.scanLine(y),
+                            image.constScanLine(ty + y) + tx * kTileSize * 4, size_t(w) * 4);
+            if (out.write(reinterpret_cast<const char*>(tile.constBits()), kTileBytes) != kTileBytes)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Уровень 0 декодируется полосами через ClipRect, если формат это умеет
+// (JPEG, TIFF); иначе файл декодируется целиком один раз
+bool buildBaseLevel(const QString& source, const QString& dir, const QSize& size) {
+    QFile out(levelFileName(dir, 0));
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QImageReader probe(source);
+    allowLargeImages(probe);
+    if (!probe.supportsOption(QImageIOHandler::ClipRect)) {
+        const QImage whole = probe.read().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        return !whole.isNull() && writeTileRows(out, whole);
+    }
+
+    const int columns   = tilesAcross(size.width());
+    const int stripRows = int(qMax<qint64>(1, kStripBytes / (qint64(columns) * kTileBytes)));
+    for (int y = 0; y < size.height(); y += stripRows * kTileSize) {
+        QImageReader reader(source);
+        allowLargeImages(reader);
+        reader.setClipRect(QRect(0, y, size.width(), qMin(stripRows * kTileSize, size.height() - y)));
+        const QImage strip = reader.read().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        if (strip.isNull() || !writeTileRows(out, strip))
+            return false;
+    }
+    return true;
+}
+
+// Плитка уровня — четыре дочерние плитки предыдущего уровня, уменьшенные вдвое
+bool buildLevel(const QString& dir, const QSize& base, int level) {
+    QFile in(levelFileName(dir, level - 1));
+    QFile out(levelFileName(dir, level));
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const QSize parent  = levelSize(base, level - 1);
+    const QSize current = levelSize(base, level);
+    const int   pcols   = tilesAcross(parent.width());
+    const int   prows   = tilesAcross(parent.height());
+
+    QImage quad (2 * kTileSize, 2 * kTileSize, QImage::Format_ARGB32_Premultiplied);
+    QImage child(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+    for (int ty = 0; ty < tilesAcross(current.height()); ++ty) {
+        for (int tx = 0; tx < tilesAcross(current.width()); ++tx) {
+            quad.fill(Qt::transparent);
+            for (int q = 0; q < 4; ++q) {
+                const int cx = 2 * tx + (q & 1);
+                const int cy = 2 * ty + (q >> 1);
+                if (cx >= pcols || cy >= prows)
+                    continue;
+                if (!in.seek((qint64(cy) * pcols + cx) * kTileBytes)
+                    || in.read(reinterpret_cast<char*>(child.bits()), kTileBytes) != kTileBytes)
+                    return false;
+                for (int y = 0; y < kTileSize; ++y)
+                    std::memcpy(quad.scanLine((q >> 1) * kTileSize + y) + (q & 1) * kTileSize * 4,
+                                child.constScanLine(y), size_t(kTileSize) * 4);
+            }
+            const QImage tile = quad.scaled(kTileSize, kTileSize, Qt::IgnoreAspectRatio,
+                                            Qt::SmoothTransformation)
+                                    .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            if (out.write(reinterpret_cast<const char*>(tile.constBits()), kTileBytes) != kTileBytes)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Фоновая сборка; метаданные пишутся последними — по ним видно, что пирамида полная
+bool buildPyramid(const QString& source, const QString& dir, const QSize& size) {
+    if (!QDir().mkpath(dir))
+        return false;
+    QFile::remove(dir + "/meta");
+    if (!buildBaseLevel(source, dir, size))
+        return false;
+    const int levels = levelsFor(size);
+    for (int level = 1; level < levels; ++level)
+        if (!buildLevel(dir, size, level))
+            return false;
+
+    QSaveFile meta(dir + "/meta");
+    if (!meta.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream out(&meta);
+    out << kMetaMagic << kMetaVersion << size << qint32(kTileSize) << qint32(levels);
+    return meta.commit();
+}
+
+// Общий реестр пирамид по пути и общий кэш плиток. Пирамиду может освободить
+// фоновый поток (экспорт держит снимок), поэтому доступ — под мьютексами
+QMutex& registryMutex() {
+    static QMutex m;
+    return m;
+}
+
+QHash<QString, QWeakPointer<TilePyramid>>& registry() {
+    static QHash<QString, QWeakPointer<TilePyramid>> r;
+    return r;
+}
+
+QMutex& cacheMutex() {
+    static QMutex m;
+    return m;
+}
+
+std::atomic<quint64> g_nextSerial(1);
+
+// Ключ плитки: пирамида, уровень, ряд, столбец
+quint64 tileKey(quint64 serial, int level, int tx, int ty) {
+    return (serial << 40) | (quint64(level) << 32) | (quint64(ty) << 16) | quint64(tx);
+}
+
+// Плитка, отображённая в память; QImage смотрит прямо в отображение, без копии
+struct MappedTile {
+    MappedTile(QFile* file, uchar* memory)
+        : file(file), memory(memory)
+        , image(static_cast<const uchar*>(memory), kTileSize, kTileSize, kTileSize * 4,
+                QImage::Format_ARGB32_Premultiplied)
+    { }
+    ~MappedTile() { file->unmap(memory); }
+
+    QFile* file;
+    uchar* memory;
+    QImage image;
+};
+
+// Вытеснение из кэша снимает отображение плитки
+QCache<quint64, MappedTile>& tileCache() {
+    static QCache<quint64, MappedTile> cache(kCacheKb);
+    return cache;
+}
+
+} // namespace
+
+TilePyramid::TilePyramid(const QString& path)
+    : sourcePath(path)
+    , levels(0)
+    , serial(g_nextSerial++)
+    , ready(false)
+    , failed(false)
+    , watcher(nullptr)
+{
+    size = imageSize(path);
+    if (size.isEmpty()) {
+        failed = true;
+        return;
+    }
+    levels   = levelsFor(size);
+    cacheDir = cacheDirFor(path);
+    files.resize(levels);
+    if (metaMatches(cacheDir, size, levels)) {
+        ready = true;
+        return;
+    }
+
+    watcher = new QFutureWatcher<bool>();
+    QObject::connect(watcher, &QFutureWatcher<bool>::finished, watcher, [this] { finishBuild(); });
+    const QString source = path, dir = cacheDir;
+    const QSize   s = size;
+    watcher->setFuture(QtConcurrent::run([source, dir, s] { return buildPyramid(source, dir, s); }));
+}
+
+TilePyramid::~TilePyramid() {
+    {
+        QMutexLocker lock(&registryMutex());
+        if (registry().value(sourcePath).isNull())
+            registry().remove(sourcePath);
+    }
+    // Сборку не прервать — она допишет кэш на диск для следующего открытия
+    if (watcher) {
+        watcher->disconnect();
+        watcher->deleteLater();
+    }
+    QMutexLocker lock(&cacheMutex());
+    const QList<quint64> keys = tileCache().keys();
+    for (quint64 key : keys)
+        if ((key >> 40) == serial)
+            tileCache().remove(key);
+    qDeleteAll(files);
+}
+
+QSharedPointer<TilePyramid> TilePyramid::open(const QString& sourcePath) {
+    QMutexLocker lock(&registryMutex());
+    QSharedPointer<TilePyramid> p = registry().value(sourcePath).toStrongRef();
+    if (!p) {
+        p = QSharedPointer<TilePyramid>(new TilePyramid(sourcePath));
+        registry().insert(sourcePath, p);
+    }
+    return p;
+}
+
+QSize TilePyramid::imageSize(const QString& sourcePath) {
+    QImageReader reader(sourcePath);
+    return reader.size();
+}
+
+QString TilePyramid::getSourcePath() const {
+    return sourcePath;
+}
+
+QSize TilePyramid::getSize() const {
+    return size;
+}
+
+int TilePyramid::levelCount() const {
+    return levels;
+}
+
+bool TilePyramid::isReady() const {
+    return ready;
+}
+
+bool TilePyramid::isFailed() const {
+    return failed;
+}
+
+void TilePyramid::notifyWhenReady(QGraphicsScene* scene) {
+    if (ready || failed || waiting.contains(scene))
+        return;
+    waiting.append(scene);
+}
+
+void TilePyramid::finishBuild() {
+    ready  = watcher->result();
+    failed = !ready;
+    watcher->deleteLater();
+    watcher = nullptr;
+    for (const QPointer<QGraphicsScene>& sc : waiting)
+        if (sc)
+            sc->update();
+    waiting.clear();
+}
+
+QFile* TilePyramid::levelFile(int level) {
+    if (!files.at(level)) {
+        QFile* f = new QFile(levelFileName(cacheDir, level));
+        if (!f->open(QIODevice::ReadOnly)) {
+            delete f;
+            return nullptr;
+        }
+        files[level] = f;
+    }
+    return files.at(level);
+}
+
+const QImage* TilePyramid::tile(int level, int tx, int ty) {
+    const quint64 key = tileKey(serial, level, tx, ty);
+    if (MappedTile* t = tileCache().object(key))
+        return &t->image;
+
+    QFile* f = levelFile(level);
+    if (!f)
+        return nullptr;
+    const int columns = tilesAcross(levelSize(size, level).width());
+    uchar* memory = f->map((qint64(ty) * columns + tx) * kTileBytes, kTileBytes);
+    if (!memory)
+        return nullptr;
+    MappedTile* t = new MappedTile(f, memory);
+    // Цена в КБ; вытесняются давно не нужные плитки, но не только что вставленная
+    tileCache().insert(key, t, int(kTileBytes / 1024));
+    return &t->image;
+}
+
+void TilePyramid::paint(QPainter* painter, const QRectF& target, bool draft) {
+    if (!ready || target.isEmpty())
+        return;
+
+    // Уровень: экранных пикселей на пиксель уровня 0 по масштабу painter;
+    // в черновике — на уровень грубее
+    const QTransform t = painter->worldTransform();
+    const qreal sx = qSqrt(t.m11() * t.m11() + t.m12() * t.m12()) * target.width()  / size.width();
+    const qreal sy = qSqrt(t.m21() * t.m21() + t.m22() * t.m22()) * target.height() / size.height();
+    const qreal scale = qMax(sx, sy);
+    int level = scale >= 1.0 ? 0 : qFloor(std::log2(1.0 / scale));
+    if (draft)
+        ++level;
+    level = qBound(0, level, levels - 1);
+
+    // Видимая часть: устройство и клип, переведённые в координаты фигуры
+    QRectF visible = target;
+    if (QPaintDevice* dev = painter->device())
+        visible &= t.inverted().mapRect(QRectF(0, 0, dev->width(), dev->height()));
+    if (painter->hasClipping())
+        visible &= painter->clipBoundingRect();
+    if (visible.isEmpty())
+        return;
+
+    const QSize ls = levelSize(size, level);
+    const qreal kx = ls.width()  / target.width();
+    const qreal ky = ls.height() / target.height();
+    const int x0 = qMax(0, int((visible.left()   - target.left()) * kx) / kTileSize);
+    const int y0 = qMax(0, int((visible.top()    - target.top())  * ky) / kTileSize);
+    const int x1 = qMin(tilesAcross(ls.width())  - 1, int((visible.right()  - target.left()) * kx) / kTileSize);
+    const int y1 = qMin(tilesAcross(ls.height()) - 1, int((visible.bottom() - target.top())  * ky) / kTileSize);
+
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, !draft);
+    QMutexLocker lock(&cacheMutex());
+    for (int ty = y0; ty <= y1; ++ty) {
+        for (int tx = x0; tx <= x1; ++tx) {
+            const QImage* image = tile(level, tx, ty);
+            if (!image)
+                continue;
+            // Крайние плитки заполнены не целиком — берём только занятую часть
+            const QRect  src(0, 0, qMin(kTileSize, ls.width()  - tx * kTileSize),
+                                   qMin(kTileSize, ls.height() - ty * kTileSize));
+            const QRectF dst(target.left() + tx * kTileSize / kx, target.top() + ty * kTileSize / ky,
+                             src.width() / kx, src.height() / ky);
+            painter->drawImage(dst, *image, src);
+        }
+    }
+    painter->restore();
+}
+
+QImage TilePyramid::levelImage(int maxSide) const {
+    if (!ready)
+        return QImage();
+    int level = 0;
+    while (level < levels - 1) {
+        const QSize ls = levelSize(size, level);
+        if (qMax(ls.width(), ls.height()) <= maxSide)
+            break;
+        ++level;
+    }
+
+    QFile in(levelFileName(cacheDir, level));
+    if (!in.open(QIODevice::ReadOnly))
+        return QImage();
+    const QSize ls = levelSize(size, level);
+    QImage out(ls, QImage::Format_ARGB32_Premultiplied);
+    QImage tile(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+    for (int ty = 0; ty < tilesAcross(ls.height()); ++ty) {
+        for (int tx = 0; tx < tilesAcross(ls.width()); ++tx) {
+            if (in.read(reinterpret_cast<char*>(tile.bits()), kTileBytes) != kTileBytes)
+                return QImage();
+            const int w = qMin(kTileSize, ls.width()  - tx * kTileSize);
+            const int h = qMin(kTileSize, ls.height() - ty * kTileSize);
+            for (int y = 0; y < h; ++y)
+                std::memcpy(out.scanLine(ty * kTileSize + y) + tx * kTileSize * 4,
+                            tile.constScanLine(y), size_t(w) * 4);
+        }
+    }
+    return out;
+}
+
+int TilePyramid::cachedTiles() {
+    QMutexLocker lock(&cacheMutex());
+    return tileCache().size();
+}
+
+qint64 TilePyramid::cachedBytes() {
+    QMutexLocker lock(&cacheMutex());
+    return qint64(tileCache().totalCost()) * 1024;
+}
@@ -0,0 +1,80 @@
+// tilepyramid.h
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QPointer>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+class QFile;
+class QGraphicsScene;
+class QPainter;
+
+// Растр огромного изображения (сканы в десятки тысяч пикселей) как пирамида
+// уровней на диске: каждый уровень вдвое меньше предыдущего и нарезан на плитки
+// 256x256 ARGB32_Premultiplied. Плитки отображаются в память через QFile::map
+// и живут в общем LRU-кэше ограниченного размера. Отрисовка выбирает уровень
+// по масштабу painter и берёт только видимые плитки, поэтому память и время
+// кадра зависят от размера окна, а не изображения.
+// Пирамида строится в фоне при первом открытии файла и переживает перезапуск:
+// каталог кэша определяется путём, размером и временем изменения файла.
+class TilePyramid {
+public:
+    ~TilePyramid();
+
+    // Общая пирамида для файла: фигуры с одним источником делят её
+    static QSharedPointer<TilePyramid> open(const QString& sourcePath);
+
+    // Размер изображения по заголовку файла, без декодирования
+    static QSize imageSize(const QString& sourcePath);
+
+    QString getSourcePath() const;
+    QSize   getSize() const;
+    int     levelCount() const;
+    bool    isReady() const;
+    bool    isFailed() const;
+
+    // Видимая часть изображения в прямоугольнике target (только у готовой пирамиды)
+    void paint(QPainter* painter, const QRectF& target, bool draft);
+
+    // Перерисовать сцену, когда пирамида достроится
+    void notifyWhenReady(QGraphicsScene* scene);
+
+    // Первый уровень не больше maxSide по длинной стороне, целиком. Читает файл
+    // уровня мимо кэша плиток, поэтому годится для фоновых потоков (экспорт)
+    QImage levelImage(int maxSide) const;
+
+    // Учёт памяти: отображённые плитки всех пирамид
+    static int    cachedTiles();
+    static qint64 cachedBytes();
+
+private:
+    explicit TilePyramid(const QString& sourcePath);
+
+    void          finishBuild();
+    QFile*        levelFile(int level);
+    // Плитка из общего кэша (отображается при промахе); вызывать под мьютексом кэша
+    const QImage* tile(int level, int tx, int ty);
+
+    QString sourcePath;
+    QString cacheDir;
+    QSize   size;
+    int     levels;
+    quint64 serial;     // часть ключа плитки в общем кэше
+
+    std::atomic<bool> ready;
+    std::atomic<bool> failed;
+
+    QFutureWatcher<bool>*     watcher;   // фоновая сборка; пусто, если пирамида уже на диске
+    QVector<QFile*>           files;     // файлы уровней, открываются при первом обращении
+    QList<QPointer<QGraphicsScene>> waiting;
+};
+
+#endif // TILEPYRAMID_H
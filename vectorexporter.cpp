@@ -0,0 +1,645 @@
+// vectorexporter.cpp
+#include "vectorexporter.h"
+#include "tilepyramid.h"
+#include <QFontInfo>
+#include <QFontMetricsF>
+#include <QGlyphRun>
+#include <QHash>
+#include <QMap>
+#include <QRawFont>
+#include <QSaveFile>
+#include <QTextLayout>
+#include <QUrl>
+#include <QVector>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+
+const qreal kStrokeWidth = 2.0;    // как у пера в Shape::paint
+const qreal kSpatialBand = 256.0;  // высота полосы для Order::Spatial
+const int   kPdfImageSide = 2048;  // растр в PDF — уровень пирамиды не крупнее этого
+
+// Число без лишних нулей: 12.50 -> 12.5, 3.00 -> 3
+QByteArray num(qreal v) {
+    QByteArray s = QByteArray::number(v, 'f', 2);
+    while (s.endsWith('0'))
+        s.chop(1);
+    if (s.endsWith('.'))
+        s.chop(1);
+    if (s == "-0")
+        s = "0";
+    return s;
+}
+
+QByteArray xmlEscape(const QString& text) {
+    return text.toHtmlEscaped().replace('\'', "&#39;").toUtf8();
+}
+
+QByteArray svgColor(const QColor& c) {
+    return c.name(QColor::HexRgb).toLatin1();
+}
+
+// Общая часть приёмников: ограниченный буфер, который сбрасывается на устройство
+class StreamSink {
+public:
+    StreamSink(QIODevice* device, qint64 flushBytes, VectorExporter::Stats* stats)
+        : device(device), limit(flushBytes), stats(stats)
+    {
+        buffer.reserve(int(flushBytes) + 4096);
+    }
+    virtual ~StreamSink() {}
+
+    virtual void begin(const QRectF& bounds) = 0;
+    virtual void write(const SnapshotShape& shape) = 0;
+    virtual void finish() = 0;
+
+    bool ok() const { return !failed; }
+
+protected:
+    // Записать прямо на устройство (в обход буфера), считая смещение
+    void emitRaw(const QByteArray& bytes) {
+        if (failed)
+            return;
+        if (device->write(bytes) != bytes.size())
+            failed = true;
+        written      += bytes.size();
+        stats->bytes += bytes.size();
+    }
+
+    void flushBuffer() {
+        if (buffer.isEmpty())
+            return;
+        emitRaw(buffer);
+        buffer.clear();
+        ++stats->flushes;
+    }
+
+    bool bufferFull() const { return buffer.size() >= limit; }
+
+    QIODevice*             device;
+    qint64                 limit;
+    VectorExporter::Stats* stats;
+    QByteArray             buffer;
+    qint64                 written = 0;
+    bool                   failed  = false;
+};
+
+// ---------------- SVG ----------------
+// Стили — CSS-классы. Правило класса выводится отдельным <style> перед первым
+// использованием, поэтому документ пишется за один проход.
+class SvgSink : public StreamSink {
+public:
+    using StreamSink::StreamSink;
+
+    void begin(const QRectF& b) override {
+        buffer += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+        buffer += "<svg xmlns=\"http://www.w3.org/2000/svg\" xml:space=\"preserve\" viewBox=\""
+                + num(b.x()) + ' ' + num(b.y()) + ' ' + num(b.width()) + ' ' + num(b.height())
+                + "\" width=\"" + num(b.width()) + "\" height=\"" + num(b.height()) + "\">\n";
+    }
+
+    void write(const SnapshotShape& e) override {
+        const ShapeData& s = e.shape();
+        const QPointF o = e.pos;
+        const QRectF  r = s.outlineRect().translated(o);
+
+        switch (s.type) {
+        case ShapeType::Line: {
+            const QPointF a = s.startPos + o;
+            const QPointF b = s.endPos + o;
+            const QByteArray cls = strokeClass(s.color);
+            buffer += "<line class=\"" + cls + "\" x1=\"" + num(a.x()) + "\" y1=\"" + num(a.y())
+                    + "\" x2=\"" + num(b.x()) + "\" y2=\"" + num(b.y()) + "\"/>\n";
+            break;
+        }
+        case ShapeType::Rectangle: {
+            const QByteArray cls = strokeClass(s.color);
+            buffer += "<rect class=\"" + cls + "\" x=\"" + num(r.x()) + "\" y=\"" + num(r.y())
+                    + "\" width=\"" + num(r.width()) + "\" height=\"" + num(r.height()) + "\"/>\n";
+            break;
+        }
+        case ShapeType::Ellipse: {
+            const QByteArray cls = strokeClass(s.color);
+            buffer += "<ellipse class=\"" + cls + "\" cx=\"" + num(r.center().x())
+                    + "\" cy=\"" + num(r.center().y()) + "\" rx=\"" + num(r.width() / 2)
+                    + "\" ry=\"" + num(r.height() / 2) + "\"/>\n";
+            break;
+        }
+        case ShapeType::Star: {
+            const QByteArray cls = strokeClass(s.color);
+            buffer += "<polygon class=\"" + cls + "\" points=\"";
+            const QPolygonF star = Shape::starPolygon(r);
+            for (int i = 0; i < star.size(); ++i) {
+                if (i)
+                    buffer += ' ';
+                buffer += num(star.at(i).x()) + ',' + num(star.at(i).y());
+            }
+            buffer += "\"/>\n";
+            break;
+        }
+        case ShapeType::Text: {
+            const QFont f = s.textFont;
+            const QByteArray font = fontClass(f);
+            const QByteArray fill = fillClass(s.color);
+            const qreal baseline = r.top() + QFontMetricsF(f).ascent();
+            buffer += "<text class=\"" + font + ' ' + fill + "\" x=\"" + num(r.left())
+                    + "\" y=\"" + num(baseline) + "\">" + xmlEscape(s.text) + "</text>\n";
+            break;
+        }
+        case ShapeType::Image:
+            // Ссылка на исходный файл: встраивать скан в десятки тысяч пикселей незачем
+            buffer += "<image x=\"" + num(r.x()) + "\" y=\"" + num(r.y()) + "\" width=\""
+                    + num(r.width()) + "\" height=\"" + num(r.height())
+                    + "\" preserveAspectRatio=\"none\" href=\""
+                    + xmlEscape(QUrl::fromLocalFile(s.text).toString()) + "\"/>\n";
+            break;
+        case ShapeType::Path: {
+            // Кривые как есть (Q/C), без ломаной: печать не зависит от зума редактора
+            const BezierPath curve = s.path.mapped(QRectF(s.startPos + o, s.endPos + o));
+            buffer += "<path class=\"" + strokeClass(s.color) + "\" d=\"M"
+                    + num(curve.start().x()) + ' ' + num(curve.start().y());
+            for (const BezierSegment& seg : curve.segments()) {
+                if (seg.kind == BezierSegment::Quadratic)
+                    buffer += " Q" + num(seg.c1.x()) + ' ' + num(seg.c1.y());
+                else
+                    buffer += " C" + num(seg.c1.x()) + ' ' + num(seg.c1.y())
+                            + ' ' + num(seg.c2.x()) + ' ' + num(seg.c2.y());
+                buffer += ' ' + num(seg.end.x()) + ' ' + num(seg.end.y());
+            }
+            buffer += "\"/>\n";
+            break;
+        }
+        }
+        ++stats->shapes;
+        if (bufferFull())
+            flushBuffer();
+    }
+
+    void finish() override {
+        buffer += "</svg>\n";
+        flushBuffer();
+    }
+
+private:
+    void addRule(const QByteArray& rule) {
+        buffer += "<style>" + rule + "</style>\n";
+    }
+
+    QByteArray strokeClass(const QColor& c) {
+        auto it = strokes.constFind(c.rgba());
+        if (it != strokes.constEnd())
+            return it.value();
+        const QByteArray name = "s" + QByteArray::number(strokes.size());
+        QByteArray rule = '.' + name + "{fill:none;stroke:" + svgColor(c)
+                        + ";stroke-width:" + num(kStrokeWidth)
+                        + ";stroke-linecap:square;stroke-linejoin:bevel";
+        if (c.alpha() != 255)
+            rule += ";stroke-opacity:" + num(c.alphaF());
+        addRule(rule + '}');
+        strokes.insert(c.rgba(), name);
+        ++stats->styles;
+        return name;
+    }
+
+    QByteArray fillClass(const QColor& c) {
+        auto it = fills.constFind(c.rgba());
+        if (it != fills.constEnd())
+            return it.value();
+        const QByteArray name = "c" + QByteArray::number(fills.size());
+        QByteArray rule = '.' + name + "{fill:" + svgColor(c);
+        if (c.alpha() != 255)
+            rule += ";fill-opacity:" + num(c.alphaF());
+        addRule(rule + '}');
+        fills.insert(c.rgba(), name);
+        ++stats->styles;
+        return name;
+    }
+
+    QByteArray fontClass(const QFont& f) {
+        const QString key = f.toString();
+        auto it = fonts.constFind(key);
+        if (it != fonts.constEnd())
+            return it.value();
+        const QByteArray name = "f" + QByteArray::number(fonts.size());
+        QByteArray rule = '.' + name + "{font-family:'" + xmlEscape(f.family())
+                        + "';font-size:" + num(QFontInfo(f).pixelSize()) + "px";
+        if (f.bold())
+            rule += ";font-weight:bold";
+        if (f.italic())
+            rule += ";font-style:italic";
+        if (f.underline() || f.strikeOut())
+            rule += QByteArray(";text-decoration:")
+                  + (f.underline() ? "underline" : "")
+                  + (f.underline() && f.strikeOut() ? " " : "")
+                  + (f.strikeOut() ? "line-through" : "");
+        addRule(rule + '}');
+        fonts.insert(key, name);
+        ++stats->fonts;
+        return name;
+    }
+
+    QHash<QRgb, QByteArray>    strokes;
+    QHash<QRgb, QByteArray>    fills;
+    QHash<QString, QByteArray> fonts;
+};
+
+// ---------------- PDF ----------------
+// Одна страница размером с документ. Поток содержимого режется на куски
+// по flushBytes, каждый кусок — отдельный объект-поток (/Contents — массив).
+// Текст выводится контурами глифов: каждый уникальный глиф — Form XObject,
+// на который ссылаются все вхождения. Прозрачность — общие ExtGState.
+// Изображение встраивается один раз на файл — уменьшенным уровнем его пирамиды.
+class PdfSink : public StreamSink {
+public:
+    using StreamSink::StreamSink;
+
+    void begin(const QRectF& b) override {
+        bounds = b;
+        // 1 — каталог, 2 — дерево страниц, 3 — страница, 4 — ресурсы,
+        // 5 — массив кусков содержимого; пишутся в конце, когда всё известно
+        offsets.resize(6);
+        emitRaw("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+
+        // Ось Y вниз, как на сцене; перо как в Shape::paint
+        buffer += "1 0 0 -1 " + num(-b.x()) + ' ' + num(b.bottom()) + " cm\n"
+                + num(kStrokeWidth) + " w 2 J 2 j\n";
+    }
+
+    void write(const SnapshotShape& e) override {
+        const ShapeData& s = e.shape();
+        const QPointF o = e.pos;
+        const QRectF  r = s.outlineRect().translated(o);
+        const QColor  c = s.color;
+        setAlpha(c.alpha());
+
+        switch (s.type) {
+        case ShapeType::Line: {
+            setStroke(c);
+            const QPointF a = s.startPos + o;
+            const QPointF b = s.endPos + o;
+            buffer += num(a.x()) + ' ' + num(a.y()) + " m " + num(b.x()) + ' ' + num(b.y()) + " l S\n";
+            break;
+        }
+        case ShapeType::Rectangle:
+            setStroke(c);
+            buffer += num(r.x()) + ' ' + num(r.y()) + ' ' + num(r.width()) + ' ' + num(r.height()) + " re S\n";
+            break;
+        case ShapeType::Ellipse: {
+            setStroke(c);
+            QPainterPath p;
+            p.addEllipse(r);
+            appendPath(buffer, p);
+            buffer += "S\n";
+            break;
+        }
+        case ShapeType::Star: {
+            setStroke(c);
+            const QPolygonF star = Shape::starPolygon(r);
+            for (int i = 0; i < star.size(); ++i)
+                buffer += num(star.at(i).x()) + ' ' + num(star.at(i).y()) + (i ? " l " : " m ");
+            buffer += "h S\n";
+            break;
+        }
+        case ShapeType::Text:
+            setFill(c);
+            writeText(s.text, s.textFont, r.topLeft());
+            break;
+        case ShapeType::Image: {
+            const QByteArray name = imageName(s);
+            if (name.isEmpty()) {
+                // Пирамида ещё строится или файл не читается — только рамка
+                setStroke(c);
+                buffer += num(r.x()) + ' ' + num(r.y()) + ' ' + num(r.width()) + ' ' + num(r.height()) + " re S\n";
+                break;
+            }
+            // Единичный квадрат изображения на прямоугольник фигуры; ось Y страницы
+            // смотрит вниз, поэтому первая строка растра — у верхнего края
+            buffer += "q " + num(r.width()) + " 0 0 " + num(-r.height()) + ' ' + num(r.x()) + ' '
+                    + num(r.bottom()) + " cm /" + name + " Do Q\n";
+            break;
+        }
+        case ShapeType::Path:
+            // Квадратичные сегменты QPainterPath хранит кубическими — в PDF только c
+            setStroke(c);
+            appendPath(buffer, s.path.mapped(QRectF(s.startPos + o, s.endPos + o)).toPainterPath());
+            buffer += "S\n";
+            break;
+        }
+        ++stats->shapes;
+        if (bufferFull())
+            flushContent();
+    }
+
+    void finish() override {
+        if (!buffer.isEmpty() || contents.isEmpty())
+            flushContent();
+
+        // Ресурсы: глифы и состояния прозрачности
+        QByteArray res = "<< /XObject <<";
+        for (const XObject& g : glyphList)
+            res += " /" + g.name + ' ' + QByteArray::number(g.object) + " 0 R";
+        for (const XObject& i : imageList)
+            res += " /" + i.name + ' ' + QByteArray::number(i.object) + " 0 R";
+        res += " >> /ExtGState <<";
+        for (auto it = alphaStates.constBegin(); it != alphaStates.constEnd(); ++it)
+            res += " /" + it.value() + " << /CA " + num(it.key() / 255.0)
+                 + " /ca " + num(it.key() / 255.0) + " >>";
+        res += " >> >>";
+        writeObject(4, res);
+
+        QByteArray arr = "[";
+        for (int obj : contents)
+            arr += ' ' + QByteArray::number(obj) + " 0 R";
+        writeObject(5, arr + " ]");
+
+        writeObject(1, "<< /Type /Catalog /Pages 2 0 R >>");
+        writeObject(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+        writeObject(3, "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + num(bounds.width()) + ' '
+                       + num(bounds.height()) + "] /Resources 4 0 R /Contents 5 0 R >>");
+
+        // Таблица перекрёстных ссылок: записи ровно по 20 байт
+        const qint64 xref = written;
+        QByteArray table = "xref\n0 " + QByteArray::number(offsets.size()) + "\n0000000000 65535 f\r\n";
+        for (int i = 1; i < offsets.size(); ++i)
+            table += QByteArray::number(offsets.at(i)).rightJustified(10, '0') + " 00000 n\r\n";
+        table += "trailer\n<< /Size " + QByteArray::number(offsets.size()) + " /Root 1 0 R >>\n"
+               + "startxref\n" + QByteArray::number(xref) + "\n%%EOF\n";
+        emitRaw(table);
+    }
+
+private:
+    struct XObject {
+        QByteArray name;
+        int        object;
+    };
+
+    int reserveObject() {
+        offsets.append(0);
+        return offsets.size() - 1;
+    }
+
+    void writeObject(int number, const QByteArray& body) {
+        offsets[number] = written;
+        emitRaw(QByteArray::number(number) + " 0 obj\n" + body + "\nendobj\n");
+    }
+
+    void writeStream(int number, const QByteArray& dict, const QByteArray& data) {
+        offsets[number] = written;
+        emitRaw(QByteArray::number(number) + " 0 obj\n<< " + dict + " /Length "
+                + QByteArray::number(data.size()) + " >>\nstream\n");
+        emitRaw(data);
+        emitRaw("\nendstream\nendobj\n");
+    }
+
+    // Текущий кусок содержимого — отдельный объект; операторы не рвутся,
+    // т.к. сброс происходит только между фигурами
+    void flushContent() {
+        const int obj = reserveObject();
+        writeStream(obj, QByteArray(), buffer);
+        contents.append(obj);
+        buffer.clear();
+        ++stats->flushes;
+    }
+
+    void setStroke(const QColor& c) {
+        if (c.rgb() == strokeRgb)
+            return;
+        strokeRgb = c.rgb();
+        buffer += num(c.redF()) + ' ' + num(c.greenF()) + ' ' + num(c.blueF()) + " RG\n";
+    }
+
+    void setFill(const QColor& c) {
+        if (c.rgb() == fillRgb)
+            return;
+        fillRgb = c.rgb();
+        buffer += num(c.redF()) + ' ' + num(c.greenF()) + ' ' + num(c.blueF()) + " rg\n";
+    }
+
+    void setAlpha(int alpha) {
+        if (alpha == currentAlpha)
+            return;
+        currentAlpha = alpha;
+        auto it = alphaStates.constFind(alpha);
+        if (it == alphaStates.constEnd()) {
+            it = alphaStates.insert(alpha, "GS" + QByteArray::number(alphaStates.size()));
+            ++stats->styles;
+        }
+        buffer += '/' + it.value() + " gs\n";
+    }
+
+    static void appendPath(QByteArray& out, const QPainterPath& p) {
+        for (int i = 0; i < p.elementCount(); ++i) {
+            const QPainterPath::Element e = p.elementAt(i);
+            switch (e.type) {
+            case QPainterPath::MoveToElement:
+                out += num(e.x) + ' ' + num(e.y) + " m\n";
+                break;
+            case QPainterPath::LineToElement:
+                out += num(e.x) + ' ' + num(e.y) + " l\n";
+                break;
+            case QPainterPath::CurveToElement: {
+                const QPainterPath::Element c2 = p.elementAt(i + 1);
+                const QPainterPath::Element to = p.elementAt(i + 2);
+                out += num(e.x) + ' ' + num(e.y) + ' ' + num(c2.x) + ' ' + num(c2.y) + ' '
+                     + num(to.x) + ' ' + num(to.y) + " c\n";
+                i += 2;
+                break;
+            }
+            case QPainterPath::CurveToDataElement:
+                break;
+            }
+        }
+    }
+
+    // Глиф как Form XObject: контур пишется один раз, в тексте — только ссылки
+    QByteArray glyphName(const QRawFont& font, quint32 index) {
+        const QByteArray key = font.familyName().toUtf8() + '|' + font.styleName().toUtf8() + '|'
+                             + QByteArray::number(font.pixelSize()) + '|' + QByteArray::number(index);
+        auto it = glyphs.constFind(key);
+        if (it != glyphs.constEnd())
+            return it.value();
+
+        const QPainterPath path = font.pathForGlyph(index);
+        QByteArray data;
+        appendPath(data, path);
+        data += "f";
+        const QRectF bb = path.boundingRect();
+
+        const XObject g = { "G" + QByteArray::number(glyphList.size()), reserveObject() };
+        writeStream(g.object,
+                    "/Type /XObject /Subtype /Form /BBox [" + num(bb.left()) + ' ' + num(bb.top())
+                    + ' ' + num(bb.right()) + ' ' + num(bb.bottom()) + ']',
+                    data);
+        glyphList.append(g);
+        glyphs.insert(key, g.name);
+        ++stats->fonts;
+        return g.name;
+    }
+
+    // Image XObject на файл-источник: RGB, сжатие Flate (qCompress — это zlib
+    // с 4 байтами длины впереди). Читает уровень пирамиды мимо кэша плиток
+    QByteArray imageName(const ShapeData& s) {
+        auto it = images.constFind(s.text);
+        if (it != images.constEnd())
+            return it.value();
+        const QImage level = s.pyramid ? s.pyramid->levelImage(kPdfImageSide) : QImage();
+        if (level.isNull())
+            return QByteArray();
+
+        const QImage rgb = level.convertToFormat(QImage::Format_RGB888);
+        QByteArray raw;
+        raw.reserve(rgb.width() * rgb.height() * 3);
+        for (int y = 0; y < rgb.height(); ++y)
+            raw.append(reinterpret_cast<const char*>(rgb.constScanLine(y)), rgb.width() * 3);
+
+        const XObject img = { "I" + QByteArray::number(imageList.size()), reserveObject() };
+        writeStream(img.object,
+                    "/Type /XObject /Subtype /Image /Width " + QByteArray::number(rgb.width())
+                    + " /Height " + QByteArray::number(rgb.height())
+                    + " /ColorSpace /DeviceRGB /BitsPerComponent 8 /Filter /FlateDecode",
+                    qCompress(raw).mid(4));
+        imageList.append(img);
+        images.insert(s.text, img.name);
+        return img.name;
+    }
+
+    void writeText(const QString& text, const QFont& font, const QPointF& topLeft) {
+        QTextLayout layout(text, font);
+        layout.beginLayout();
+        QTextLine line = layout.createLine();
+        layout.endLayout();
+        if (!line.isValid())
+            return;
+
+        for (const QGlyphRun& run : layout.glyphRuns()) {
+            const QRawFont         raw       = run.rawFont();
+            const QVector<quint32> indexes   = run.glyphIndexes();
+            const QVector<QPointF> positions = run.positions();
+            for (int i = 0; i < indexes.size(); ++i) {
+                const QPointF at = topLeft + positions.at(i);
+                buffer += "q 1 0 0 1 " + num(at.x()) + ' ' + num(at.y()) + " cm /"
+                        + glyphName(raw, indexes.at(i)) + " Do Q\n";
+            }
+        }
+
+        // Подчёркивание и зачёркивание — тонкие прямоугольники по метрикам шрифта
+        const QFontMetricsF fm(font);
+        const qreal baseline = topLeft.y() + fm.ascent();
+        const qreal width    = line.naturalTextWidth();
+        if (font.underline())
+            buffer += num(topLeft.x()) + ' ' + num(baseline + fm.underlinePos()) + ' '
+                    + num(width) + ' ' + num(fm.lineWidth()) + " re f\n";
+        if (font.strikeOut())
+            buffer += num(topLeft.x()) + ' ' + num(baseline - fm.strikeOutPos()) + ' '
+                    + num(width) + ' ' + num(fm.lineWidth()) + " re f\n";
+    }
+
+    QRectF          bounds;
+    QVector<qint64> offsets;    // смещение объекта по его номеру
+    QVector<int>    contents;   // объекты-куски содержимого страницы
+
+    QHash<QByteArray, QByteArray> glyphs;
+    QVector<XObject>              glyphList;
+    QHash<QString, QByteArray>    images;      // файл-источник -> имя XObject
+    QVector<XObject>              imageList;
+    QHash<int, QByteArray>        alphaStates;
+
+    QRgb strokeRgb    = 0x01000000;   // заведомо не совпадает ни с одним rgb()
+    QRgb fillRgb      = 0x01000000;
+    int  currentAlpha = 255;
+};
+
+// Номера фигур слоя по полосам высотой kSpatialBand сверху вниз,
+// внутри полосы — слева направо (при равенстве — в порядке наложения)
+QMap<qint64, QVector<int>> spatialBands(const QVector<SnapshotShape>& shapes) {
+    QMap<qint64, QVector<int>> bands;
+    QVector<qreal> lefts(shapes.size());
+    for (int i = 0; i < shapes.size(); ++i) {
+        const QRectF r = shapes.at(i).sceneRect();
+        lefts[i] = r.left();
+        bands[qint64(qFloor(r.top() / kSpatialBand))].append(i);
+    }
+    for (QVector<int>& band : bands)
+        std::stable_sort(band.begin(), band.end(),
+                         [&lefts](int a, int b) { return lefts.at(a) < lefts.at(b); });
+    return bands;
+}
+
+} // namespace
+
+VectorExporter::VectorExporter(const DocumentSnapshot& document)
+    : document(document)
+    , order(Order::Stacking)
+    , flushBytes(256 * 1024)
+{ }
+
+VectorExporter::Format VectorExporter::formatForPath(const QString& path) {
+    return path.endsWith(".pdf", Qt::CaseInsensitive) ? Format::Pdf : Format::Svg;
+}
+
+QRectF VectorExporter::documentBounds() const {
+    QRectF bounds;
+    for (int i = 0; i < document.layerCount(); ++i) {
+        const LayerSnapshot& layer = document.layer(i);
+        if (!layer.visible)
+            continue;
+        for (const SnapshotShape& s : layer.shapes)
+            bounds |= s.sceneRect();
+    }
+    if (bounds.isEmpty())
+        bounds = document.getSceneRect();
+    // Поле под половину пера по краям
+    return bounds.adjusted(-kStrokeWidth, -kStrokeWidth, kStrokeWidth, kStrokeWidth);
+}
+
+bool VectorExporter::exportTo(const QString& path, Format format) {
+    counters = Stats();
+    error.clear();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    SvgSink svg(&file, flushBytes, &counters);
+    PdfSink pdf(&file, flushBytes, &counters);
+    StreamSink& sink = (format == Format::Pdf) ? static_cast<StreamSink&>(pdf)
+                                               : static_cast<StreamSink&>(svg);
+
+    // Фигуры идут прямо из снимков слоёв, без общей копии документа: слои снизу
+    // вверх, внутри слоя — по ключу z, как на сцене. Скрытые слои в документ
+    // не попадают, заблокированные экспортируются как есть
+    sink.begin(documentBounds());
+    for (int i = 0; i < document.layerCount() && sink.ok(); ++i) {
+        const LayerSnapshot& layer = document.layer(i);
+        if (!layer.visible)
+            continue;
+        if (order == Order::Spatial) {
+            // Сортируются номера фигур, и каждая полоса отдельно
+            for (const QVector<int>& band : spatialBands(layer.shapes)) {
+                for (int k : band) {
+                    sink.write(layer.shapes.at(k));
+                    if (!sink.ok())
+                        break;
+                }
+                if (!sink.ok())
+                    break;
+            }
+        } else {
+            for (const SnapshotShape& s : layer.shapes) {
+                sink.write(s);
+                if (!sink.ok())
+                    break;
+            }
+        }
+    }
+    sink.finish();
+
+    if (!sink.ok() || !file.commit()) {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+// vectorexporter.h
+#ifndef VECTOREXPORTER_H
+#define VECTOREXPORTER_H
+
+#include <QList>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include "documentsnapshot.h"
+
+// Потоковый экспорт документа в SVG/PDF для печати.
+// Фигуры пишутся по одной прямо в элементы SVG или операторы потока содержимого PDF,
+// без QGraphicsScene::render. Стили, шрифты и глифы выносятся в общие определения,
+// а вывод сбрасывается на диск кусками не больше flushBytes — память не растёт
+// с числом фигур (кроме таблиц уникальных стилей и глифов).
+// Работает по снимку документа, поэтому может идти в фоновом потоке, пока его правят.
+class VectorExporter {
+public:
+    enum class Format { Svg, Pdf };
+
+    // Stacking — в порядке наложения (как на экране);
+    // Spatial — внутри слоя полосами сверху вниз, для плоттеров, где наложение не важно
+    enum class Order { Stacking, Spatial };
+
+    struct Stats {
+        int    shapes   = 0;
+        int    styles   = 0;   // уникальные стили обводки/заливки
+        int    fonts    = 0;   // уникальные шрифты (SVG) или глифы (PDF)
+        qint64 bytes    = 0;
+        int    flushes  = 0;
+    };
+
+    explicit VectorExporter(const DocumentSnapshot& document);
+
+    void setOrder(Order o)           { order = o; }
+    void setFlushBytes(qint64 bytes) { flushBytes = bytes; }
+
+    bool    exportTo(const QString& path, Format format);
+    QString errorString() const { return error; }
+    Stats   stats() const { return counters; }
+
+    // Формат по расширению файла (.pdf — PDF, иначе SVG)
+    static Format formatForPath(const QString& path);
+
+private:
+    QRectF documentBounds() const;
+
+    DocumentSnapshot document;
+    Order   order;
+    qint64  flushBytes;
+    QString error;
+    Stats   counters;
+};
+
+#endif // VECTOREXPORTER_H